@@ -0,0 +1,43 @@
+# Everything the app is built from except main.cpp, shared with the tests in
+# tests/ and the benchmarks in bench/.
+
+# Required Qt modules
+QT += core gui widgets multimedia
+
+INCLUDEPATH += $$PWD
+
+RESOURCES += $$PWD/resources.qrc
+
+SOURCES += $$PWD/spectrumkernel.cpp
+
+HEADERS += $$PWD/mediacontrolwidget.h \
+    $$PWD/lockfree.h \
+    $$PWD/spectrumkernel.h \
+    $$PWD/onsetdetector.h \
+    $$PWD/spectrumanalyzer.h \
+    $$PWD/frameclock.h \
+    $$PWD/timelabel.h \
+    $$PWD/playliststore.h \
+    $$PWD/pathvalidator.h \
+    $$PWD/playlistdialog.h \
+    $$PWD/shuffleengine.h \
+    $$PWD/libraryscanner.h \
+    $$PWD/librarywatcher.h \
+    $$PWD/playbackengine.h \
+    $$PWD/mediaplayerengine.h \
+    $$PWD/streamplaybackengine.h \
+    $$PWD/loudnessmeter.h \
+    $$PWD/loudnessanalyzer.h \
+    $$PWD/waveformcache.h \
+    $$PWD/seekscheduler.h \
+    $$PWD/sourcestamp.h \
+    $$PWD/seekindex.h \
+    $$PWD/nativedecoder.h \
+    $$PWD/tagcache.h \
+    $$PWD/artworkcache.h \
+    $$PWD/searchindex.h \
+    $$PWD/playlistmodel.h \
+    $$PWD/playlistfile.h
+
+# C++ standard
+CONFIG += c++23
@@ -0,0 +1,381 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QImage>
+#include <QImageReader>
+#include <QRect>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QBuffer>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "tagcache.h"
+#include "sourcestamp.h"
+
+// Area-averaging downscaler for 32-bit images.
+//
+// Every output pixel is the mean of the source pixels it covers, partial
+// pixels weighted by coverage, which is what a cover shrunk by 10x or more
+// needs to stay free of aliasing. The filter is separable and runs rows
+// first: each output row accumulates its source rows into one float line with
+// a plain multiply-add over contiguous bytes, a loop compilers vectorize, and
+// only the much shorter accumulated line is filtered across.
+class AreaScaler {
+public:
+    // Crops source to target's aspect ratio around its centre and scales it to target.
+    // The result is premultiplied ARGB32.
+    static QImage fill(const QImage &source, const QSize &target) {
+        if (source.isNull() || target.isEmpty()) return QImage();
+        const QImage image = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+        QRect crop = image.rect();
+        if (qint64(image.width()) * target.height() > qint64(image.height()) * target.width()) {
+            crop.setWidth(qMax(1, int(qint64(image.height()) * target.width() / target.height())));
+            crop.moveLeft((image.width() - crop.width()) / 2);
+        } else {
+            crop.setHeight(qMax(1, int(qint64(image.width()) * target.height() / target.width())));
+            crop.moveTop((image.height() - crop.height()) / 2);
+        }
+        // Averaging only ever shrinks; small covers are enlarged by interpolation instead
+        if (crop.width() < target.width() || crop.height() < target.height()) {
+            return image.copy(crop).scaled(target, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        }
+        return shrink(image, crop, target);
+    }
+
+private:
+    // Which source pixels each output pixel covers along one axis, and by how much
+    struct Spans {
+        std::vector<int> first;
+        std::vector<int> count;
+        std::vector<float> weights;  // maxTaps per output pixel
+        int maxTaps = 0;
+    };
+
+    static Spans spans(int in, int out) {
+        Spans result;
+        const double scale = double(in) / out;
+        result.maxTaps = int(std::ceil(scale)) + 1;
+        result.first.resize(out);
+        result.count.resize(out);
+        result.weights.assign(size_t(out) * result.maxTaps, 0.0f);
+        for (int o = 0; o < out; ++o) {
+            const double start = o * scale;
+            const double end = qMin<double>((o + 1) * scale, in);
+            const int first = int(start);
+            const int last = qMin(in, int(std::ceil(end)));
+            result.first[o] = first;
+            result.count[o] = qMin(last - first, result.maxTaps);
+            for (int k = 0; k < result.count[o]; ++k) {
+                const double covered = qMin<double>(end, first + k + 1) - qMax<double>(start, first + k);
+                result.weights[size_t(o) * result.maxTaps + k] = float(covered / scale);
+            }
+        }
+        return result;
+    }
+
+    static QImage shrink(const QImage &image, const QRect &crop, const QSize &target) {
+        const Spans rows = spans(crop.height(), target.height());
+        const Spans columns = spans(crop.width(), target.width());
+        const int lineBytes = crop.width() * 4;
+        std::vector<float> line(lineBytes);
+        QImage result(target, QImage::Format_ARGB32_Premultiplied);
+        for (int y = 0; y < target.height(); ++y) {
+            std::fill(line.begin(), line.end(), 0.0f);
+            float *acc = line.data();
+            for (int k = 0; k < rows.count[y]; ++k) {
+                const uchar *row = image.constScanLine(crop.y() + rows.first[y] + k) + crop.x() * 4;
+                const float weight = rows.weights[size_t(y) * rows.maxTaps + k];
+                for (int i = 0; i < lineBytes; ++i) acc[i] += weight * row[i];
+            }
+            uchar *out = result.scanLine(y);
+            for (int x = 0; x < target.width(); ++x) {
+                const float *taps = acc + columns.first[x] * 4;
+                const float *weights = columns.weights.data() + size_t(x) * columns.maxTaps;
+                float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+                for (int k = 0; k < columns.count[x]; ++k) {
+                    for (int c = 0; c < 4; ++c) sum[c] += weights[k] * taps[k * 4 + c];
+                }
+                // The channels stay in memory order; premultiplied sums never exceed their alpha
+                for (int c = 0; c < 4; ++c) out[x * 4 + c] = uchar(qMin(255.0f, sum[c] + 0.5f));
+            }
+        }
+        return result;
+    }
+};
+
+// Cover thumbnails for the now-playing panel, sized for the device pixels
+// they are drawn at.
+//
+// A cover is the picture embedded in the track (see TagReader) or, failing
+// that, a cover/folder/front/album image next to it. Covers are
+// content-addressed: the SHA-1 of the encoded image names its thumbnails on
+// disk, so every track of an album shares one decode and one file, and a
+// path index stamped with each track's size and mtime lets a warm lookup skip
+// the tag walk entirely. Extraction, decoding and scaling run on a small
+// low-priority pool; decoded thumbnails are kept in a byte-budgeted LRU that
+// painting reads without ever blocking on I/O. The path index is saved, like
+// TagCache's, when the new entries would double the file, after
+// SaveIntervalMs, or when the pool runs out of requests.
+class ArtworkCache : public QObject {
+    Q_OBJECT
+public:
+    static constexpr qint64 MemoryBudgetBytes = 32 * 1024 * 1024;
+
+    explicit ArtworkCache(QObject *parent = nullptr)
+    : QObject(parent), images(MemoryBudgetBytes) {
+        pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount() / 2, 4));
+        pool.setThreadPriority(QThread::LowPriority);
+        directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/artwork";
+        sinceSave.start();
+        pool.start([this]() { ensureLoaded(); });
+    }
+
+    ~ArtworkCache() {
+        stopping = true;
+        pool.clear();
+        pool.waitForDone();
+        save();
+    }
+
+    // Starts producing the thumbnail of path at size (in device pixels) unless it is in
+    // memory or already on its way. GUI thread only; never touches the filesystem.
+    void request(const QString &path, const QSize &size) {
+        if (path.isEmpty() || size.isEmpty()) return;
+        const auto known = coverOf.constFind(path);
+        if (known != coverOf.cend() && (known->isEmpty() || images.contains(thumbnailKey(*known, size)))) return;
+        const QString job = path + '\n' + sizeName(size);
+        if (queued.contains(job)) return;
+        queued.insert(job);
+        {
+            QMutexLocker locker(&mutex);
+            ++outstanding;
+        }
+        pool.start([this, path, size, job]() { produce(path, size, job); });
+    }
+
+    // The thumbnail of path at size if it has been decoded, else a null image. GUI thread only.
+    QImage thumbnail(const QString &path, const QSize &size) {
+        const QByteArray cover = coverOf.value(path);
+        if (cover.isEmpty()) return QImage();
+        const QImage *image = images.object(thumbnailKey(cover, size));
+        return image ? *image : QImage();
+    }
+
+signals:
+    // A thumbnail of path has just been decoded and can be drawn
+    void ready(const QString &path);
+
+private:
+    static constexpr quint32 CacheVersion = 1;
+    static constexpr int MinSaveBatch = 64;
+    static constexpr qint64 SaveIntervalMs = 30000;
+    static constexpr qint64 MaxFolderImageBytes = 16 * 1024 * 1024;
+    // Path and cover lengths plus the two stamps
+    static constexpr qint64 MinEntryBytes = 4 + 8 + 8 + 4;
+
+    struct Entry {
+        qint64 size = 0;
+        qint64 mtimeNs = 0;
+        QByteArray cover;  // hex SHA-1 of the encoded image; empty when the track has none
+    };
+
+    static QString sizeName(const QSize &size) {
+        return QString::number(size.width()) + 'x' + QString::number(size.height());
+    }
+
+    static QString thumbnailKey(const QByteArray &cover, const QSize &size) {
+        return QString::fromLatin1(cover) + '-' + sizeName(size);
+    }
+
+    // The encoded cover of path: the embedded picture, else a conventionally named image beside it
+    static QByteArray extract(const QString &path) {
+        TrackTags ignored;
+        QByteArray picture;
+        TagReader::read(path, ignored, &picture);
+        if (!picture.isEmpty()) return picture;
+        const QDir folder = QFileInfo(path).dir();
+        const QStringList candidates = folder.entryList({"*.jpg", "*.jpeg", "*.png"}, QDir::Files);
+        for (const char *name : {"cover", "folder", "front", "album"}) {
+            for (const QString &candidate : candidates) {
+                if (QFileInfo(candidate).completeBaseName().compare(QLatin1String(name), Qt::CaseInsensitive) != 0) continue;
+                QFile file(folder.filePath(candidate));
+                if (file.size() > MaxFolderImageBytes || !file.open(QIODevice::ReadOnly)) continue;
+                return file.readAll();
+            }
+        }
+        return QByteArray();
+    }
+
+    static QImage decode(const QByteArray &encoded, const QSize &size) {
+        QBuffer buffer;
+        buffer.setData(encoded);
+        buffer.open(QIODevice::ReadOnly);
+        QImageReader reader(&buffer);
+        reader.setAutoTransform(true);
+        return AreaScaler::fill(reader.read(), size);
+    }
+
+    // Pool worker: finds the cover of path and its thumbnail at size, decoding it only when
+    // no track with the same cover has left one on disk.
+    void produce(const QString &path, const QSize &size, const QString &job) {
+        ensureLoaded();
+        SourceStamp stamp;
+        bool found = false;
+        QByteArray cover;
+        QImage image;
+        if (!stopping && SourceStamp::read(path, stamp)) {
+            found = true;
+            QByteArray encoded;
+            bool known = false;
+            {
+                QMutexLocker locker(&mutex);
+                auto cached = index.constFind(path);
+                if (cached != index.cend() && cached->size == stamp.size && cached->mtimeNs == stamp.mtimeNs) {
+                    cover = cached->cover;
+                    known = true;
+                }
+            }
+            if (!known) {
+                encoded = extract(path);
+                if (!encoded.isEmpty()) cover = QCryptographicHash::hash(encoded, QCryptographicHash::Sha1).toHex();
+                remember(path, {stamp.size, stamp.mtimeNs, cover});
+            }
+            if (!cover.isEmpty()) {
+                const QString thumbnailPath = directory + '/' + thumbnailKey(cover, size) + ".png";
+                if (image.load(thumbnailPath, "PNG")) {
+                    image.convertTo(QImage::Format_ARGB32_Premultiplied);
+                } else {
+                    if (encoded.isEmpty()) encoded = extract(path);
+                    image = decode(encoded, size);
+                    if (!image.isNull()) {
+                        QDir().mkpath(directory);
+                        QSaveFile file(thumbnailPath);
+                        if (file.open(QIODevice::WriteOnly) && image.save(&file, "PNG")) file.commit();
+                    }
+                }
+            }
+        }
+        bool saveNow;
+        {
+            QMutexLocker locker(&mutex);
+            --outstanding;
+            saveNow = dirty && (unsaved >= qMax<qsizetype>(MinSaveBatch, savedSize) || outstanding == 0
+                                || sinceSave.hasExpired(SaveIntervalMs));
+        }
+        if (saveNow) save();
+        QMetaObject::invokeMethod(this, [this, path, size, job, found, cover, image]() {
+            queued.remove(job);
+            // A file that could not be read is asked about again next time
+            if (!found) return;
+            coverOf.insert(path, cover);
+            if (image.isNull()) return;
+            images.insert(thumbnailKey(cover, size), new QImage(image), image.sizeInBytes());
+            emit ready(path);
+        }, Qt::QueuedConnection);
+    }
+
+    void remember(const QString &path, const Entry &entry) {
+        QMutexLocker locker(&mutex);
+        index.insert(path, entry);
+        dirty = true;
+        ++unsaved;
+    }
+
+    // The index must be in before any stamp is checked, or known tracks would be read again
+    void ensureLoaded() {
+        QMutexLocker locker(&loadMutex);
+        if (loaded) return;
+        load();
+        loaded = true;
+    }
+
+    void load() {
+        QFile file(directory + "/index.bin");
+        if (!file.open(QIODevice::ReadOnly)) return;
+        QDataStream in(&file);
+        quint32 version = 0;
+        in >> version;
+        if (version != CacheVersion) return;
+        qint64 count = 0;
+        in >> count;
+        QMutexLocker locker(&mutex);
+        // A damaged count may not size the hash beyond what the rest of the file can hold
+        index.reserve(qBound<qint64>(0, count, (file.size() - file.pos()) / MinEntryBytes));
+        for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Entry entry;
+            in >> path >> entry.size >> entry.mtimeNs >> entry.cover;
+            if (!index.contains(path)) index.insert(path, entry);
+        }
+        savedSize = index.size();
+    }
+
+    // Writes a snapshot taken under the lock, so workers keep inserting while the file is written.
+    // saveMutex keeps writers in snapshot order: the newest snapshot is always written last.
+    void save() {
+        QMutexLocker saveLocker(&saveMutex);
+        QHash<QString, Entry> snapshot;
+        {
+            QMutexLocker locker(&mutex);
+            if (!dirty) return;
+            snapshot = index;
+            dirty = false;
+            unsaved = 0;
+            savedSize = snapshot.size();
+            sinceSave.restart();
+        }
+        QDir().mkpath(directory);
+        QSaveFile file(directory + "/index.bin");
+        bool written = file.open(QIODevice::WriteOnly);
+        if (written) {
+            QDataStream out(&file);
+            out << CacheVersion << qint64(snapshot.size());
+            for (auto it = snapshot.cbegin(); it != snapshot.cend(); ++it) {
+                out << it.key() << it->size << it->mtimeNs << it->cover;
+            }
+            written = file.commit();
+        }
+        if (!written) {
+            QMutexLocker locker(&mutex);
+            dirty = true;
+        }
+    }
+
+    // GUI thread only
+    QHash<QString, QByteArray> coverOf;
+    QCache<QString, QImage> images;  // costed in bytes, least recently drawn evicted first
+    QSet<QString> queued;
+
+    QMutex mutex;
+    QHash<QString, Entry> index;  // guarded by mutex, as are the members up to sinceSave
+    qint64 outstanding = 0;
+    bool dirty = false;
+    qsizetype unsaved = 0;
+    qsizetype savedSize = 0;
+    QElapsedTimer sinceSave;
+    QString directory;
+    QMutex loadMutex;
+    bool loaded = false;  // guarded by loadMutex
+    QMutex saveMutex;
+    std::atomic<bool> stopping{false};
+    QThreadPool pool;
+};
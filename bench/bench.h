@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <cstdio>
+
+// Registry and helpers shared by the benchmark sections. Each section lives in
+// its own translation unit and registers itself with a static Bench object;
+// main.cpp runs the sections named on the command line, or all of them.
+// Results are printed one per line as "section: what = value unit" so runs
+// can be diffed or grepped.
+class Bench {
+public:
+    using Run = int (*)(const QStringList &args);
+
+    Bench(const char *name, const char *summary, Run run) { all().append({name, summary, run}); }
+
+    struct Section {
+        const char *name;
+        const char *summary;
+        Run run;
+    };
+
+    static QList<Section> &all() {
+        static QList<Section> sections;
+        return sections;
+    }
+
+    static void report(const char *section, const QString &what, double value, const char *unit) {
+        std::printf("%s: %s = %.3f %s\n", section, qPrintable(what), value, unit);
+        std::fflush(stdout);
+    }
+
+    // Runs body repeatedly for at least minMs and returns the mean nanoseconds per call.
+    template <typename Body>
+    static double nsPerCall(Body body, qint64 minMs = 200) {
+        body();
+        QElapsedTimer timer;
+        timer.start();
+        qint64 calls = 0;
+        do {
+            body();
+            ++calls;
+        } while (timer.elapsed() < minMs);
+        return static_cast<double>(timer.nsecsElapsed()) / calls;
+    }
+};
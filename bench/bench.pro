@@ -0,0 +1,29 @@
+# Benchmarks, built apart from the app:
+#   qmake bench/bench.pro && make && ./apexbench [section...]
+# "./apexbench list" names the sections. Results go to stdout.
+
+TARGET = apexbench
+TEMPLATE = app
+
+include(../app.pri)
+
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += main.cpp \
+    spectrumbench.cpp \
+    shufflebench.cpp \
+    scanbench.cpp \
+    seekbench.cpp \
+    decodebench.cpp \
+    playlistbench.cpp \
+    importbench.cpp \
+    paintbench.cpp \
+    waveformbench.cpp \
+    loudnessbench.cpp
+
+HEADERS += bench.h \
+    ../tests/tonefile.h
+
+# Synthetic audio files, shared with the tests
+INCLUDEPATH += ../tests
@@ -0,0 +1,147 @@
+#include <QAudioDecoder>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <QUrl>
+#include <functional>
+#include <vector>
+#include "bench.h"
+#include "nativedecoder.h"
+#include "tonefile.h"
+
+// Decode throughput of the native WAV and FLAC decoders against QAudioDecoder
+// on the same generated files, as multiples of real time, plus the time from
+// opening a file to its first decoded audio. There are two FLAC files: one of
+// verbatim subframes, which measures framing, CRC checks and sample
+// conversion, and one of fixed and LPC subframes with Rice-coded residuals in
+// every stereo decorrelation mode (ToneFile::FlacCoding::Predicted), which
+// runs the dispatched LPC restore. Every file is decoded natively once more
+// and must match the samples it was written from exactly. --decode-minutes N
+// sets the file length (default 3).
+
+namespace {
+
+constexpr int Rate = 44100;
+constexpr qint64 ChunkFrames = 4096;
+constexpr int DecoderTimeoutMs = 120000;
+
+struct Throughput {
+    bool ok = false;
+    double firstAudioMs = 0;
+    double totalMs = 0;
+    qint64 frames = 0;
+};
+
+Throughput decodeNative(const QString &path) {
+    Throughput result;
+    std::vector<float> buffer(ChunkFrames * 2);
+    QElapsedTimer timer;
+    timer.start();
+    std::unique_ptr<NativeDecoder> decoder = NativeDecoder::open(path);
+    if (!decoder) return result;
+    for (qint64 got; (got = decoder->read(buffer.data(), ChunkFrames, 1.0f)) > 0;) {
+        if (result.frames == 0) result.firstAudioMs = timer.nsecsElapsed() / 1e6;
+        result.frames += got;
+    }
+    result.totalMs = timer.nsecsElapsed() / 1e6;
+    result.ok = result.frames > 0;
+    return result;
+}
+
+Throughput decodeBackend(const QString &path) {
+    Throughput result;
+    QAudioDecoder decoder;
+    QEventLoop loop;
+    QElapsedTimer timer;
+    QObject::connect(&decoder, &QAudioDecoder::bufferReady, [&]() {
+        const QAudioBuffer buffer = decoder.read();
+        if (result.frames == 0) result.firstAudioMs = timer.nsecsElapsed() / 1e6;
+        result.frames += buffer.frameCount();
+    });
+    QObject::connect(&decoder, &QAudioDecoder::finished, [&]() {
+        result.totalMs = timer.nsecsElapsed() / 1e6;
+        result.ok = result.frames > 0;
+        loop.quit();
+    });
+    QObject::connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), &loop, &QEventLoop::quit);
+    QTimer::singleShot(DecoderTimeoutMs, &loop, &QEventLoop::quit);
+    timer.start();
+    decoder.setSource(QUrl::fromLocalFile(path));
+    decoder.start();
+    loop.exec();
+    return result;
+}
+
+using Expected = std::function<qint16(qint64 frame, int channel)>;
+
+// Samples of the native decode that differ from expected, or -1 if the decoder stops short.
+qint64 mismatches(const QString &path, qint64 frames, const Expected &expected) {
+    std::unique_ptr<NativeDecoder> decoder = NativeDecoder::open(path);
+    if (!decoder) return -1;
+    std::vector<float> buffer(ChunkFrames * 2);
+    qint64 at = 0;
+    qint64 wrong = 0;
+    for (qint64 got; (got = decoder->read(buffer.data(), ChunkFrames, 1.0f)) > 0; at += got) {
+        for (qint64 i = 0; i < got; ++i) {
+            for (int c = 0; c < 2; ++c) wrong += buffer[i * 2 + c] != expected(at + i, c) / 32768.0f;
+        }
+    }
+    return at == frames ? wrong : -1;
+}
+
+void report(const char *format, const char *decoder, const Throughput &result) {
+    Bench::report("decode", QString("%1 %2 first audio").arg(format, decoder), result.firstAudioMs, "ms");
+    Bench::report("decode", QString("%1 %2").arg(format, decoder),
+                  result.frames * 1000.0 / Rate / qMax(result.totalMs, 0.001), "x realtime");
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--decode-minutes");
+    const qint64 minutes = option >= 0 && option + 1 < args.size() ? qMax(1LL, args[option + 1].toLongLong()) : 3;
+    const qint64 frames = minutes * 60 * Rate;
+    QTemporaryDir dir;
+    const QString wav = dir.filePath("tone.wav");
+    const QString verbatim = dir.filePath("verbatim.flac");
+    const QString predicted = dir.filePath("predicted.flac");
+    if (!dir.isValid() || !ToneFile::writeWav(wav, Rate, 2, frames, 440.0) || !ToneFile::writeFlac(verbatim, Rate, 2, frames, 440.0)
+        || !ToneFile::writeFlac(predicted, Rate, 2, frames, 440.0, 0.5, ToneFile::FlacCoding::Predicted)) {
+        std::printf("decode: could not write the test files\n");
+        return 1;
+    }
+    const Expected tone = [](qint64 frame, int) { return ToneFile::sample(frame, Rate, 440.0); };
+    const Expected coded = [](qint64 frame, int channel) { return ToneFile::codedSample(frame, channel, Rate, 440.0); };
+    const struct {
+        const char *format;
+        QString path;
+        Expected expected;
+    } files[] = {{"WAV", wav, tone}, {"FLAC verbatim", verbatim, tone}, {"FLAC predicted", predicted, coded}};
+
+    bool ok = true;
+    for (const auto &[format, path, expected] : files) {
+        const Throughput native = decodeNative(path);
+        if (!native.ok || native.frames != frames) {
+            std::printf("decode: native %s decoded %lld of %lld frames\n", format, native.frames, frames);
+            ok = false;
+            continue;
+        }
+        const qint64 wrong = mismatches(path, frames, expected);
+        if (wrong != 0) {
+            std::printf("decode: native %s differs from the written samples in %lld places\n", format, wrong);
+            ok = false;
+            continue;
+        }
+        report(format, "native", native);
+        const Throughput backend = decodeBackend(path);
+        if (!backend.ok) {
+            std::printf("decode: QAudioDecoder %s skipped, the backend could not decode it\n", format);
+            continue;
+        }
+        report(format, "QAudioDecoder", backend);
+        Bench::report("decode", QString("%1 speedup").arg(format), backend.totalMs / qMax(native.totalMs, 0.001), "x");
+    }
+    return ok ? 0 : 1;
+}
+
+Bench registration("decode", "Native WAV/FLAC decoders against QAudioDecoder", run);
+
+} // namespace
@@ -0,0 +1,120 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QUrl>
+#include "bench.h"
+#include "playlistfile.h"
+
+// PlaylistFile import and export throughput on generated playlists, one per
+// format, each naming --import-entries N tracks (default 200000) by relative
+// path so every entry is resolved against the playlist's folder. Each import
+// goes into an empty store. On Linux the resident set growth across it is
+// reported too: apart from the store's own path lookup, which holds every
+// entry, it should not depend on the length of the file. The imported store
+// is then exported again in the same format.
+
+namespace {
+
+qint64 residentKb() {
+    QFile status("/proc/self/status");
+    if (!status.open(QIODevice::ReadOnly)) return -1;
+    for (QByteArray line; !(line = status.readLine()).isEmpty();) {
+        if (line.startsWith("VmRSS:")) return line.mid(6).trimmed().split(' ').value(0).toLongLong();
+    }
+    return -1;
+}
+
+QString track(qint64 i) {
+    return QString("artist%1/album%2/track %3.mp3").arg(i / 1000).arg(i / 12 % 100).arg(i % 12);
+}
+
+bool writePlaylist(const QString &fileName, PlaylistFile::Format format, const QString &folder, qint64 entries) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QByteArray out;
+    const auto flush = [&]() {
+        const bool written = file.write(out) == out.size();
+        out.clear();
+        return written;
+    };
+    switch (format) {
+    case PlaylistFile::M3u: out += "#EXTM3U\n"; break;
+    case PlaylistFile::Pls: out += "[playlist]\n"; break;
+    case PlaylistFile::Xspf: out += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<playlist version=\"1\" xmlns=\"http://xspf.org/ns/0/\">\n<trackList>\n"; break;
+    case PlaylistFile::PlainText: break;
+    }
+    for (qint64 i = 0; i < entries; ++i) {
+        const QByteArray path = track(i).toUtf8();
+        switch (format) {
+        case PlaylistFile::M3u:
+            out += "#EXTINF:" + QByteArray::number(180 + i % 120) + ",Artist " + QByteArray::number(i / 1000) + " - Track "
+                   + QByteArray::number(i) + '\n' + path + '\n';
+            break;
+        case PlaylistFile::Pls:
+            out += "File" + QByteArray::number(i + 1) + '=' + path + '\n';
+            break;
+        case PlaylistFile::Xspf:
+            out += "<track><location>" + QUrl::fromLocalFile(folder + '/' + track(i)).toEncoded() + "</location></track>\n";
+            break;
+        case PlaylistFile::PlainText:
+            out += path + '\n';
+            break;
+        }
+        if (out.size() >= 1 << 20 && !flush()) return false;
+    }
+    if (format == PlaylistFile::Pls) out += "NumberOfEntries=" + QByteArray::number(entries) + "\nVersion=2\n";
+    if (format == PlaylistFile::Xspf) out += "</trackList>\n</playlist>\n";
+    return flush();
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--import-entries");
+    const qint64 entries = option >= 0 && option + 1 < args.size() ? qMax(1LL, args[option + 1].toLongLong()) : 200000;
+    QTemporaryDir dir;
+    if (!dir.isValid()) return 1;
+    TagCache tags;
+    bool ok = true;
+    const struct {
+        PlaylistFile::Format format;
+        const char *name;
+        const char *extension;
+    } formats[] = {{PlaylistFile::PlainText, "text", "txt"}, {PlaylistFile::M3u, "M3U", "m3u8"},
+                   {PlaylistFile::Pls, "PLS", "pls"}, {PlaylistFile::Xspf, "XSPF", "xspf"}};
+    for (const auto &format : formats) {
+        const QString source = dir.filePath(QString("import.%1").arg(format.extension));
+        if (!writePlaylist(source, format.format, dir.path(), entries)) {
+            std::printf("import: could not write the %s playlist\n", format.name);
+            return 1;
+        }
+        PlaylistStore store;
+        if (!store.open(dir.filePath(QString("store-%1").arg(format.extension)))) return 1;
+        PlaylistFile playlist(store);
+        const qint64 before = residentKb();
+        const int added = playlist.importFile(source);
+        const qint64 after = residentKb();
+        const PlaylistFile::ImportStats stats = playlist.importStats();
+        if (added != entries) {
+            std::printf("import: %s added %d of %lld entries: %s\n", format.name, added, entries,
+                        qPrintable(playlist.errorString()));
+            ok = false;
+            continue;
+        }
+        const double seconds = qMax<qint64>(1, stats.elapsedMs) / 1000.0;
+        Bench::report("import", QString("%1 import").arg(format.name), stats.entries / seconds, "entries/s");
+        Bench::report("import", QString("%1 import bytes").arg(format.name), stats.bytes / seconds / (1 << 20), "MB/s");
+        if (before >= 0 && after >= 0) Bench::report("import", QString("%1 resident growth").arg(format.name), (after - before) / 1024.0, "MB");
+
+        QElapsedTimer timer;
+        timer.start();
+        if (!playlist.exportFile(dir.filePath(QString("export.%1").arg(format.extension)), &tags)) {
+            std::printf("import: %s export failed: %s\n", format.name, qPrintable(playlist.errorString()));
+            ok = false;
+            continue;
+        }
+        Bench::report("import", QString("%1 export").arg(format.name), entries / qMax(timer.nsecsElapsed() / 1e9, 1e-9), "entries/s");
+    }
+    return ok ? 0 : 1;
+}
+
+Bench registration("import", "Playlist import and export throughput per format", run);
+
+} // namespace
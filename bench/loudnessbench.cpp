@@ -0,0 +1,73 @@
+#include <QEventLoop>
+#include <QFile>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include "bench.h"
+#include "loudnessanalyzer.h"
+#include "tonefile.h"
+
+// Library loudness analysis: --loudness-tracks N generated three-minute WAV
+// tracks (default 4 per core) handed to one LoudnessAnalyzer at once, timed
+// from analyze() to the last analyzed() signal. Reports the audio analyzed
+// per second of wall time as a multiple of real time, overall and per core.
+// The analyzer keeps its cache under the test mode's cache directory, removed
+// first so every track is decoded.
+
+namespace {
+
+constexpr int Rate = 44100;
+constexpr qint64 TrackFrames = qint64(Rate) * 180;
+constexpr int AnalyzeTimeoutMs = 600000;
+
+int run(const QStringList &args) {
+    const int cores = qMax(1, QThread::idealThreadCount());
+    const qsizetype option = args.indexOf("--loudness-tracks");
+    const int tracks = option >= 0 && option + 1 < args.size() ? qMax(1, args[option + 1].toInt()) : 4 * cores;
+    QStandardPaths::setTestModeEnabled(true);
+    QFile::remove(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/loudness.bin");
+    QTemporaryDir dir;
+    QStringList paths;
+    for (int i = 0; i < tracks; ++i) {
+        paths.append(dir.filePath(QString("track%1.wav").arg(i)));
+        if (!dir.isValid() || !ToneFile::writeWav(paths.last(), Rate, 2, TrackFrames, 220.0 + 20.0 * i)) {
+            std::printf("loudness: could not write the test files\n");
+            return 1;
+        }
+    }
+
+    int analyzed = 0;
+    double elapsedMs = 0;
+    {
+        LoudnessAnalyzer analyzer;
+        QEventLoop loop;
+        QElapsedTimer timer;
+        QObject::connect(&analyzer, &LoudnessAnalyzer::analyzed, &loop, [&]() {
+            if (++analyzed < tracks) return;
+            elapsedMs = timer.nsecsElapsed() / 1e6;
+            loop.quit();
+        });
+        QTimer::singleShot(AnalyzeTimeoutMs, &loop, &QEventLoop::quit);
+        timer.start();
+        analyzer.analyze(paths);
+        loop.exec();
+    }
+    if (analyzed == 0) {
+        std::printf("loudness: skipped, the backend could not decode the test files\n");
+        return 0;
+    }
+    if (analyzed < tracks) {
+        std::printf("loudness: analyzed %d of %d tracks\n", analyzed, tracks);
+        return 1;
+    }
+    const double realtime = tracks * (static_cast<double>(TrackFrames) / Rate) / qMax(elapsedMs / 1000.0, 1e-9);
+    Bench::report("loudness", QString("%1 tracks").arg(tracks), elapsedMs, "ms");
+    Bench::report("loudness", "analysis", realtime, "x realtime");
+    Bench::report("loudness", "analysis per core", realtime / cores, "x realtime");
+    return 0;
+}
+
+Bench registration("loudness", "Library loudness analysis throughput across the worker pool", run);
+
+} // namespace
@@ -0,0 +1,32 @@
+#include <QApplication>
+#include <QStringList>
+#include <cstdio>
+#include "bench.h"
+
+// apexbench [section...] [--option value...]
+// With no section names every section runs in registration order.
+int main(int argc, char *argv[]) {
+    QApplication app(argc, argv);
+    QCoreApplication::setApplicationName("ApexMusicBench");
+    const QStringList args = app.arguments().mid(1);
+
+    QStringList names;
+    for (const QString &arg : args) {
+        if (arg.startsWith("--")) break;
+        names.append(arg);
+    }
+    if (names.contains("list")) {
+        for (const Bench::Section &section : Bench::all()) std::printf("%-10s %s\n", section.name, section.summary);
+        return 0;
+    }
+
+    int failures = 0;
+    for (const Bench::Section &section : Bench::all()) {
+        if (!names.isEmpty() && !names.contains(QLatin1String(section.name))) continue;
+        if (section.run(args) != 0) {
+            std::fprintf(stderr, "%s: failed\n", section.name);
+            ++failures;
+        }
+    }
+    return failures ? 1 : 0;
+}
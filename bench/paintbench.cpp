@@ -0,0 +1,105 @@
+#include <QDir>
+#include <QEventLoop>
+#include <QMediaDevices>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTimer>
+#include "bench.h"
+#include "mediacontrolwidget.h"
+#include "tonefile.h"
+
+// Panel paint time per frame while a generated tone plays, read from the
+// widget's own paintStats() counters. The panel runs shown, on its frame
+// clock, for --paint-frames N frames (default 600) per mode:
+// - dirty rect: as shipped, each frame repaints only the visualizer and
+//   progress regions over the cached static layer;
+// - full repaint: each tick also drops the static layer, through the same
+//   DevicePixelRatioChange event a screen change sends, and updates the whole
+//   panel, i.e. what every frame cost before the layer was cached.
+// Run with QT_QPA_PLATFORM=offscreen where there is no display. Needs an audio
+// output, since the clock only runs while the track plays.
+
+namespace {
+
+constexpr int FrameTimeoutMs = 1000;
+
+template <typename Done>
+bool waitFor(Done done, int timeoutMs) {
+    QEventLoop loop;
+    QTimer poll;
+    QObject::connect(&poll, &QTimer::timeout, &loop, [&]() {
+        if (done()) loop.quit();
+    });
+    poll.start(5);
+    QTimer::singleShot(timeoutMs, &loop, &QEventLoop::quit);
+    if (!done()) loop.exec();
+    return done();
+}
+
+// Mean ns of the panel's paints over the next frames clock frames, or -1 if the clock stalls.
+double measure(MediaControlWidget &panel, FrameClock &clock, int frames) {
+    const MediaControlWidget::PaintStats before = panel.paintStats();
+    const quint64 start = clock.frameCount();
+    if (!waitFor([&]() { return clock.frameCount() >= start + frames; }, frames * FrameTimeoutMs)) return -1;
+    const MediaControlWidget::PaintStats after = panel.paintStats();
+    const quint64 paints = after.frames - before.frames;
+    if (paints == 0) return -1;
+    const double totalNs = static_cast<double>(after.averageNs) * after.frames - static_cast<double>(before.averageNs) * before.frames;
+    return totalNs / paints;
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--paint-frames");
+    const int frames = option >= 0 && option + 1 < args.size() ? qMax(1, args[option + 1].toInt()) : 600;
+    if (QMediaDevices::audioOutputs().isEmpty()) {
+        std::printf("paint: skipped, no audio output to play through\n");
+        return 0;
+    }
+    // The panel keeps its playlist in the working directory and its caches under the app's paths
+    QStandardPaths::setTestModeEnabled(true);
+    QTemporaryDir dir;
+    const QString tone = dir.filePath("tone.wav");
+    if (!dir.isValid() || !ToneFile::writeWav(tone, 44100, 2, 44100 * 600, 440.0)) {
+        std::printf("paint: could not write the test file\n");
+        return 1;
+    }
+    const QString previousDir = QDir::currentPath();
+    QDir::setCurrent(dir.path());
+
+    int result = 0;
+    {
+        MediaControlWidget panel;
+        FrameClock *clock = panel.findChild<FrameClock *>();
+        panel.show();
+        panel.loadMediaFile(tone);
+        if (!clock || !waitFor([&]() { return clock->isActive(); }, 10000)) {
+            std::printf("paint: the tone never started playing\n");
+            result = 1;
+        } else {
+            // Let the waveform overview and the first frames settle into the static layer
+            measure(panel, *clock, 60);
+            const double dirty = measure(panel, *clock, frames);
+            const QMetaObject::Connection forced = QObject::connect(clock, &FrameClock::tick, &panel, [&panel]() {
+                QEvent change(QEvent::DevicePixelRatioChange);
+                QCoreApplication::sendEvent(&panel, &change);
+                panel.update();
+            });
+            const double full = measure(panel, *clock, frames);
+            QObject::disconnect(forced);
+            if (dirty < 0 || full < 0) {
+                std::printf("paint: the frame clock stalled\n");
+                result = 1;
+            } else {
+                Bench::report("paint", "dirty rect", dirty, "ns/frame");
+                Bench::report("paint", "full repaint", full, "ns/frame");
+                Bench::report("paint", "speedup", full / qMax(dirty, 1.0), "x");
+            }
+        }
+    }
+    QDir::setCurrent(previousDir);
+    return result;
+}
+
+Bench registration("paint", "Panel paint time per frame, dirty rects against full repaints", run);
+
+} // namespace
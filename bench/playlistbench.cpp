@@ -0,0 +1,117 @@
+#include <QListView>
+#include <QScrollBar>
+#include <QTemporaryDir>
+#include <random>
+#include "bench.h"
+#include "playlistdialog.h"
+
+// The song picker over generated playlists of 10k, 100k and 1M entries, one in
+// a hundred of them removed so rows go through the store's live mapping. First
+// paint is the dialog's construction and show() plus a full synchronous render
+// of it. Scroll frames alternate a page step with a jump to a random row, each
+// followed by a synchronous repaint of the list, and report the mean and worst
+// frame. Queries are then typed into the search index a key at a time, every
+// path indexed, and each keystroke's search() reports as one query, as the
+// picker's filter runs it; a keystroke should answer within a 16 ms frame.
+// Run with QT_QPA_PLATFORM=offscreen where there is no display.
+
+namespace {
+
+constexpr int ScrollFrames = 200;
+constexpr qsizetype AppendBatch = 50000;
+// Typed a character at a time: a key held by every entry, one held by a twelfth
+// of them, and a misspelt one that only matches in part
+const char *const Queries[] = {"track", "album 42 track 7", "albm 4 trak"};
+
+bool buildStore(PlaylistStore &store, const QString &base, qsizetype entries) {
+    if (!store.open(base)) return false;
+    QStringList batch;
+    batch.reserve(AppendBatch);
+    for (qsizetype i = 0; i < entries; ++i) {
+        batch.append(QString("/music/artist%1/album%2/track%3.mp3").arg(i / 1000).arg(i / 12 % 100).arg(i % 12));
+        if (batch.size() == AppendBatch || i + 1 == entries) {
+            if (store.appendBatch(batch) < 0) return false;
+            batch.clear();
+        }
+    }
+    QList<qsizetype> removed;
+    for (qsizetype i = 50; i < entries; i += 100) removed.append(i);
+    if (store.removeBatch(removed) < 0) return false;
+    // Reopened, the entries are mapped from disk as they are at startup
+    store.close();
+    return store.open(base);
+}
+
+int run(const QStringList &) {
+    PathValidator validator;
+    TagCache tags;
+    std::mt19937 random(1);
+    for (qsizetype entries : {qsizetype(10000), qsizetype(100000), qsizetype(1000000)}) {
+        QTemporaryDir dir;
+        PlaylistStore store;
+        if (!dir.isValid() || !buildStore(store, dir.filePath("playlist"), entries)) {
+            std::printf("playlist: could not build a store of %lld entries\n", static_cast<long long>(entries));
+            return 1;
+        }
+
+        SearchIndex search(&tags);
+        QElapsedTimer timer;
+        timer.start();
+        PlaylistDialog dialog(store, &validator, &tags, &search);
+        dialog.show();
+        dialog.grab();
+        Bench::report("playlist", QString("first paint %1").arg(entries), timer.nsecsElapsed() / 1e6, "ms");
+
+        QListView *list = dialog.findChild<QListView *>();
+        QScrollBar *bar = list->verticalScrollBar();
+        std::uniform_int_distribution<int> row(0, bar->maximum());
+        double totalMs = 0, worstMs = 0;
+        for (int frame = 0; frame < ScrollFrames; ++frame) {
+            timer.restart();
+            if (frame % 2) bar->setValue(row(random));
+            else bar->setValue(qMin(bar->maximum(), bar->value() + bar->pageStep()));
+            list->viewport()->repaint();
+            const double ms = timer.nsecsElapsed() / 1e6;
+            totalMs += ms;
+            worstMs = qMax(worstMs, ms);
+        }
+        Bench::report("playlist", QString("scroll frame mean %1").arg(entries), totalMs / ScrollFrames, "ms");
+        Bench::report("playlist", QString("scroll frame max %1").arg(entries), worstMs, "ms");
+
+        QList<qsizetype> indexed;
+        QStringList paths;
+        indexed.reserve(store.liveCount());
+        paths.reserve(store.liveCount());
+        for (qsizetype live = 0; live < store.liveCount(); ++live) {
+            indexed.append(store.liveIndex(live));
+            paths.append(store.path(indexed.last()));
+        }
+        search.index(indexed, paths);
+        search.waitForIndexed();
+        totalMs = worstMs = 0;
+        int keystrokes = 0;
+        for (const char *query : Queries) {
+            const QString typed = QString::fromLatin1(query);
+            for (qsizetype length = 1; length <= typed.size(); ++length) {
+                timer.restart();
+                const QList<qsizetype> found = search.search(typed.left(length));
+                const double ms = timer.nsecsElapsed() / 1e6;
+                if (found.isEmpty()) {
+                    std::printf("playlist: \"%s\" found nothing in %lld entries\n", qPrintable(typed.left(length)),
+                                static_cast<long long>(entries));
+                    return 1;
+                }
+                totalMs += ms;
+                worstMs = qMax(worstMs, ms);
+                ++keystrokes;
+            }
+        }
+        Bench::report("playlist", QString("query keystroke mean %1").arg(entries), totalMs / keystrokes, "ms");
+        Bench::report("playlist", QString("query keystroke max %1").arg(entries), worstMs, "ms");
+    }
+    return 0;
+}
+
+Bench registration("playlist", "Song picker first paint, scrolling and search at 10k-1M entries", run);
+
+} // namespace
@@ -0,0 +1,81 @@
+#include <QDir>
+#include <QDirIterator>
+#include <QEventLoop>
+#include <QFile>
+#include <QTemporaryDir>
+#include "bench.h"
+#include "libraryscanner.h"
+
+// LibraryScanner over a generated tree laid out as artist/album/track files
+// with a cover image per album, compared with a single-threaded QDirIterator
+// walk of the same tree. --scan-files N sets the number of tracks (default
+// 100000; the scanner is meant to handle 500000). The tree was just written,
+// so both walks read from a warm page cache.
+
+namespace {
+
+constexpr int TracksPerAlbum = 12;
+constexpr int AlbumsPerArtist = 8;
+
+bool buildTree(const QString &root, qint64 tracks) {
+    static constexpr const char *Extensions[] = {".mp3", ".flac", ".ogg", ".wav", ".mp4"};
+    for (qint64 made = 0, album = 0; made < tracks; ++album) {
+        const QString directory = QString("%1/artist%2/album%3").arg(root).arg(album / AlbumsPerArtist).arg(album % AlbumsPerArtist);
+        if (!QDir().mkpath(directory)) return false;
+        QFile cover(directory + "/cover.jpg");
+        if (!cover.open(QIODevice::WriteOnly)) return false;
+        for (int track = 0; track < TracksPerAlbum && made < tracks; ++track, ++made) {
+            QFile file(QString("%1/track%2%3").arg(directory).arg(track).arg(Extensions[made % 5]));
+            if (!file.open(QIODevice::WriteOnly)) return false;
+        }
+    }
+    return true;
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--scan-files");
+    const qint64 tracks = option >= 0 && option + 1 < args.size() ? args[option + 1].toLongLong() : 100000;
+    QTemporaryDir dir;
+    QElapsedTimer timer;
+    timer.start();
+    if (!dir.isValid() || !buildTree(dir.path(), tracks)) {
+        std::printf("scan: could not build the tree\n");
+        return 1;
+    }
+    Bench::report("scan", QString("build %1 tracks").arg(tracks), timer.elapsed(), "ms");
+
+    // Single-threaded reference walk
+    timer.restart();
+    qint64 iterated = 0;
+    QDirIterator it(dir.path(), {"*.mp3", "*.mp4", "*.wav", "*.ogg", "*.flac"}, QDir::Files, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        ++iterated;
+    }
+    const qint64 iteratorMs = qMax<qint64>(1, timer.elapsed());
+    Bench::report("scan", "QDirIterator", iterated * 1000.0 / iteratorMs, "files/s");
+
+    LibraryScanner scanner;
+    qint64 found = 0;
+    qint64 scanMs = 0;
+    QEventLoop loop;
+    QObject::connect(&scanner, &LibraryScanner::filesFound, [&](const QStringList &paths) { found += paths.size(); });
+    QObject::connect(&scanner, &LibraryScanner::finished, [&](qint64, qint64, qint64 elapsedMs) {
+        scanMs = qMax<qint64>(1, elapsedMs);
+        loop.quit();
+    });
+    scanner.start({dir.path()});
+    loop.exec();
+    Bench::report("scan", "LibraryScanner", found * 1000.0 / scanMs, "files/s");
+    Bench::report("scan", "speedup", static_cast<double>(iteratorMs) / scanMs, "x");
+
+    if (found != tracks || iterated != tracks) {
+        std::printf("scan: expected %lld tracks, scanner found %lld, iterator %lld\n", tracks, found, iterated);
+        return 1;
+    }
+    return 0;
+}
+
+Bench registration("scan", "LibraryScanner over a generated tree", run);
+
+} // namespace
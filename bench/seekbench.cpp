@@ -0,0 +1,217 @@
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtEndian>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "nativedecoder.h"
+#include "seekindex.h"
+#include "tonefile.h"
+
+// Seek latency and accuracy on generated files. A FLAC tone is indexed and
+// then sought through the native decoder at random targets, with and without
+// the index: latency covers the seek, decoding up to the target and the first
+// block after it, and the samples after the target are compared with the tone
+// itself. An MP3 stream of valid but silent frames behind a LAME Info frame
+// checks the MP3 index: encoder delay, how far before each target the chosen
+// entry lies, and that a SplicedDevice opened at an entry reads the stream's
+// header followed by the file from that entry's frame, byte for byte.
+//
+// MP3 seek accuracy in samples is not measured: nothing here encodes real MP3
+// audio, and the silent frames decode to zeros wherever they start. What the
+// backend's decoder makes of the splice, in particular how it applies the
+// encoder delay and how many warm-up samples it needs, is taken on trust, so
+// MP3 seeks should be treated as accurate to within a frame or so.
+// --seek-minutes N sets the length of both files (default 5).
+
+namespace {
+
+constexpr int Rate = 44100;
+constexpr double Hz = 441.0;
+constexpr int Seeks = 200;
+constexpr int UnindexedSeeks = 20;
+constexpr qint64 CheckFrames = 4096;
+constexpr int SpliceChecks = 20;
+
+// MPEG-1 Layer III, 128 kbit/s, 44.1 kHz, stereo, no padding
+constexpr uchar Mp3Header[4] = {0xff, 0xfb, 0x90, 0x00};
+constexpr int Mp3FrameBytes = 417;
+constexpr int Mp3FrameSamples = 1152;
+constexpr int LameDelay = 576;
+
+bool writeMp3(const QString &fileName, qint64 frames) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly)) return false;
+    QByteArray frame(Mp3FrameBytes, 0);
+    std::memcpy(frame.data(), Mp3Header, 4);
+    // Info frame: tag after the 32 bytes of stereo side info, no optional fields, then the LAME extension
+    QByteArray info = frame;
+    std::memcpy(info.data() + 36, "Info", 4);
+    std::memcpy(info.data() + 44, "LAME", 4);
+    info[44 + 21] = char(LameDelay >> 4);
+    info[44 + 22] = char((LameDelay & 0xf) << 4);
+    if (file.write(info) != info.size()) return false;
+    for (qint64 i = 0; i < frames; ++i) {
+        if (file.write(frame) != frame.size()) return false;
+    }
+    return file.flush();
+}
+
+bool buildIndex(const QString &fileName, SeekIndex &index, double &ms) {
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) return false;
+    const uchar *data = file.map(0, file.size());
+    if (!data) return false;
+    QElapsedTimer timer;
+    timer.start();
+    const bool built = SeekIndex::build(data, file.size(), index);
+    ms = timer.nsecsElapsed() / 1e6;
+    file.unmap(const_cast<uchar *>(data));
+    return built;
+}
+
+struct SeekResult {
+    double meanMs = 0;
+    double maxMs = 0;
+    double meanDroppedMs = 0;
+    float maxError = 0;
+};
+
+// Seeks decoder to each target, drops up to it and reads CheckFrames, comparing them with the tone.
+bool seekAll(NativeDecoder &decoder, const SeekIndex *index, const std::vector<qint64> &targets, SeekResult &result) {
+    std::vector<float> buffer(CheckFrames * 2);
+    QElapsedTimer timer;
+    double totalMs = 0, droppedFrames = 0;
+    for (qint64 target : targets) {
+        timer.start();
+        qint64 at = decoder.seek(target, index);
+        droppedFrames += target - at;
+        while (at < target) {
+            const qint64 got = decoder.read(buffer.data(), qMin<qint64>(CheckFrames, target - at), 1.0f);
+            if (got <= 0) return false;
+            at += got;
+        }
+        if (decoder.read(buffer.data(), CheckFrames, 1.0f) != CheckFrames) return false;
+        const double ms = timer.nsecsElapsed() / 1e6;
+        totalMs += ms;
+        result.maxMs = qMax(result.maxMs, ms);
+        for (qint64 i = 0; i < CheckFrames; ++i) {
+            const float expected = ToneFile::sample(target + i, Rate, Hz) / 32768.0f;
+            result.maxError = qMax(result.maxError, std::abs(buffer[i * 2] - expected));
+        }
+    }
+    result.meanMs = totalMs / targets.size();
+    result.meanDroppedMs = droppedFrames * 1000.0 / Rate / targets.size();
+    return true;
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--seek-minutes");
+    const qint64 minutes = option >= 0 && option + 1 < args.size() ? qMax(1LL, args[option + 1].toLongLong()) : 5;
+    const qint64 frames = minutes * 60 * Rate;
+    QTemporaryDir dir;
+    const QString flac = dir.filePath("tone.flac");
+    const QString mp3 = dir.filePath("silence.mp3");
+    if (!dir.isValid() || !ToneFile::writeFlac(flac, Rate, 2, frames, Hz)
+        || !writeMp3(mp3, frames / Mp3FrameSamples)) {
+        std::printf("seek: could not write the test files\n");
+        return 1;
+    }
+
+    bool ok = true;
+    SeekIndex flacIndex;
+    double buildMs = 0;
+    if (!buildIndex(flac, flacIndex, buildMs)) {
+        std::printf("seek: the FLAC file could not be indexed\n");
+        return 1;
+    }
+    Bench::report("seek", QString("FLAC index build, %1 min").arg(minutes), buildMs, "ms");
+    Bench::report("seek", "FLAC index entries", flacIndex.entries.size(), "entries");
+
+    std::unique_ptr<NativeDecoder> decoder = NativeDecoder::open(flac);
+    if (!decoder) {
+        std::printf("seek: the FLAC file could not be opened\n");
+        return 1;
+    }
+    std::mt19937 random(1);
+    std::uniform_int_distribution<qint64> position(0, frames - CheckFrames - 1);
+    std::vector<qint64> targets(Seeks);
+    for (qint64 &target : targets) target = position(random);
+
+    SeekResult indexed;
+    SeekResult unindexed;
+    if (!seekAll(*decoder, &flacIndex, targets, indexed)
+        || !seekAll(*decoder, nullptr, std::vector<qint64>(targets.begin(), targets.begin() + UnindexedSeeks), unindexed)) {
+        std::printf("seek: the FLAC file ended early after a seek\n");
+        return 1;
+    }
+    Bench::report("seek", "FLAC indexed mean", indexed.meanMs, "ms");
+    Bench::report("seek", "FLAC indexed max", indexed.maxMs, "ms");
+    Bench::report("seek", "FLAC indexed decoded before target", indexed.meanDroppedMs, "ms");
+    Bench::report("seek", "FLAC indexed max sample error", indexed.maxError, "");
+
+    Bench::report("seek", "FLAC unindexed mean", unindexed.meanMs, "ms");
+    Bench::report("seek", "FLAC unindexed max", unindexed.maxMs, "ms");
+    Bench::report("seek", "FLAC unindexed max sample error", unindexed.maxError, "");
+    if (indexed.maxError > 0 || unindexed.maxError > 0) {
+        std::printf("seek: decoded samples after a seek differ from the tone\n");
+        ok = false;
+    }
+
+    SeekIndex mp3Index;
+    if (!buildIndex(mp3, mp3Index, buildMs)) {
+        std::printf("seek: the MP3 file could not be indexed\n");
+        return 1;
+    }
+    Bench::report("seek", QString("MP3 index build, %1 min").arg(minutes), buildMs, "ms");
+    Bench::report("seek", "MP3 index entries", mp3Index.entries.size(), "entries");
+    if (mp3Index.leadIn != LameDelay + 529) {
+        std::printf("seek: MP3 lead-in %u, expected %d\n", mp3Index.leadIn, LameDelay + 529);
+        ok = false;
+    }
+    // Decoded before the target: the warm-up frames plus the distance to the entry before them
+    double totalLead = 0, maxLead = 0;
+    bool past = false;
+    const quint64 streamSamples = mp3Index.totalSamples;
+    std::uniform_int_distribution<quint64> sample(mp3Index.warmupSamples, streamSamples - 1);
+    const double lookupNs = Bench::nsPerCall([&]() { mp3Index.entryFor(sample(random)); });
+    for (int i = 0; i < Seeks; ++i) {
+        const quint64 target = sample(random);
+        const SeekIndex::Entry &entry = mp3Index.entryFor(target);
+        const double lead = (target - entry.sample) * 1000.0 / mp3Index.sampleRate;
+        past = past || entry.sample + mp3Index.warmupSamples > target;
+        totalLead += lead;
+        maxLead = qMax(maxLead, lead);
+    }
+    Bench::report("seek", "MP3 entry lookup", lookupNs, "ns");
+    Bench::report("seek", "MP3 decoded before target mean", totalLead / Seeks, "ms");
+    Bench::report("seek", "MP3 decoded before target max", maxLead, "ms");
+    // At most one second between entries, plus the warm-up and the frame the target falls in
+    if (past || maxLead > 1000.0 + (mp3Index.warmupSamples + Mp3FrameSamples) * 1000.0 / mp3Index.sampleRate) {
+        std::printf("seek: an MP3 index entry was too far before its target or past it\n");
+        ok = false;
+    }
+
+    // What the backend's decoder is given after a seek: the header bytes, then the stream from the entry
+    QFile whole(mp3);
+    if (!whole.open(QIODevice::ReadOnly)) return 1;
+    const QByteArray bytes = whole.readAll();
+    int badSplices = 0;
+    for (int i = 0; i < SpliceChecks; ++i) {
+        const SeekIndex::Entry &entry = mp3Index.entryFor(sample(random));
+        SplicedDevice spliced(mp3, mp3Index.headerBytes, entry.offset);
+        const QByteArray expected = bytes.left(static_cast<qsizetype>(mp3Index.headerBytes)) + bytes.mid(static_cast<qsizetype>(entry.offset));
+        if (!spliced.isOpen() || spliced.size() != expected.size() || spliced.readAll() != expected) ++badSplices;
+    }
+    if (badSplices > 0) {
+        std::printf("seek: %d of %d MP3 splices did not read the header and the stream from their entry\n", badSplices, SpliceChecks);
+        ok = false;
+    }
+    return ok ? 0 : 1;
+}
+
+Bench registration("seek", "Seek index latency and accuracy on generated files", run);
+
+} // namespace
@@ -0,0 +1,57 @@
+#include <QElapsedTimer>
+#include <vector>
+#include "bench.h"
+#include "shuffleengine.h"
+
+// ShuffleEngine over a 1M-entry playlist: reset, next() across cycle
+// boundaries, previous()/next() through the history, and appends into a
+// running cycle. Also checks that a cycle plays every entry exactly once and
+// that no entry repeats within the no-repeat window across the boundary.
+
+namespace {
+
+constexpr qsizetype Entries = 1000000;
+
+int run(const QStringList &) {
+    ShuffleEngine shuffle;
+    QElapsedTimer timer;
+    timer.start();
+    shuffle.reset(Entries);
+    Bench::report("shuffle", "reset 1M", timer.nsecsElapsed() / 1e6, "ms");
+
+    // Two full cycles, so one reshuffle and its window repair fall inside the timing
+    std::vector<qint64> lastSeen(Entries, -1);
+    std::vector<quint8> playedInCycle(Entries, 0);
+    qint64 closestRepeat = Entries;
+    bool complete = true;
+    timer.restart();
+    for (qint64 step = 0; step < Entries * 2; ++step) {
+        const qsizetype index = shuffle.next();
+        if (step < Entries) playedInCycle[index]++;
+        if (lastSeen[index] >= 0) closestRepeat = qMin(closestRepeat, step - lastSeen[index]);
+        lastSeen[index] = step;
+    }
+    const double nextNs = static_cast<double>(timer.nsecsElapsed()) / (Entries * 2);
+    for (quint8 count : playedInCycle) complete = complete && count == 1;
+    Bench::report("shuffle", "next", nextNs, "ns");
+    Bench::report("shuffle", "closest repeat", closestRepeat, "tracks");
+
+    const double historyNs = Bench::nsPerCall([&]() {
+        shuffle.previous();
+        shuffle.next();
+    });
+    Bench::report("shuffle", "previous+next", historyNs, "ns");
+
+    constexpr int Appends = 100000;
+    timer.restart();
+    for (int i = 0; i < Appends; ++i) shuffle.append();
+    Bench::report("shuffle", "append", static_cast<double>(timer.nsecsElapsed()) / Appends, "ns");
+
+    if (!complete) std::printf("shuffle: a cycle did not play every entry exactly once\n");
+    if (closestRepeat <= shuffle.noRepeatWindow()) std::printf("shuffle: an entry repeated inside the window\n");
+    return complete && closestRepeat > shuffle.noRepeatWindow() ? 0 : 1;
+}
+
+Bench registration("shuffle", "ShuffleEngine over 1M entries", run);
+
+} // namespace
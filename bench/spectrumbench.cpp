@@ -0,0 +1,78 @@
+#include <QCoreApplication>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "bench.h"
+#include "spectrumkernel.h"
+#include "spectrumanalyzer.h"
+
+// ns per frame of the analyzer's per-hop work (windowed FFT, band peaks and
+// smoothing) at 1024, 2048 and 4096 points, for every instruction set. The
+// kernel picks its path once per process, so each one runs in a child
+// started with APEXMUSIC_SIMD set; paths the CPU lacks are reported skipped.
+
+namespace {
+
+int runIsa(const QString &requested) {
+    const char *isa = SpectrumKernel::isaName(SpectrumKernel::isa());
+    if (requested != QLatin1String(isa)) {
+        std::printf("spectrum: %s skipped, CPU runs %s\n", qPrintable(requested), isa);
+        return 0;
+    }
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> sample(-1.0f, 1.0f);
+    for (int n : {1024, 2048, 4096}) {
+        std::vector<float> input(n), window(n), spectrum(n / 2 + 1);
+        for (int i = 0; i < n; ++i) {
+            input[i] = sample(random);
+            window[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (n - 1));
+        }
+        // Same log spacing as SpectrumAnalyzer::buildBands at 48 kHz
+        constexpr int Bands = SpectrumAnalyzer::BandCount;
+        std::vector<int> bandStart(Bands + 1);
+        const float binHz = 48000.0f / n;
+        int previous = 0;
+        for (int b = 0; b <= Bands; ++b) {
+            const float hz = 40.0f * std::pow(16000.0f / 40.0f, static_cast<float>(b) / Bands);
+            int bin = std::clamp(static_cast<int>(std::lround(hz / binHz)), 1, n / 2);
+            if (b > 0 && bin <= previous) bin = std::min(previous + 1, n / 2);
+            bandStart[b] = previous = bin;
+        }
+        std::vector<float> peaks(Bands), levels(Bands, 0.1f), peakLevels(Bands, 0.1f);
+
+        SpectrumKernel kernel(n);
+        const double fft = Bench::nsPerCall([&]() { kernel.magnitudes(input.data(), window.data(), spectrum.data()); });
+        const double frame = Bench::nsPerCall([&]() {
+            kernel.magnitudes(input.data(), window.data(), spectrum.data());
+            SpectrumKernel::bandPeaks(spectrum.data(), bandStart.data(), Bands, peaks.data());
+            SpectrumKernel::smooth(levels.data(), peakLevels.data(), peaks.data(), Bands);
+        });
+        Bench::report("spectrum", QString("%1 fft n=%2").arg(isa).arg(n), fft, "ns/frame");
+        Bench::report("spectrum", QString("%1 frame n=%2").arg(isa).arg(n), frame, "ns/frame");
+    }
+    return 0;
+}
+
+int run(const QStringList &args) {
+    const qsizetype child = args.indexOf("--spectrum-isa");
+    if (child >= 0 && child + 1 < args.size()) return runIsa(args[child + 1]);
+
+    int failures = 0;
+    for (const char *isa : {"scalar", "sse2", "avx2"}) {
+        QProcess process;
+        QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+        environment.insert("APEXMUSIC_SIMD", isa);
+        process.setProcessEnvironment(environment);
+        process.setProcessChannelMode(QProcess::ForwardedChannels);
+        process.start(QCoreApplication::applicationFilePath(), {"spectrum", "--spectrum-isa", isa});
+        if (!process.waitForFinished(-1) || process.exitCode() != 0) ++failures;
+    }
+    return failures;
+}
+
+Bench registration("spectrum", "FFT and per-frame analyzer cost per instruction set", run);
+
+} // namespace
@@ -0,0 +1,69 @@
+#include <QDir>
+#include <QEventLoop>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTimer>
+#include "bench.h"
+#include "tonefile.h"
+#include "waveformcache.h"
+
+// Seek bar overview of a generated FLAC file of fixed and LPC subframes,
+// --waveform-minutes N long (default 10): the time from request() to ready()
+// with no peak file, i.e. one full decode and the peak file written, as a
+// multiple of real time, and the same request again once the file is current,
+// which only checks its stamp and maps it. The cache works under the test
+// mode's cache directory, emptied first.
+
+namespace {
+
+constexpr int Rate = 44100;
+constexpr int ReadyTimeoutMs = 600000;
+
+// Ms from request() to ready() for path, or -1 if it never came.
+double timeRequest(WaveformCache &cache, const QString &path) {
+    QEventLoop loop;
+    bool ready = false;
+    const QMetaObject::Connection connection = QObject::connect(&cache, &WaveformCache::ready, &loop, [&]() {
+        ready = true;
+        loop.quit();
+    });
+    QTimer::singleShot(ReadyTimeoutMs, &loop, &QEventLoop::quit);
+    QElapsedTimer timer;
+    timer.start();
+    cache.request(path);
+    loop.exec();
+    const double ms = timer.nsecsElapsed() / 1e6;
+    QObject::disconnect(connection);
+    return ready && cache.isReady() ? ms : -1;
+}
+
+int run(const QStringList &args) {
+    const qsizetype option = args.indexOf("--waveform-minutes");
+    const int minutes = option >= 0 && option + 1 < args.size() ? qMax(1, args[option + 1].toInt()) : 10;
+    QStandardPaths::setTestModeEnabled(true);
+    QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/waveforms").removeRecursively();
+    QTemporaryDir dir;
+    const QString flac = dir.filePath("tone.flac");
+    const qint64 frames = qint64(Rate) * 60 * minutes;
+    if (!dir.isValid() || !ToneFile::writeFlac(flac, Rate, 2, frames, 440.0, 0.5, ToneFile::FlacCoding::Predicted)) {
+        std::printf("waveform: could not write the test file\n");
+        return 1;
+    }
+
+    WaveformCache cache;
+    const double build = timeRequest(cache, flac);
+    const double cached = timeRequest(cache, flac);
+    if (build < 0 || cached < 0) {
+        std::printf("waveform: the overview of %s never became ready\n", qPrintable(flac));
+        return 1;
+    }
+    const double seconds = static_cast<double>(frames) / Rate;
+    Bench::report("waveform", QString("build %1 min").arg(minutes), build, "ms");
+    Bench::report("waveform", "build", seconds / qMax(build / 1000.0, 1e-9), "x realtime");
+    Bench::report("waveform", "cached", cached, "ms");
+    return 0;
+}
+
+Bench registration("waveform", "Seek bar overview build and reload of a 10 minute FLAC", run);
+
+} // namespace
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <QObject>
+#include <QWidget>
+#include <QWindow>
+#include <QScreen>
+#include <QTimer>
+#include <QEvent>
+#include <QPointer>
+#include <QElapsedTimer>
+
+// Single animation clock for a top-level widget. Frames are paced by
+// QWindow::requestUpdate(), which the platform ties to the display refresh
+// (frame callbacks on Wayland). Platforms that answer requestUpdate() after a
+// fixed few milliseconds are held back to the screen refresh rate by a
+// precise single-shot timer, which also stands in before the window is shown.
+//
+// Each frame emits tick() once with the milliseconds since the previous
+// frame, before the window syncs its backing store, so every update() issued
+// from tick() lands in the same repaint.
+class FrameClock : public QObject {
+    Q_OBJECT
+public:
+    explicit FrameClock(QWidget *target)
+    : QObject(target), target(target), active(false), pending(false), lastTick(-1), frames(0) {
+        fallbackTimer.setSingleShot(true);
+        fallbackTimer.setTimerType(Qt::PreciseTimer);
+        connect(&fallbackTimer, &QTimer::timeout, this, &FrameClock::requestFromWindow);
+        clock.start();
+    }
+
+    void start() {
+        if (active) return;
+        active = true;
+        lastTick = -1;
+        scheduleFrame();
+    }
+
+    void stop() {
+        active = false;
+        lastTick = -1;
+    }
+
+    bool isActive() const { return active; }
+
+    // One frame even while stopped, e.g. to show a seek made while paused.
+    void requestFrame() { scheduleFrame(); }
+
+    quint64 frameCount() const { return frames; }
+
+signals:
+    void tick(qint64 elapsedMs);
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override {
+        if (watched == window && event->type() == QEvent::UpdateRequest) {
+            deliverFrame();
+        }
+        return QObject::eventFilter(watched, event);
+    }
+
+private:
+    void scheduleFrame() {
+        if (pending) return;
+        pending = true;
+        QWindow *handle = target->windowHandle();
+        if (handle != window) {
+            if (window) window->removeEventFilter(this);
+            window = handle;
+            if (window) window->installEventFilter(this);
+        }
+        // Leave a quarter frame of slack so display-synced platforms still hit the next refresh
+        const int spacing = frameInterval() * 3 / 4;
+        const qint64 sinceLast = lastTick < 0 ? spacing : clock.elapsed() - lastTick;
+        if (sinceLast < spacing || !window || !target->isVisible()) {
+            fallbackTimer.start(static_cast<int>(qMax<qint64>(0, spacing - sinceLast)));
+        } else {
+            window->requestUpdate();
+        }
+    }
+
+    void requestFromWindow() {
+        if (!pending) return;
+        if (window && target->isVisible()) {
+            window->requestUpdate();
+        } else {
+            deliverFrame();
+        }
+    }
+
+    void deliverFrame() {
+        if (!pending) return;
+        pending = false;
+        fallbackTimer.stop();
+        const qint64 now = clock.elapsed();
+        const qint64 elapsed = (active && lastTick >= 0) ? now - lastTick : 0;
+        lastTick = active ? now : -1;
+        ++frames;
+        emit tick(elapsed);
+        // QWindow clears its pending flag before delivering, so the next frame can be requested right here
+        if (active) scheduleFrame();
+    }
+
+    int frameInterval() const {
+        const qreal rate = target->screen() ? target->screen()->refreshRate() : 60.0;
+        return qMax(1, qRound(1000.0 / (rate > 0 ? rate : 60.0)));
+    }
+
+    QWidget *target;
+    QPointer<QWindow> window;
+    QTimer fallbackTimer;
+    QElapsedTimer clock;
+    bool active;
+    bool pending;
+    qint64 lastTick;
+    quint64 frames;
+};
@@ -0,0 +1,245 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#ifdef Q_OS_UNIX
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+// Recursive media file scanner for one or more library roots.
+//
+// Each walker thread owns a deque of directories: it pushes subdirectories to
+// the back and pops from the back, so it stays depth-first and cache friendly,
+// while idle walkers steal from the front of someone else's deque, which hands
+// them the biggest untouched subtrees. The scan is over when no directory is
+// queued or being read.
+//
+// Matching files are collected per walker and handed to the GUI thread in
+// batches through filesFound(), so the caller can append them to the playlist
+// store in one write per batch.
+class LibraryScanner : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int BatchSize = 4096;
+
+    explicit LibraryScanner(QObject *parent = nullptr)
+    : QObject(parent) {
+        // Directory reads block on the disk, so run a few more walkers than cores
+        pool.setMaxThreadCount(qBound(2, QThread::idealThreadCount() * 2, 32));
+    }
+
+    ~LibraryScanner() {
+        cancel();
+        pool.waitForDone();
+    }
+
+    bool isScanning() const { return scan != nullptr; }
+
+    void cancel() {
+        if (scan) scan->cancelled = true;
+    }
+
+    // Starts a scan of the given roots; returns false if one is already running.
+    bool start(const QStringList &roots) {
+        if (scan) return false;
+        const int walkers = pool.maxThreadCount();
+        scan = std::make_shared<Scan>(walkers);
+        int next = 0;
+        for (const QString &root : roots) {
+            if (!QFileInfo(root).isDir()) continue;
+            scan->queues[next++ % walkers].directories.push_back(QFile::encodeName(QDir::cleanPath(root)));
+            ++scan->pending;
+        }
+        scan->timer.start();
+        scan->running = walkers;
+        for (int i = 0; i < walkers; ++i) {
+            pool.start([this, current = scan, i]() { walk(*current, i); });
+        }
+        return true;
+    }
+
+    static bool isMediaFile(const char *name, qsizetype length) {
+        static constexpr const char *Extensions[] = {"mp3", "mp4", "wav", "ogg", "flac"};
+        qsizetype dot = length - 1;
+        while (dot >= 0 && name[dot] != '.') --dot;
+        if (dot < 0) return false;
+        const char *suffix = name + dot + 1;
+        const qsizetype suffixLength = length - dot - 1;
+        for (const char *extension : Extensions) {
+            if (static_cast<qsizetype>(qstrlen(extension)) == suffixLength && qstrnicmp(suffix, extension, suffixLength) == 0) return true;
+        }
+        return false;
+    }
+
+signals:
+    void filesFound(const QStringList &paths);
+    void progress(qint64 files, qint64 directories, double filesPerSecond);
+    void finished(qint64 files, qint64 directories, qint64 elapsedMs);
+
+private:
+    struct WorkQueue {
+        QMutex mutex;
+        std::deque<QByteArray> directories;
+    };
+
+    struct Scan {
+        explicit Scan(int walkers) : queues(walkers) {}
+        std::vector<WorkQueue> queues;
+        std::atomic<qint64> pending{0};  // queued plus being read
+        std::atomic<qint64> files{0};
+        std::atomic<qint64> directories{0};
+        std::atomic<int> running{0};
+        std::atomic<bool> cancelled{false};
+        QMutex outputMutex;
+        QStringList output;
+        bool drainQueued = false;
+        QElapsedTimer timer;
+    };
+
+    bool take(Scan &current, int self, QByteArray &directory) {
+        {
+            WorkQueue &own = current.queues[self];
+            QMutexLocker locker(&own.mutex);
+            if (!own.directories.empty()) {
+                directory = std::move(own.directories.back());
+                own.directories.pop_back();
+                return true;
+            }
+        }
+        const int count = static_cast<int>(current.queues.size());
+        for (int offset = 1; offset < count; ++offset) {
+            WorkQueue &victim = current.queues[(self + offset) % count];
+            QMutexLocker locker(&victim.mutex);
+            if (!victim.directories.empty()) {
+                directory = std::move(victim.directories.front());
+                victim.directories.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void walk(Scan &current, int self) {
+        QStringList batch;
+        QByteArray directory;
+        while (!current.cancelled) {
+            if (!take(current, self, directory)) {
+                if (current.pending == 0) break;
+                // Others are still reading and may queue more; back off briefly
+                QThread::usleep(200);
+                continue;
+            }
+            readDirectory(current, self, directory, batch);
+            current.directories.fetch_add(1, std::memory_order_relaxed);
+            if (batch.size() >= BatchSize) flush(current, batch);
+            // Subdirectories were queued before this drops, so pending never hits 0 early
+            --current.pending;
+        }
+        flush(current, batch);
+        if (--current.running == 0) {
+            QMetaObject::invokeMethod(this, [this]() { finishScan(); }, Qt::QueuedConnection);
+        }
+    }
+
+    void readDirectory(Scan &current, int self, const QByteArray &directory, QStringList &batch) {
+        QList<QByteArray> subdirectories;
+#ifdef Q_OS_UNIX
+        DIR *dir = ::opendir(directory.constData());
+        if (!dir) return;
+        while (dirent *entry = ::readdir(dir)) {
+            const char *name = entry->d_name;
+            // Hidden entries, including . and .., are never part of a library
+            if (name[0] == '.') continue;
+            const qsizetype length = static_cast<qsizetype>(qstrlen(name));
+            unsigned char type = entry->d_type;
+            // Most entries are skipped on d_type and the name alone, without building a path
+            if (type == DT_REG && !isMediaFile(name, length)) continue;
+            QByteArray path;
+            path.reserve(directory.size() + 1 + length);
+            path.append(directory).append('/').append(name, length);
+            if (type == DT_UNKNOWN) {
+                struct stat info;
+                if (::lstat(path.constData(), &info) != 0) continue;
+                type = S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_LNK;
+            }
+            // Symlinks are not followed, which also keeps link cycles out of the walk
+            if (type == DT_DIR) {
+                subdirectories.append(std::move(path));
+            } else if (type == DT_REG && isMediaFile(name, length)) {
+                batch.append(QFile::decodeName(path));
+            }
+        }
+        ::closedir(dir);
+#else
+        QDirIterator it(QFile::decodeName(directory), QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot | QDir::NoSymLinks);
+        while (it.hasNext()) {
+            const QFileInfo info = it.nextFileInfo();
+            if (info.isDir()) {
+                subdirectories.append(QFile::encodeName(info.filePath()));
+            } else {
+                const QByteArray name = info.fileName().toUtf8();
+                if (isMediaFile(name.constData(), name.size())) batch.append(info.filePath());
+            }
+        }
+#endif
+        if (subdirectories.isEmpty()) return;
+        current.pending += subdirectories.size();
+        WorkQueue &own = current.queues[self];
+        QMutexLocker locker(&own.mutex);
+        for (QByteArray &subdirectory : subdirectories) own.directories.push_back(std::move(subdirectory));
+    }
+
+    void flush(Scan &current, QStringList &batch) {
+        if (batch.isEmpty()) return;
+        current.files.fetch_add(batch.size(), std::memory_order_relaxed);
+        QMutexLocker locker(&current.outputMutex);
+        current.output += batch;
+        batch.clear();
+        if (current.drainQueued) return;
+        current.drainQueued = true;
+        QMetaObject::invokeMethod(this, [this]() { drain(); }, Qt::QueuedConnection);
+    }
+
+    // GUI thread: hands over everything collected since the last drain.
+    void drain() {
+        if (!scan) return;
+        QStringList paths;
+        {
+            QMutexLocker locker(&scan->outputMutex);
+            paths.swap(scan->output);
+            scan->drainQueued = false;
+        }
+        if (!paths.isEmpty()) emit filesFound(paths);
+        const qint64 elapsed = qMax<qint64>(1, scan->timer.elapsed());
+        emit progress(scan->files, scan->directories, scan->files * 1000.0 / elapsed);
+    }
+
+    void finishScan() {
+        drain();
+        const qint64 files = scan->files;
+        const qint64 directories = scan->directories;
+        const qint64 elapsed = scan->timer.elapsed();
+        scan.reset();
+        emit finished(files, directories, elapsed);
+    }
+
+    std::shared_ptr<Scan> scan;
+    QThreadPool pool;
+};
@@ -0,0 +1,255 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSocketNotifier>
+#include "libraryscanner.h"
+
+#ifdef Q_OS_LINUX
+#include <sys/inotify.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+// Keeps the library current after a scan by watching the roots with inotify.
+//
+// Every directory under the roots gets a watch; the tree is walked on a
+// background thread so adding tens of thousands of watches never stalls the
+// GUI. File events are folded into pending added/removed sets and committed
+// through changed() once the burst goes quiet for DebounceMs, or after
+// MaxDelayMs of continuous activity, so copying a whole album folder costs one
+// store write. A directory that is created or moved in is walked for files
+// that appeared before its watch did. If the kernel queue overflows, events
+// were lost and overflowed() asks for a rescan.
+//
+// QFileSystemWatcher needs one watch per directory too but cannot tell which
+// entry changed, so it would only ever be able to trigger rescans; on
+// platforms without inotify the watcher is simply inactive.
+class LibraryWatcher : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int DebounceMs = 500;
+    static constexpr int MaxDelayMs = 5000;
+
+    explicit LibraryWatcher(QObject *parent = nullptr)
+    : QObject(parent) {
+        pool.setMaxThreadCount(1);
+        commitTimer.setSingleShot(true);
+        commitTimer.setInterval(DebounceMs);
+        connect(&commitTimer, &QTimer::timeout, this, &LibraryWatcher::commit);
+    }
+
+    ~LibraryWatcher() {
+        stop();
+        pool.waitForDone();
+    }
+
+    static bool isSupported() {
+#ifdef Q_OS_LINUX
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool isActive() const { return fd >= 0; }
+
+    // Replaces any current watches with the trees under roots.
+    void watch(const QStringList &roots) {
+        stop();
+#ifdef Q_OS_LINUX
+        fd = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0) {
+            qWarning("inotify unavailable, library changes need a rescan");
+            return;
+        }
+        notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+        connect(notifier, &QSocketNotifier::activated, this, &LibraryWatcher::readEvents);
+        for (const QString &root : roots) {
+            if (QFileInfo(root).isDir()) addTree(QFile::encodeName(QDir::cleanPath(root)), false);
+        }
+#else
+        Q_UNUSED(roots);
+#endif
+    }
+
+    void stop() {
+        commitTimer.stop();
+        delete notifier;
+        notifier = nullptr;
+        QMutexLocker locker(&watchMutex);
+        watches.clear();
+#ifdef Q_OS_LINUX
+        if (fd >= 0) ::close(fd);
+#endif
+        fd = -1;
+        ++generation;
+    }
+
+signals:
+    // Media files that appeared, media files that went away, and directories that went away.
+    void changed(const QStringList &added, const QStringList &removed, const QStringList &removedDirectories);
+    void overflowed();
+
+private:
+#ifdef Q_OS_LINUX
+    static constexpr quint32 WatchMask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+                                         | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+    // Walks a tree on the pool, watching every directory. For trees that appear while
+    // watching, media files already inside are reported as added.
+    void addTree(const QByteArray &root, bool reportFiles) {
+        const int descriptor = fd;
+        const quint64 pass = generation;
+        pool.start([this, root, reportFiles, descriptor, pass]() {
+            QStringList found;
+            QList<QByteArray> stack{root};
+            while (!stack.isEmpty()) {
+                const QByteArray directory = stack.takeLast();
+                {
+                    // Checked under the lock stop() closes the descriptor with, so it is never reused here
+                    QMutexLocker locker(&watchMutex);
+                    if (pass != generation) return;
+                    const int wd = ::inotify_add_watch(descriptor, directory.constData(), WatchMask);
+                    if (wd < 0) continue;
+                    watches.insert(wd, directory);
+                }
+                DIR *dir = ::opendir(directory.constData());
+                if (!dir) continue;
+                while (dirent *entry = ::readdir(dir)) {
+                    const char *name = entry->d_name;
+                    if (name[0] == '.') continue;
+                    const qsizetype length = static_cast<qsizetype>(qstrlen(name));
+                    if (entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN) {
+                        // Unknown types are tried as directories; add_watch with IN_ONLYDIR rejects files
+                        stack.append(directory + '/' + QByteArray(name, length));
+                        if (entry->d_type == DT_DIR) continue;
+                    }
+                    if (reportFiles && entry->d_type != DT_DIR && LibraryScanner::isMediaFile(name, length)) {
+                        found.append(QFile::decodeName(directory + '/' + QByteArray(name, length)));
+                    }
+                }
+                ::closedir(dir);
+            }
+            if (found.isEmpty()) return;
+            QMetaObject::invokeMethod(this, [this, found, pass]() {
+                if (pass != generation) return;
+                for (const QString &path : found) {
+                    removed.remove(path);
+                    added.insert(path);
+                }
+                scheduleCommit();
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    void readEvents() {
+        alignas(inotify_event) char buffer[64 * 1024];
+        bool overflow = false;
+        for (;;) {
+            const ssize_t length = ::read(fd, buffer, sizeof(buffer));
+            if (length <= 0) break;
+            for (const char *at = buffer; at < buffer + length;) {
+                const auto *event = reinterpret_cast<const inotify_event *>(at);
+                at += sizeof(inotify_event) + event->len;
+                if (event->mask & IN_Q_OVERFLOW) {
+                    overflow = true;
+                    continue;
+                }
+                QByteArray directory;
+                {
+                    QMutexLocker locker(&watchMutex);
+                    if (event->mask & IN_IGNORED) {
+                        watches.remove(event->wd);
+                        continue;
+                    }
+                    directory = watches.value(event->wd);
+                }
+                if (directory.isEmpty() || event->len == 0) continue;
+                const qsizetype nameLength = static_cast<qsizetype>(qstrlen(event->name));
+                const QByteArray path = directory + '/' + QByteArray(event->name, nameLength);
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        addTree(path, true);
+                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        forgetTree(path);
+                        removedDirectories.insert(QFile::decodeName(path));
+                    }
+                } else if (LibraryScanner::isMediaFile(event->name, nameLength)) {
+                    const QString file = QFile::decodeName(path);
+                    if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                        removed.remove(file);
+                        added.insert(file);
+                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        added.remove(file);
+                        removed.insert(file);
+                    }
+                }
+            }
+        }
+        if (overflow) {
+            emit overflowed();
+        }
+        scheduleCommit();
+    }
+
+    // Drops the watches under a directory that moved away; deleted trees are
+    // cleaned up by IN_IGNORED, but moved ones would keep their stale paths.
+    void forgetTree(const QByteArray &directory) {
+        const QByteArray prefix = directory + '/';
+        QMutexLocker locker(&watchMutex);
+        for (auto it = watches.begin(); it != watches.end();) {
+            if (it.value() == directory || it.value().startsWith(prefix)) {
+                ::inotify_rm_watch(fd, it.key());
+                it = watches.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+#endif
+
+    void scheduleCommit() {
+        if (added.isEmpty() && removed.isEmpty() && removedDirectories.isEmpty()) return;
+        if (!burst.isValid()) burst.start();
+        // Restart the quiet period, unless the burst has already been held back long enough
+        if (burst.elapsed() < MaxDelayMs || !commitTimer.isActive()) commitTimer.start();
+    }
+
+    void commit() {
+        burst.invalidate();
+        const QStringList addedFiles(added.cbegin(), added.cend());
+        const QStringList removedFiles(removed.cbegin(), removed.cend());
+        const QStringList removedTrees(removedDirectories.cbegin(), removedDirectories.cend());
+        added.clear();
+        removed.clear();
+        removedDirectories.clear();
+        emit changed(addedFiles, removedFiles, removedTrees);
+    }
+
+    int fd = -1;
+    QSocketNotifier *notifier = nullptr;
+    QMutex watchMutex;
+    QHash<int, QByteArray> watches;  // guarded by watchMutex
+    quint64 generation = 0;          // written under watchMutex
+    QSet<QString> added;
+    QSet<QString> removed;
+    QSet<QString> removedDirectories;
+    QTimer commitTimer;
+    QElapsedTimer burst;
+    QThreadPool pool;
+};
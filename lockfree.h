@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+// Wait-free ring buffer for exactly one producer thread and one consumer thread.
+// Indices grow monotonically and are masked on access, so capacity is rounded
+// up to a power of two.
+template <typename T>
+class SpscRingBuffer {
+    static_assert(std::is_trivially_copyable_v<T>, "SpscRingBuffer holds raw samples");
+
+public:
+    explicit SpscRingBuffer(size_t minCapacity = 0) { reset(minCapacity); }
+
+    // Not thread-safe: only call while neither side is running.
+    void reset(size_t minCapacity) {
+        size_t capacity = 1;
+        while (capacity < minCapacity) capacity <<= 1;
+        buffer.reset(minCapacity ? new T[capacity] : nullptr);
+        mask = minCapacity ? capacity - 1 : 0;
+        writeIndex.store(0, std::memory_order_relaxed);
+        readIndex.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return buffer ? mask + 1 : 0; }
+
+    // Producer side
+    size_t writeAvailable() const {
+        return capacity() - (writeIndex.load(std::memory_order_relaxed) - readIndex.load(std::memory_order_acquire));
+    }
+
+    size_t write(const T *data, size_t count) {
+        const size_t head = writeIndex.load(std::memory_order_relaxed);
+        const size_t free = capacity() - (head - readIndex.load(std::memory_order_acquire));
+        if (count > free) count = free;
+        copyIn(head, data, count);
+        writeIndex.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side
+    size_t readAvailable() const {
+        return writeIndex.load(std::memory_order_acquire) - readIndex.load(std::memory_order_relaxed);
+    }
+
+    size_t read(T *out, size_t count) {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        const size_t available = writeIndex.load(std::memory_order_acquire) - tail;
+        if (count > available) count = available;
+        copyOut(tail, out, count);
+        readIndex.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t skip(size_t count) {
+        const size_t tail = readIndex.load(std::memory_order_relaxed);
+        const size_t available = writeIndex.load(std::memory_order_acquire) - tail;
+        if (count > available) count = available;
+        readIndex.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+private:
+    void copyIn(size_t index, const T *data, size_t count) {
+        const size_t offset = index & mask;
+        const size_t first = count < capacity() - offset ? count : capacity() - offset;
+        std::memcpy(buffer.get() + offset, data, first * sizeof(T));
+        std::memcpy(buffer.get(), data + first, (count - first) * sizeof(T));
+    }
+
+    void copyOut(size_t index, T *out, size_t count) const {
+        const size_t offset = index & mask;
+        const size_t first = count < capacity() - offset ? count : capacity() - offset;
+        std::memcpy(out, buffer.get() + offset, first * sizeof(T));
+        std::memcpy(out + first, buffer.get(), (count - first) * sizeof(T));
+    }
+
+    std::unique_ptr<T[]> buffer;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    alignas(64) std::atomic<size_t> readIndex{0};
+};
+
+// Lock-free "latest value" handoff: the writer fills writeBuffer() and
+// publishes it, the reader picks up whatever was published last. Neither side
+// ever waits for the other; intermediate values may be skipped.
+template <typename T>
+class TripleBuffer {
+public:
+    T &writeBuffer() { return buffers[writeSlot]; }
+
+    void publish() {
+        const int previous = shared.exchange(writeSlot | DirtyBit, std::memory_order_acq_rel);
+        writeSlot = previous & SlotMask;
+    }
+
+    // Returns true when a new value was published since the last fetch.
+    bool fetch() {
+        if (!(shared.load(std::memory_order_relaxed) & DirtyBit)) return false;
+        const int previous = shared.exchange(readSlot, std::memory_order_acq_rel);
+        readSlot = previous & SlotMask;
+        return true;
+    }
+
+    const T &readBuffer() const { return buffers[readSlot]; }
+
+private:
+    static constexpr int SlotMask = 0x3;
+    static constexpr int DirtyBit = 0x4;
+
+    T buffers[3] = {};
+    alignas(64) std::atomic<int> shared{1};
+    int writeSlot = 0;
+    int readSlot = 2;
+};
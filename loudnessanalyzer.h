@@ -0,0 +1,273 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QEventLoop>
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+#include "loudnessmeter.h"
+#include "sourcestamp.h"
+
+// Measures every library track's integrated loudness and true peak in the
+// background and turns them into ReplayGain-style playback gains.
+//
+// Each track is decoded and metered on its own pool worker, one per core at
+// low priority, so a library is analyzed in parallel without competing with
+// playback; the bench's loudness section reports the rate as a multiple of
+// real time. Results are cached in the app's cache directory keyed by path
+// and stamped with the file's size and mtime; a file whose stamp still
+// matches is never decoded again, across restarts too. The cache is saved
+// when the new results would double the file, after SaveIntervalMs, or when
+// the queue drains, so the bytes written stay linear in the library size.
+class LoudnessAnalyzer : public QObject {
+    Q_OBJECT
+public:
+    // ReplayGain 2.0 reference level; louder masters are turned down towards it
+    static constexpr double ReferenceLufs = -18.0;
+    // Gains never push the true peak above this
+    static constexpr double PeakCeilingDb = -1.0;
+    static constexpr double MaxBoostDb = 12.0;
+
+    explicit LoudnessAnalyzer(QObject *parent = nullptr)
+    : QObject(parent) {
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+        pool.setThreadPriority(QThread::LowPriority);
+        cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/loudness.bin";
+        sinceSave.start();
+        pool.start([this]() { ensureLoaded(); });
+    }
+
+    ~LoudnessAnalyzer() {
+        stopping = true;
+        pool.clear();
+        pool.waitForDone();
+        save();
+    }
+
+    // Queues the files that have no valid cached result. Stamps are checked on the pool,
+    // so this never touches the filesystem on the caller's thread.
+    void analyze(const QStringList &paths) {
+        if (paths.isEmpty()) return;
+        pool.start([this, paths]() {
+            ensureLoaded();
+            for (const QString &path : paths) {
+                if (stopping) return;
+                if (path.isEmpty()) continue;
+                SourceStamp stamp;
+                if (!SourceStamp::read(path, stamp)) continue;
+                {
+                    QMutexLocker locker(&mutex);
+                    auto cached = results.constFind(path);
+                    if (cached != results.cend() && cached->size == stamp.size && cached->mtimeNs == stamp.mtimeNs) continue;
+                    if (queued.contains(path)) continue;
+                    queued.insert(path);
+                    ++outstanding;
+                }
+                pool.start([this, path, stamp]() { measure(path, stamp); });
+            }
+        });
+    }
+
+    // Linear playback gain for path: unity until the track has been analyzed.
+    float gain(const QString &path) const {
+        QMutexLocker locker(&mutex);
+        auto cached = results.constFind(path);
+        if (cached == results.cend() || cached->lufs <= LoudnessMeter::AbsoluteGateLufs) return 1.0f;
+        const double db = qMin(qMin(ReferenceLufs - cached->lufs, MaxBoostDb), PeakCeilingDb - cached->truePeakDb);
+        return static_cast<float>(std::pow(10.0, db / 20.0));
+    }
+
+signals:
+    // Emitted on the GUI thread as each track's result is stored
+    void analyzed(const QString &path, double lufs, double truePeakDb);
+
+private:
+    static constexpr quint32 CacheVersion = 1;
+    static constexpr int MinSaveBatch = 64;
+    static constexpr qint64 SaveIntervalMs = 30000;
+
+    struct Result {
+        qint64 size = 0;
+        qint64 mtimeNs = 0;
+        float lufs = 0;
+        float truePeakDb = 0;
+    };
+
+    // Pool worker: decodes path in whatever format the backend produces and meters it.
+    void measure(const QString &path, const SourceStamp &stamp) {
+        std::unique_ptr<LoudnessMeter> meter;
+        std::vector<float> samples;
+        bool done = false;
+        bool ok = true;
+        QEventLoop loop;
+        QAudioDecoder decoder;
+        connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&]() {
+            while (decoder.bufferAvailable()) {
+                const QAudioBuffer buffer = decoder.read();
+                const QAudioFormat format = buffer.format();
+                if (!meter) meter = std::make_unique<LoudnessMeter>(format.sampleRate(), format.channelCount());
+                if (toFloat(buffer, samples)) meter->addFrames(samples.data(), static_cast<size_t>(buffer.frameCount()));
+            }
+            if (stopping) {
+                ok = false;
+                done = true;
+                loop.quit();
+            }
+        });
+        connect(&decoder, &QAudioDecoder::finished, &loop, [&]() {
+            done = true;
+            loop.quit();
+        });
+        connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), &loop, [&]() {
+            ok = false;
+            done = true;
+            loop.quit();
+        });
+        decoder.setSource(QUrl::fromLocalFile(path));
+        decoder.start();
+        if (!done) loop.exec();
+        decoder.stop();
+
+        ok = ok && meter;
+        const double lufs = ok ? meter->integratedLoudness() : 0.0;
+        const double peak = ok ? meter->truePeakDb() : 0.0;
+        bool saveNow = false;
+        {
+            QMutexLocker locker(&mutex);
+            queued.remove(path);
+            --outstanding;
+            if (ok) {
+                results.insert(path, {stamp.size, stamp.mtimeNs, static_cast<float>(lufs), static_cast<float>(peak)});
+                dirty = true;
+                ++unsaved;
+            }
+            saveNow = dirty && (unsaved >= qMax<qsizetype>(MinSaveBatch, savedSize) || outstanding == 0
+                                || sinceSave.hasExpired(SaveIntervalMs));
+        }
+        if (saveNow) save();
+        if (ok) {
+            QMetaObject::invokeMethod(this, [this, path, lufs, peak]() { emit analyzed(path, lufs, peak); },
+                                      Qt::QueuedConnection);
+        }
+    }
+
+    // Interleaved float in samples; false for sample formats the decoder should never produce.
+    static bool toFloat(const QAudioBuffer &buffer, std::vector<float> &samples) {
+        const size_t count = static_cast<size_t>(buffer.frameCount()) * buffer.format().channelCount();
+        if (samples.size() < count) samples.resize(count);
+        switch (buffer.format().sampleFormat()) {
+        case QAudioFormat::Float:
+            std::copy_n(buffer.constData<float>(), count, samples.data());
+            return true;
+        case QAudioFormat::Int16:
+            convert(buffer.constData<qint16>(), count, 1.0f / 32768.0f, 0.0f, samples);
+            return true;
+        case QAudioFormat::Int32:
+            convert(buffer.constData<qint32>(), count, 1.0f / 2147483648.0f, 0.0f, samples);
+            return true;
+        case QAudioFormat::UInt8:
+            convert(buffer.constData<quint8>(), count, 1.0f / 128.0f, -1.0f, samples);
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    template <typename Sample>
+    static void convert(const Sample *data, size_t count, float scale, float offset, std::vector<float> &samples) {
+        for (size_t i = 0; i < count; ++i) samples[i] = static_cast<float>(data[i]) * scale + offset;
+    }
+
+    // The cache must be in before any stamp is checked, or cached files would be queued again
+    void ensureLoaded() {
+        QMutexLocker locker(&loadMutex);
+        if (loaded) return;
+        load();
+        loaded = true;
+    }
+
+    void load() {
+        QFile file(cacheFile);
+        if (!file.open(QIODevice::ReadOnly)) return;
+        QDataStream in(&file);
+        quint32 version = 0;
+        in >> version;
+        if (version != CacheVersion) return;
+        qint64 count = 0;
+        in >> count;
+        QMutexLocker locker(&mutex);
+        for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Result result;
+            in >> path >> result.size >> result.mtimeNs >> result.lufs >> result.truePeakDb;
+            if (!results.contains(path)) results.insert(path, result);
+        }
+        savedSize = results.size();
+    }
+
+    // Writes a snapshot taken under the lock, so workers keep inserting while the file is written.
+    // saveMutex keeps writers in snapshot order: the newest snapshot is always written last.
+    void save() {
+        QMutexLocker saveLocker(&saveMutex);
+        QHash<QString, Result> snapshot;
+        {
+            QMutexLocker locker(&mutex);
+            if (!dirty) return;
+            snapshot = results;
+            dirty = false;
+            unsaved = 0;
+            savedSize = snapshot.size();
+            sinceSave.restart();
+        }
+        QDir().mkpath(QFileInfo(cacheFile).path());
+        QSaveFile file(cacheFile);
+        bool written = file.open(QIODevice::WriteOnly);
+        if (written) {
+            QDataStream out(&file);
+            out << CacheVersion << qint64(snapshot.size());
+            for (auto it = snapshot.cbegin(); it != snapshot.cend(); ++it) {
+                out << it.key() << it->size << it->mtimeNs << it->lufs << it->truePeakDb;
+            }
+            written = file.commit();
+        }
+        if (!written) {
+            QMutexLocker locker(&mutex);
+            dirty = true;
+        }
+    }
+
+    mutable QMutex mutex;
+    QHash<QString, Result> results;  // guarded by mutex, as are the members up to sinceSave
+    QSet<QString> queued;
+    qint64 outstanding = 0;
+    bool dirty = false;
+    qsizetype unsaved = 0;
+    qsizetype savedSize = 0;
+    QElapsedTimer sinceSave;
+    QString cacheFile;
+    QMutex loadMutex;
+    bool loaded = false;  // guarded by loadMutex
+    QMutex saveMutex;
+    std::atomic<bool> stopping{false};
+    QThreadPool pool;
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+// ITU-R BS.1770 / EBU R128 loudness of one whole track, fed interleaved float
+// frames in order.
+//
+// Each channel runs through the two K-weighting biquads (high shelf, then high
+// pass) and its squares are summed per 100 ms step. Overlapping 400 ms gating
+// blocks are the sum of four consecutive steps, so every sample is weighted
+// once. The integrated loudness gates blocks at -70 LUFS absolute and then 10 LU
+// below their mean. True peak is the largest magnitude of the signal upsampled
+// 4x with a 48-tap polyphase interpolator.
+class LoudnessMeter {
+public:
+    static constexpr double AbsoluteGateLufs = -70.0;
+    static constexpr double RelativeGateLu = -10.0;
+    static constexpr int Oversampling = 4;
+    static constexpr int PhaseTaps = 12;
+
+    LoudnessMeter(int sampleRate, int channels)
+    : channels(std::max(1, channels)), stepFrames(std::max(1, sampleRate / 10)), filters(this->channels),
+      history(static_cast<size_t>(this->channels) * PhaseTaps * 2, 0.0f), lastLoud(this->channels, 0) {
+        // Filter design from the BS.1770 reference, re-derived for any sample rate
+        const double rate = std::max(1, sampleRate);
+        double k = std::tan(M_PI * 1681.974450955533 / rate);
+        const double q = 0.7071752369554196;
+        const double vh = std::pow(10.0, 3.999843853973347 / 20.0);
+        const double vb = std::pow(vh, 0.4996667741545416);
+        double a0 = 1.0 + k / q + k * k;
+        shelf = {(vh + vb * k / q + k * k) / a0, 2.0 * (k * k - vh) / a0, (vh - vb * k / q + k * k) / a0,
+                 2.0 * (k * k - 1.0) / a0, (1.0 - k / q + k * k) / a0};
+        k = std::tan(M_PI * 38.13547087602444 / rate);
+        const double hq = 0.5003270373238773;
+        a0 = 1.0 + k / hq + k * k;
+        highPass = {1.0, -2.0, 1.0, 2.0 * (k * k - 1.0) / a0, (1.0 - k / hq + k * k) / a0};
+
+        // 5.1 in the usual L R C LFE Ls Rs order: no LFE, surrounds +1.5 dB
+        weights.assign(this->channels, 1.0);
+        if (this->channels == 6) weights = {1.0, 1.0, 1.0, 0.0, 1.41, 1.41};
+
+        // Windowed sinc at the original Nyquist, split into one phase per output sample
+        constexpr int Taps = Oversampling * PhaseTaps;
+        for (int n = 0; n < Taps; ++n) {
+            const double x = (n - (Taps - 1) / 2.0) / Oversampling;
+            const double sinc = x == 0.0 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+            const double window = 0.5 - 0.5 * std::cos(2.0 * M_PI * (n + 0.5) / Taps);
+            phases[n % Oversampling][n / Oversampling] = static_cast<float>(sinc * window);
+        }
+        for (const auto &phase : phases) {
+            float gain = 0.0f;
+            for (float tap : phase) gain += std::fabs(tap);
+            phaseGain = std::max(phaseGain, gain);
+        }
+    }
+
+    void addFrames(const float *interleaved, size_t frames) {
+        for (size_t i = 0; i < frames; ++i) {
+            const float *frame = interleaved + i * channels;
+            double energy = 0.0;
+            for (int c = 0; c < channels; ++c) {
+                const double weighted = filters[c].run(frame[c], shelf, highPass);
+                energy += weights[c] * weighted * weighted;
+                truePeakSample(c, frame[c]);
+            }
+            historyPosition = (historyPosition + 1) % PhaseTaps;
+            ++frameCount;
+            stepEnergy += energy;
+            if (++stepCount == stepFrames) finishStep();
+        }
+    }
+
+    // LUFS; AbsoluteGateLufs when nothing was loud enough to count (silence or too short)
+    double integratedLoudness() const {
+        double sum = 0.0;
+        size_t count = 0;
+        for (double block : blocks) {
+            if (block > absoluteGate) {
+                sum += block;
+                ++count;
+            }
+        }
+        if (count == 0) return AbsoluteGateLufs;
+        const double relativeGate = sum / count * std::pow(10.0, RelativeGateLu / 10.0);
+        sum = 0.0;
+        count = 0;
+        for (double block : blocks) {
+            if (block > absoluteGate && block > relativeGate) {
+                sum += block;
+                ++count;
+            }
+        }
+        return count ? toLufs(sum / count) : AbsoluteGateLufs;
+    }
+
+    // dBTP (dB relative to full scale, measured between samples too)
+    double truePeakDb() const { return peak > 0.0f ? 20.0 * std::log10(peak) : -200.0; }
+
+private:
+    struct Biquad {
+        double x1 = 0, x2 = 0, y1 = 0, y2 = 0;
+        double step(double x, const std::array<double, 5> &c) {
+            const double y = c[0] * x + c[1] * x1 + c[2] * x2 - c[3] * y1 - c[4] * y2;
+            x2 = x1;
+            x1 = x;
+            y2 = y1;
+            y1 = y;
+            return y;
+        }
+    };
+
+    struct ChannelFilter {
+        Biquad first;
+        Biquad second;
+        double run(double x, const std::array<double, 5> &shelf, const std::array<double, 5> &highPass) {
+            return second.step(first.step(x, shelf), highPass);
+        }
+    };
+
+    static double toLufs(double meanSquare) { return -0.691 + 10.0 * std::log10(meanSquare); }
+
+    void finishStep() {
+        steps[stepIndex++ % 4] = stepEnergy / stepFrames;
+        stepEnergy = 0.0;
+        stepCount = 0;
+        if (stepIndex >= 4) blocks.push_back((steps[0] + steps[1] + steps[2] + steps[3]) / 4.0);
+    }
+
+    // history holds the last PhaseTaps input samples per channel twice over, so the newest
+    // PhaseTaps always sit contiguously before historyPosition + PhaseTaps. None of the four
+    // phases lands on an input sample, so the sample itself counts too.
+    void truePeakSample(int channel, float sample) {
+        float *line = history.data() + static_cast<size_t>(channel) * PhaseTaps * 2;
+        line[historyPosition] = line[historyPosition + PhaseTaps] = sample;
+        const float magnitude = std::fabs(sample);
+        peak = std::max(peak, magnitude);
+        // Interpolating cannot exceed the phase gain times the largest input in reach. For
+        // most of a track no input in reach comes near the peak so far, and nothing is computed.
+        if (magnitude * phaseGain > peak) lastLoud[channel] = frameCount;
+        if (frameCount - lastLoud[channel] >= PhaseTaps) return;
+        const float *newest = line + historyPosition + PhaseTaps;
+        for (const auto &phase : phases) {
+            float sum = 0.0f;
+            for (int t = 0; t < PhaseTaps; ++t) sum += phase[t] * newest[-t];
+            peak = std::max(peak, std::fabs(sum));
+        }
+    }
+
+    int channels;
+    int stepFrames;
+    std::array<double, 5> shelf{};
+    std::array<double, 5> highPass{};
+    std::vector<double> weights;
+    std::vector<ChannelFilter> filters;
+    double steps[4] = {};
+    size_t stepIndex = 0;
+    double stepEnergy = 0.0;
+    int stepCount = 0;
+    std::vector<double> blocks;
+    const double absoluteGate = std::pow(10.0, (AbsoluteGateLufs + 0.691) / 10.0);
+    float phases[Oversampling][PhaseTaps]{};
+    std::vector<float> history;
+    int historyPosition = 0;
+    std::vector<unsigned long long> lastLoud;
+    unsigned long long frameCount = 0;
+    float phaseGain = 0.0f;
+    float peak = 0.0f;
+};
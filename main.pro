@@ -1,17 +1,7 @@
 # Project name
 TARGET = ApexMusic
 
-# Required Qt modules
-QT += core gui widgets multimedia
-
-
-RESOURCES += resources.qrc
+include(app.pri)
 
 # Source files
 SOURCES += main.cpp
-
-
-# C++ standard
-CONFIG += c++23
-
-
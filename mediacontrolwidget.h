@@ -0,0 +1,1209 @@
+#pragma once
+
+#include <QIcon>
+#include <QFileDialog>
+#include <QStandardPaths>
+#include <QSettings>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QMessageBox>
+#include <QMouseEvent>
+#include <QDir>
+#include <QLabel>
+#include <QTimer>
+#include <QPainter>
+#include <QPixmap>
+#include <QResizeEvent>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTextStream>
+#include <QCloseEvent>
+#include <QShowEvent>
+#include <QHideEvent>
+#include <QToolTip>
+#include <QFileInfo>
+#include <QRegularExpression>
+#include <QLinearGradient>
+#include <QGuiApplication>
+#include <QScreen>
+#include <cmath>
+#include <QPropertyAnimation>
+#include <QSequentialAnimationGroup>
+#include <QPointer>
+#include "frameclock.h"
+#include "timelabel.h"
+#include "playliststore.h"
+#include "pathvalidator.h"
+#include "playlistdialog.h"
+#include "playlistfile.h"
+#include "shuffleengine.h"
+#include "libraryscanner.h"
+#include "librarywatcher.h"
+#include "loudnessanalyzer.h"
+#include "tagcache.h"
+#include "searchindex.h"
+#include "waveformcache.h"
+#include "artworkcache.h"
+#include "seekscheduler.h"
+#include "mediaplayerengine.h"
+#include "streamplaybackengine.h"
+#include "spectrumanalyzer.h"
+
+// The tray popup: transport buttons, seek bar over the waveform, the spectrum
+// visualizer and the playlist actions, around a swappable playback engine.
+class MediaControlWidget : public QWidget {
+    Q_OBJECT
+public:
+    MediaControlWidget(QWidget *parent = nullptr)
+    : QWidget(parent), mediaLoaded(false), isPlaying(false), currentMediaPath(""),
+    hoverOverProgress(false), draggingProgress(false), wasPlayingBeforeDrag(false),
+    staticLayerLoaded(false), paintCount(0), paintTotalNs(0), paintMaxNs(0), beatPhase(0), lastOnsetCount(0), beatIntensity(0), shownBpm(0), shuffleMode(false), scannedAdded(0), announceScan(false), restorePosition(-1),
+    visualizerLag(0), beatLag(0), shownProgressWidth(-1), shownPositionSecond(-1), shownDurationSecond(-1) {
+        setupUI();
+        setupPlayer();
+        // Initialize audio levels for visualization
+        audioLevels.fill(0.1f);
+        peakLevels.fill(0.1f);
+        beatLevels.fill(0.0f);
+        // Bar colours for every beat shade, so painting never derives colours per bar
+        const QColor baseColors[2] = {QColor(0, 86, 143), QColor(36, 255, 255)}; // #00568f, #24ffff
+        for (int c = 0; c < 2; ++c) {
+            for (int shade = 0; shade < BeatShades; ++shade) {
+                barPalette[c][shade] = baseColors[c].lighter(100 + shade);
+                peakPalette[c][shade] = barPalette[c][shade].lighter(130);
+            }
+        }
+        // The playlist lives in an indexed store next to the old musiclist.txt, which is imported once
+        if (playlist.open("musiclist")) {
+            if (playlist.size() == 0 && QFile::exists("musiclist.txt")) {
+                playlist.importTextFile("musiclist.txt");
+            }
+        } else {
+            qWarning("%s", qPrintable(playlist.errorString()));
+        }
+        // Existence checks run in the background; entries stay Unverified until they come back
+        pathValidator = new PathValidator(this);
+        pathValidator->validate(playlist);
+        // Names come from the tag cache; tracks not read yet show their file name meanwhile
+        tags = new TagCache(this);
+        // The picker searches paths at once and tags as they are read
+        search = new SearchIndex(tags, this);
+        connect(tags, &TagCache::tagsRead, this, [this](const QStringList &paths) {
+            if (paths.contains(currentMediaPath)) updateFileNameDisplay();
+            QList<qsizetype> entries;
+            QStringList indexed;
+            for (const QString &path : paths) {
+                const qsizetype index = playlist.indexOf(path);
+                if (index < 0) continue;
+                entries.append(index);
+                indexed.append(path);
+            }
+            search->index(entries, indexed);
+        });
+        analyzeTracks(0);
+        // APEXMUSIC_SHUFFLE_WINDOW sets how many tracks must pass before one can repeat
+        bool windowSet = false;
+        int window = qEnvironmentVariableIntValue("APEXMUSIC_SHUFFLE_WINDOW", &windowSet);
+        if (windowSet) shuffle.setNoRepeatWindow(window);
+        shuffle.reset(playlist.size());
+        libraryScanner = new LibraryScanner(this);
+        connect(libraryScanner, &LibraryScanner::filesFound, this, &MediaControlWidget::addScannedFiles);
+        connect(libraryScanner, &LibraryScanner::finished, this, [this](qint64 files, qint64 directories, qint64 elapsedMs) {
+            if (!announceScan) return;
+            QMessageBox::information(this, "Library Scan",
+                                     QString("Scanned %1 files in %2 folders (%3 files/sec), %4 new songs added")
+                                         .arg(files).arg(directories)
+                                         .arg(qRound64(files * 1000.0 / qMax<qint64>(1, elapsedMs)))
+                                         .arg(scannedAdded));
+        });
+        // Once a library has been scanned its roots are watched, so it stays current without rescans
+        libraryWatcher = new LibraryWatcher(this);
+        connect(libraryWatcher, &LibraryWatcher::changed, this, &MediaControlWidget::applyLibraryChanges);
+        connect(libraryWatcher, &LibraryWatcher::overflowed, this, &MediaControlWidget::rescanLibrary);
+        const QStringList roots = QSettings().value("library/roots").toStringList();
+        if (!roots.isEmpty()) libraryWatcher->watch(roots);
+        // One display-paced clock drives the visualizer, beat decay and progress together
+        frameClock = new FrameClock(this);
+        connect(frameClock, &FrameClock::tick, this, &MediaControlWidget::advanceFrame);
+        setMouseTracking(true);
+    }
+    ~MediaControlWidget() { resetPlayer(); }
+
+    struct PaintStats {
+        quint64 frames;
+        qint64 averageNs;
+        qint64 maxNs;
+    };
+
+    // Seeks asked for by progress-bar drags versus seeks actually handed to the engine
+    SeekScheduler::Stats seekStats() const { return seeker->seekStats(); }
+
+    PaintStats paintStats() const {
+        return {paintCount, paintCount ? static_cast<qint64>(paintTotalNs / paintCount) : 0, paintMaxNs};
+    }
+
+    // Tempo of the current track as estimated by the analyzer, 0 while unknown
+    float estimatedBpm() const { return spectrumFrame.bpm; }
+
+    void showControlPanel() {
+        QPoint cursorPos = QCursor::pos();
+        QRect screenGeometry = QGuiApplication::primaryScreen()->availableGeometry();
+        int x = cursorPos.x() - width() / 2;
+        int y = cursorPos.y() - height();
+        x = qMax(screenGeometry.left(), qMin(x, screenGeometry.right() - width()));
+        y = qMax(screenGeometry.top(), qMin(y, screenGeometry.bottom() - height()));
+        move(x, y);
+        show();
+        raise();
+        activateWindow();
+    }
+
+protected:
+    void showEvent(QShowEvent *event) override {
+        QWidget::showEvent(event);
+        updateActivity();
+        // Catch the time and handle up with whatever happened while hidden
+        if (!frameClock->isActive()) frameClock->requestFrame();
+    }
+
+    void hideEvent(QHideEvent *event) override {
+        QWidget::hideEvent(event);
+        updateActivity();
+    }
+
+    void closeEvent(QCloseEvent *event) override {
+        resetPlayer();
+        event->accept();
+    }
+
+    void resizeEvent(QResizeEvent *event) override {
+        QWidget::resizeEvent(event);
+        int progressBarHeight = 2;
+        progressBarRect = QRect(10, height() - progressBarHeight - 10, width() - 20, progressBarHeight);
+        waveformRect = QRect(10, progressBarRect.center().y() - WaveformHeight / 2, width() - 20, WaveformHeight);
+        visualizerRect = QRect(20, 75, width() - 40, 24);
+        staticLayer = QPixmap();
+    }
+
+    void paintEvent(QPaintEvent *event) override {
+        QElapsedTimer paintTimer;
+        paintTimer.start();
+
+        if (staticLayer.isNull() || staticLayerLoaded != mediaLoaded
+            || staticLayer.devicePixelRatio() != devicePixelRatioF()) {
+            renderStaticLayer();
+        }
+
+        QPainter painter(this);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        // Blit only the exposed part of the cached background, visualizer well and progress track
+        const QRect exposed = event->rect();
+        const qreal dpr = staticLayer.devicePixelRatio();
+        painter.drawPixmap(QRectF(exposed), staticLayer,
+                           QRectF(exposed.x() * dpr, exposed.y() * dpr, exposed.width() * dpr, exposed.height() * dpr));
+
+        // Draw audio visualizer in its designated slot
+        if (exposed.intersects(visualizerRect)) {
+            drawVisualizer(painter);
+        }
+
+        int progressBarHeight = progressBarRect.height();
+        if (mediaLoaded && player->duration() > 0 && exposed.intersects(progressArea())) {
+            double progress = static_cast<double>(shownPosition()) / player->duration();
+            progress = qBound(0.0, progress, 1.0);
+            int progressWidth = static_cast<int>(progress * progressBarRect.width());
+            QRect progressRect(progressBarRect.x(), progressBarRect.y(), progressWidth, progressBarRect.height());
+            painter.fillRect(progressRect, QColor(36, 255, 255));
+
+            // Draw draggable circle handle
+            int handleSize = 12;
+            int handleY = progressBarRect.y() - (handleSize - progressBarHeight) / 2;
+            int handleX = progressBarRect.x() + progressWidth - handleSize/2;
+
+            if (draggingProgress || hoverOverProgress) {
+                painter.setPen(Qt::NoPen);
+                painter.setBrush(QColor(36, 255, 255));
+                painter.drawEllipse(handleX, handleY, handleSize, handleSize);
+
+                // Draw time tooltip near the handle
+                char timeText[TimeGlyphs::MaxLength];
+                int timeLength = TimeGlyphs::formatPair(shownPosition(), player->duration(), timeText);
+                QRect tooltipRect(handleX - 30, handleY - 25, 60, 20);
+                painter.setPen(Qt::NoPen);
+                painter.setBrush(QColor(60, 60, 60, 220));
+                painter.drawRoundedRect(tooltipRect, 3, 3);
+                if (!bubbleGlyphs.matches(font(), Qt::white, devicePixelRatioF())) {
+                    bubbleGlyphs.render(font(), Qt::white, devicePixelRatioF());
+                }
+                int textWidth = bubbleGlyphs.width(timeText, timeLength);
+                bubbleGlyphs.draw(painter, QPoint(tooltipRect.center().x() - textWidth / 2 + 1,
+                                                  tooltipRect.center().y() - bubbleGlyphs.height() / 2 + 1),
+                                  timeText, timeLength);
+            }
+        }
+
+        qint64 elapsed = paintTimer.nsecsElapsed();
+        ++paintCount;
+        paintTotalNs += elapsed;
+        paintMaxNs = qMax(paintMaxNs, elapsed);
+    }
+
+    // Everything that never changes between frames, rendered once per size, DPR and loaded state.
+    void renderStaticLayer() {
+        const qreal dpr = devicePixelRatioF();
+        staticLayer = QPixmap(size() * dpr);
+        staticLayer.setDevicePixelRatio(dpr);
+        staticLayer.fill(Qt::transparent);
+        staticLayerLoaded = mediaLoaded;
+
+        QPainter painter(&staticLayer);
+        painter.setRenderHint(QPainter::Antialiasing);
+
+        // The cover, once its thumbnail is decoded, shows through the tinted background
+        if (mediaLoaded) {
+            const QImage cover = artwork->thumbnail(currentMediaPath, staticLayer.size());
+            if (cover.isNull()) {
+                artwork->request(currentMediaPath, staticLayer.size());
+            } else {
+                painter.drawImage(QRectF(rect()), cover);
+            }
+        }
+
+        // Draw semi-transparent background
+        painter.fillRect(rect(), QColor(0, 86, 143, 180)); // #00568f with 70% opacity
+
+        // Draw visualizer background (less transparent)
+        if (mediaLoaded) {
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(QColor(20, 20, 20, 220));
+            painter.drawRoundedRect(visualizerRect, 2, 2);
+        }
+
+        // The track's waveform overview sits behind the progress bar once it is available
+        if (mediaLoaded && waveform->isReady()) {
+            waveform->draw(painter, waveformRect, QColor(36, 255, 255, 60));
+        }
+
+        // Draw progress bar track
+        painter.fillRect(progressBarRect, QColor(60, 60, 60, 200));
+    }
+
+    // Progress bar plus the handle and the time bubble drawn above it.
+    QRect progressArea() const {
+        return QRect(0, progressBarRect.y() - 31, width(), progressBarRect.height() + 40);
+    }
+
+    void drawVisualizer(QPainter &painter) {
+        if (!mediaLoaded) return;
+
+        // Compact professional visualizer dimensions; the well itself is part of the static layer
+        int visualizerHeight = visualizerRect.height();
+        int visualizerWidth = visualizerRect.width();
+        int visualizerX = visualizerRect.x();
+        int visualizerY = visualizerRect.y();
+
+        // Draw audio bars with two distinct colors
+        int barCount = SpectrumAnalyzer::BandCount;
+        int barWidth = (visualizerWidth - (barCount - 1)) / barCount;
+        int spacing = 1;
+
+        for (int i = 0; i < barCount; ++i) {
+            float level = isPlaying ? audioLevels[i] : 0.1f;
+            float peak = isPlaying ? peakLevels[i] : 0.1f;
+            float beat = isPlaying ? beatLevels[i] : 0.0f;
+
+            int barHeight = qMin(static_cast<int>((level + beat * 0.2) * visualizerHeight), visualizerHeight);
+            int peakHeight = qMin(static_cast<int>(peak * visualizerHeight), visualizerHeight);
+
+            int x = visualizerX + i * (barWidth + spacing);
+            int y = visualizerY + visualizerHeight - barHeight;
+
+            // Alternate between two distinct colors for each bar, lightened on beats
+            int shade = beat > 0.1f ? qMin(static_cast<int>(beat * 30), BeatShades - 1) : 0;
+            painter.fillRect(x, y, barWidth, barHeight, barPalette[i % 2][shade]);
+
+            // Draw peak indicator
+            if (peakHeight > barHeight) {
+                painter.fillRect(x, y - (peakHeight - barHeight), barWidth, 1, peakPalette[i % 2][shade]);
+            }
+        }
+    }
+
+    void mouseMoveEvent(QMouseEvent *event) override {
+        // Check if mouse is over progress bar area
+        QRect hoverRect(10, height() - 25, width() - 20, 20);
+        bool wasHovering = hoverOverProgress;
+        hoverOverProgress = hoverRect.contains(event->pos());
+        if (hoverOverProgress != wasHovering) {
+            setCursor(hoverOverProgress ? Qt::PointingHandCursor : Qt::ArrowCursor);
+            update(progressArea());
+        }
+        if (draggingProgress && mediaLoaded) {
+            // Calculate new position based on mouse X
+            int mouseX = event->pos().x() - progressBarRect.x();
+            mouseX = qBound(0, mouseX, progressBarRect.width());
+            double percentage = static_cast<double>(mouseX) / progressBarRect.width();
+            qint64 newPosition = static_cast<qint64>(percentage * player->duration());
+            seeker->request(newPosition);
+            updateTimeDisplay();
+            update(progressArea());
+        }
+        QWidget::mouseMoveEvent(event);
+    }
+
+    void mousePressEvent(QMouseEvent *event) override {
+        if (event->button() == Qt::LeftButton && hoverOverProgress && mediaLoaded) {
+            draggingProgress = true;
+            wasPlayingBeforeDrag = isPlaying;
+            // Pause playback during dragging
+            if (isPlaying) {
+                player->pause();
+                isPlaying = false;
+                playButton->setIcon(QIcon(":/images/play.png"));
+            }
+            // Calculate clicked position in media
+            int mouseX = event->pos().x() - progressBarRect.x();
+            mouseX = qBound(0, mouseX, progressBarRect.width());
+            double percentage = static_cast<double>(mouseX) / progressBarRect.width();
+            qint64 newPosition = static_cast<qint64>(percentage * player->duration());
+            seeker->request(newPosition);
+            updateTimeDisplay();
+            update(progressArea());
+        }
+        QWidget::mousePressEvent(event);
+    }
+
+    void mouseReleaseEvent(QMouseEvent *event) override {
+        if (event->button() == Qt::LeftButton && draggingProgress) {
+            draggingProgress = false;
+            seeker->commit();
+            // Resume playback if it was playing before drag
+            if (wasPlayingBeforeDrag) {
+                player->play();
+                isPlaying = true;
+                playButton->setIcon(QIcon(":/images/pause.png"));
+            }
+            update(progressArea());
+        }
+        QWidget::mouseReleaseEvent(event);
+    }
+
+    bool event(QEvent *event) override {
+        if (event->type() == QEvent::DevicePixelRatioChange) {
+            staticLayer = QPixmap();
+        }
+        if (event->type() == QEvent::ToolTip) {
+            QHelpEvent *helpEvent = static_cast<QHelpEvent *>(event);
+            QPoint pos = helpEvent->pos();
+            QWidget *widget = childAt(pos);
+            if (widget && widget->inherits("QPushButton")) {
+                QPushButton *button = qobject_cast<QPushButton *>(widget);
+                QToolTip::showText(helpEvent->globalPos(), button->toolTip(), this, QRect(), 3000);
+                return true;
+            }
+        }
+        return QWidget::event(event);
+    }
+
+private slots:
+    void animateButton(QPushButton* button) {
+        QPropertyAnimation *animation = new QPropertyAnimation(button, "geometry");
+        animation->setDuration(100);
+        animation->setStartValue(button->geometry());
+        animation->setEndValue(button->geometry().adjusted(-2, -2, 2, 2));
+
+        QPropertyAnimation *reverse = new QPropertyAnimation(button, "geometry");
+        reverse->setDuration(100);
+        reverse->setStartValue(button->geometry().adjusted(-2, -2, 2, 2));
+        reverse->setEndValue(button->geometry());
+
+        QSequentialAnimationGroup *group = new QSequentialAnimationGroup(this);
+        group->addAnimation(animation);
+        group->addAnimation(reverse);
+        group->start(QAbstractAnimation::DeleteWhenStopped);
+    }
+
+    void openMediaFile() {
+        QString fileName = QFileDialog::getOpenFileName(
+            this, tr("Open Media File"),
+                                                        QStandardPaths::standardLocations(QStandardPaths::MusicLocation).value(0, QDir::homePath()),
+                                                        tr("Media Files (*.mp3 *.mp4 *.wav *.ogg *.flac)"));
+        if (!fileName.isEmpty()) {
+            loadMediaFile(fileName);
+        }
+    }
+
+    void togglePlayPause() {
+        QPushButton* senderButton = qobject_cast<QPushButton*>(sender());
+        animateButton(senderButton);
+
+        // If media is already playing, double-click opens file chooser
+        static qint64 lastClickTime = 0;
+        qint64 currentTime = QDateTime::currentMSecsSinceEpoch();
+
+        if (isPlaying && (currentTime - lastClickTime < 500)) { // 500ms double-click window
+            // Double-click detected while playing, open file chooser
+            openMediaFile();
+            lastClickTime = 0;
+            return;
+        }
+
+        lastClickTime = currentTime;
+
+        if (!mediaLoaded) {
+            openMediaFile();
+            return;
+        }
+
+        if (isPlaying) {
+            player->pause();
+            playButton->setIcon(QIcon(":/images/play.png"));
+        } else {
+            player->play();
+            playButton->setIcon(QIcon(":/images/pause.png"));
+        }
+        isPlaying = !isPlaying;
+        update(visualizerRect);
+    }
+
+    void skipForward() {
+        animateButton(qobject_cast<QPushButton*>(sender()));
+        if (mediaLoaded) {
+            player->setPosition(player->position() + 10000);
+            update(progressArea());
+        }
+    }
+
+    void saveCurrentSong() {
+        animateButton(qobject_cast<QPushButton*>(sender()));
+        if (!mediaLoaded || currentMediaPath.isEmpty()) {
+            QMessageBox::information(this, "Info", "No media loaded to save");
+            return;
+        }
+        qsizetype index = playlist.append(currentMediaPath);
+        if (index >= 0) {
+            pathValidator->validate(playlist, index);
+            analyzeTracks(index);
+            syncShuffle();
+            QMessageBox::information(this, "Saved", "Current song added to playlist");
+        } else {
+            QMessageBox::warning(this, "Error", "Could not save to playlist file");
+        }
+    }
+
+    void loadPlaylist() {
+        animateButton(qobject_cast<QPushButton*>(sender()));
+        if (!playlist.isOpen()) {
+            QMessageBox::warning(this, "Error", "Could not open playlist file");
+            return;
+        }
+        PlaylistDialog dialog(playlist, pathValidator, tags, search, this);
+        openDialog = &dialog;
+        if (dialog.isEmpty()) {
+            QMessageBox::information(this, "Info", "Playlist is empty or contains invalid paths");
+            return;
+        }
+        if (dialog.exec() == QDialog::Accepted) {
+            QString item = dialog.selectedPath();
+            if (!item.isEmpty()) {
+                loadMediaFile(item);
+            }
+        }
+    }
+
+    void toggleShuffle() {
+        animateButton(qobject_cast<QPushButton*>(sender()));
+        shuffleMode = !shuffleMode;
+
+        if (shuffleMode) {
+            shuffleButton->setIcon(QIcon(":/images/shuffle_on.png"));
+            shuffleButton->setToolTip("Shuffle: ON");
+            if (mediaLoaded) prepareNextSong();
+            QMessageBox::information(this, "Shuffle", "Shuffle mode activated");
+        } else {
+            shuffleButton->setIcon(QIcon(":/images/shuffle.png"));
+            shuffleButton->setToolTip("Shuffle: OFF");
+            player->setNextSource(QUrl());
+            QMessageBox::information(this, "Shuffle", "Shuffle mode deactivated");
+        }
+    }
+
+    void playRandomSong() {
+        if (!shuffleMode) {
+            QMessageBox::information(this, "Shuffle", "Please enable shuffle mode first");
+            return;
+        }
+
+        if (!playlist.isOpen()) {
+            QMessageBox::warning(this, "Error", "Could not open playlist file");
+            return;
+        }
+
+        // A track already drawn and primed for gapless play keeps its place in the order
+        QString randomSong = player->nextSource().toLocalFile();
+        if (randomSong.isEmpty()) randomSong = nextRandomSong();
+        if (randomSong.isEmpty()) {
+            QMessageBox::information(this, "Info", "Playlist is empty or contains invalid paths");
+            return;
+        }
+        loadMediaFile(randomSong);
+    }
+
+    // Walks the shuffled order; entries known to be missing are skipped, unverified ones are tried
+    QString nextRandomSong() {
+        qsizetype count = shuffle.size();
+        for (qsizetype step = 0; step < count; ++step) {
+            qsizetype index = shuffle.next();
+            if (playlist.isRemoved(index) || pathValidator->status(index) == PathValidator::Missing) continue;
+            QString randomSong = playlist.path(index);
+            // Don't play the same song if it's already playing
+            if (randomSong == currentMediaPath && step + 1 < count) continue;
+            return randomSong;
+        }
+        return QString();
+    }
+
+    // Hands the engine the next shuffle track early, so the change at end of media is gapless
+    void prepareNextSong() {
+        if (!shuffleMode || !playlist.isOpen() || !player->nextSource().isEmpty()) return;
+        QString nextSong = nextRandomSong();
+        if (!nextSong.isEmpty()) player->setNextSource(QUrl::fromLocalFile(nextSong));
+    }
+
+    // Goes back through the shuffle history, skipping entries that have since gone missing.
+    bool playPreviousRandomSong() {
+        // The primed next track was drawn last, so step back over it first
+        if (!player->nextSource().isEmpty()) {
+            shuffle.previous();
+            player->setNextSource(QUrl());
+        }
+        for (qsizetype index = shuffle.previous(); index >= 0; index = shuffle.previous()) {
+            if (playlist.isRemoved(index) || pathValidator->status(index) == PathValidator::Missing) continue;
+            loadMediaFile(playlist.path(index));
+            return true;
+        }
+        return false;
+    }
+
+    // Queues store entries from first on for loudness analysis and tag reading; tracks
+    // measured or read before are skipped.
+    void analyzeTracks(qsizetype first) {
+        QList<qsizetype> entries;
+        QStringList paths;
+        paths.reserve(qMax<qsizetype>(0, playlist.size() - first));
+        for (qsizetype i = first; i < playlist.size(); ++i) {
+            if (playlist.isRemoved(i)) continue;
+            entries.append(i);
+            paths.append(playlist.path(i));
+        }
+        loudness->analyze(paths);
+        tags->read(paths);
+        search->index(entries, paths);
+    }
+
+    // Entries appended to the store join the running shuffle cycle without a reshuffle.
+    void syncShuffle() {
+        while (shuffle.size() < playlist.size()) shuffle.append();
+    }
+
+public slots:
+    void importPlaylist() {
+        QString fileName = QFileDialog::getOpenFileName(this, tr("Import Playlist"), QDir::currentPath(),
+                                                        tr("Playlists (*.m3u *.m3u8 *.pls *.xspf *.txt);;All Files (*)"));
+        if (fileName.isEmpty()) return;
+        qsizetype firstNew = playlist.size();
+        PlaylistFile file(playlist);
+        int added = file.importFile(fileName);
+        pathValidator->validate(playlist, firstNew);
+        analyzeTracks(firstNew);
+        syncShuffle();
+        if (added < 0) {
+            QMessageBox::warning(this, "Error", file.errorString());
+        } else {
+            const PlaylistFile::ImportStats stats = file.importStats();
+            const qint64 perSecond = stats.entries * 1000 / qMax<qint64>(stats.elapsedMs, 1);
+            QMessageBox::information(this, "Imported",
+                                     QString("%1 songs added to playlist (%2 entries read, %3 skipped) in %4 ms, %5 entries/s")
+                                         .arg(added).arg(stats.entries).arg(stats.skipped).arg(stats.elapsedMs).arg(perSecond));
+        }
+    }
+
+    void scanLibrary() {
+        if (!playlist.isOpen()) {
+            QMessageBox::warning(this, "Error", "Could not open playlist file");
+            return;
+        }
+        if (libraryScanner->isScanning()) {
+            QMessageBox::information(this, "Library Scan", "A library scan is already running");
+            return;
+        }
+        const QStringList roots = QStandardPaths::standardLocations(QStandardPaths::MusicLocation);
+        QSettings().setValue("library/roots", roots);
+        // Watch first so nothing created during the scan slips between the two
+        libraryWatcher->watch(roots);
+        scannedAdded = 0;
+        announceScan = true;
+        libraryScanner->start(roots);
+    }
+
+    bool usesStreamEngine() const { return qobject_cast<StreamPlaybackEngine *>(player) != nullptr; }
+
+    // Swaps the playback engine at runtime; the current track is reloaded and resumes where it was.
+    void setStreamEngine(bool stream) {
+        if (stream == usesStreamEngine()) return;
+        QSettings().setValue("playback/engine", stream ? "stream" : "mediaplayer");
+        const QString path = currentMediaPath;
+        const qint64 position = player->position();
+        resetPlayer();
+        delete player;
+        player = createPlayer(stream);
+        updateActivity();
+        if (path.isEmpty()) return;
+        loadMediaFile(path);
+        restorePosition = position;
+    }
+
+    // Crossfade length for shuffle track changes, kept in QSettings playback/crossfadeMs; 0 turns it off.
+    void setCrossfade(int ms) {
+        QSettings().setValue("playback/crossfadeMs", ms);
+        player->setCrossfade(ms);
+    }
+
+    int crossfadeMs() const { return QSettings().value("playback/crossfadeMs", 0).toInt(); }
+
+    void exportPlaylist() {
+        QString selectedFilter;
+        QString fileName = QFileDialog::getSaveFileName(this, tr("Export Playlist"), "musiclist.m3u8",
+                                                        tr("M3U Playlist (*.m3u8 *.m3u);;PLS Playlist (*.pls);;"
+                                                           "XSPF Playlist (*.xspf);;Text List (*.txt)"),
+                                                        &selectedFilter);
+        if (fileName.isEmpty()) return;
+        // The format follows the extension, so a bare name takes the chosen filter's
+        if (QFileInfo(fileName).suffix().isEmpty()) {
+            const qsizetype star = selectedFilter.indexOf("*.");
+            if (star >= 0) fileName += selectedFilter.mid(star + 1, selectedFilter.indexOf(QRegularExpression("[ )]"), star) - star - 1);
+        }
+        PlaylistFile file(playlist);
+        if (!file.exportFile(fileName, tags)) {
+            QMessageBox::warning(this, "Error", file.errorString());
+        }
+    }
+
+private slots:
+
+    // Each scanner batch becomes a single store write; paths already in the playlist are skipped
+    void addScannedFiles(const QStringList &paths) {
+        QStringList fresh;
+        fresh.reserve(paths.size());
+        for (const QString &path : paths) {
+            if (!playlist.contains(path)) fresh.append(path);
+        }
+        qsizetype first = playlist.appendBatch(fresh);
+        if (first < 0) return;
+        scannedAdded += fresh.size();
+        pathValidator->validate(playlist, first);
+        loudness->analyze(fresh);
+        tags->read(fresh);
+        QList<qsizetype> entries;
+        entries.reserve(fresh.size());
+        for (qsizetype i = 0; i < fresh.size(); ++i) entries.append(first + i);
+        search->index(entries, fresh);
+        syncShuffle();
+    }
+
+    // One watcher commit: removals are flagged in the store in one pass, additions go in as one batch
+    void applyLibraryChanges(const QStringList &added, const QStringList &removed, const QStringList &removedDirectories) {
+        QList<qsizetype> gone;
+        for (const QString &path : removed) {
+            qsizetype index = playlist.indexOf(path);
+            if (index >= 0) gone.append(index);
+        }
+        if (!removedDirectories.isEmpty()) {
+            QList<QByteArray> prefixes;
+            for (const QString &directory : removedDirectories) prefixes.append(directory.toUtf8() + '/');
+            for (qsizetype i = 0; i < playlist.size(); ++i) {
+                if (playlist.isRemoved(i)) continue;
+                const QByteArrayView bytes = playlist.pathBytes(i);
+                for (const QByteArray &prefix : std::as_const(prefixes)) {
+                    if (bytes.startsWith(prefix)) {
+                        gone.append(i);
+                        break;
+                    }
+                }
+            }
+        }
+        if (!gone.isEmpty()) {
+            if (playlist.removeBatch(gone) < 0) {
+                qWarning("%s", qPrintable(playlist.errorString()));
+            } else {
+                search->remove(gone);
+                // The picker's rows map onto live entries, which just shifted
+                if (openDialog) openDialog->storeChanged();
+            }
+        }
+        if (!added.isEmpty()) addScannedFiles(added);
+    }
+
+    // Watcher events were lost, so fall back to a full pass over the watched roots
+    void rescanLibrary() {
+        const QStringList roots = QSettings().value("library/roots").toStringList();
+        if (roots.isEmpty() || libraryScanner->isScanning()) return;
+        announceScan = false;
+        libraryScanner->start(roots);
+        pathValidator->validate(playlist);
+    }
+
+    void handleMediaStatusChanged(QMediaPlayer::MediaStatus status) {
+        if (status == QMediaPlayer::EndOfMedia) {
+            // Auto-play next random song when shuffle is enabled
+            if (shuffleMode) {
+                playRandomSong();
+            } else {
+                playButton->setIcon(QIcon(":/images/play.png"));
+                isPlaying = false;
+                player->setPosition(0);
+                updateTimeDisplay();
+                update();
+            }
+        } else if (status == QMediaPlayer::LoadedMedia) {
+            if (restorePosition > 0) player->setPosition(restorePosition);
+            restorePosition = -1;
+            mediaLoaded = true;
+            isPlaying = true;
+            playButton->setIcon(QIcon(":/images/pause.png"));
+            player->play();
+            updateTimeDisplay();
+            updateFileNameDisplay();
+            update();
+            prepareNextSong();
+        }
+    }
+
+    // The primed next track is already playing; catch the UI and analysis up with it
+    void handleTrackAdvanced(const QUrl &source) {
+        analyzer->reset();
+        seeker->cancel();
+        currentMediaPath = source.toLocalFile();
+        showWaveform(currentMediaPath);
+        shownPositionSecond = shownDurationSecond = -1;
+        shownProgressWidth = -1;
+        updateTimeDisplay();
+        updateFileNameDisplay();
+        update();
+        prepareNextSong();
+    }
+
+    void handleError(QMediaPlayer::Error error, const QString &errorString) {
+        // In shuffle mode an unplayable entry (possibly not yet validated) is marked and skipped
+        if (shuffleMode && error == QMediaPlayer::ResourceError) {
+            pathValidator->markMissing(playlist.indexOf(currentMediaPath));
+            playRandomSong();
+            return;
+        }
+        QMessageBox::warning(this, tr("Error"), errorString);
+        resetPlayer();
+    }
+
+    // Runs the frame clock and the PCM tap only while there is something to animate.
+    // A hidden or paused panel takes no timer wakeups and no analysis work.
+    void updateActivity() {
+        bool animate = isVisible() && mediaLoaded && player->playbackState() == QMediaPlayer::PlayingState;
+        if (animate == frameClock->isActive()) return;
+        if (animate) {
+            // Idle bars are drawn flat, so rise from there instead of jumping to stale levels
+            audioLevels.fill(0.1f);
+            peakLevels.fill(0.1f);
+            beatLevels.fill(0.0f);
+            beatIntensity = 0.0f;
+            visualizerLag = beatLag = 0;
+            player->setAnalyzer(analyzer);
+            frameClock->start();
+        } else {
+            frameClock->stop();
+            player->setAnalyzer(nullptr);
+            // One last frame to draw the idle state
+            frameClock->requestFrame();
+        }
+    }
+
+    void advanceFrame(qint64 elapsedMs) {
+        if (!mediaLoaded) return;
+        bool barsChanged = false;
+
+        // Fixed-step catch-up keeps the bar and beat dynamics independent of the display rate
+        visualizerLag += elapsedMs;
+        for (int steps = 0; visualizerLag >= VisualizerStepMs && steps < MaxCatchUpSteps; ++steps) {
+            visualizerLag -= VisualizerStepMs;
+            updateVisualizer();
+            barsChanged = true;
+        }
+        visualizerLag = qMin(visualizerLag, VisualizerStepMs);
+
+        beatLag += elapsedMs;
+        for (int steps = 0; beatLag >= BeatStepMs && steps < MaxCatchUpSteps; ++steps) {
+            beatLag -= BeatStepMs;
+            updateBeat();
+        }
+        beatLag = qMin(beatLag, BeatStepMs);
+
+        // Repaint only the regions that moved; the rest comes from the cached static layer
+        if (barsChanged) update(visualizerRect);
+        if (updateProgress()) update(progressArea());
+    }
+
+    // Where the progress bar and time show the track: the drag target while scrubbing.
+    qint64 shownPosition() const { return seeker->isActive() ? seeker->targetPosition() : player->position(); }
+
+    // Returns true when the progress handle moved by at least a pixel.
+    bool updateProgress() {
+        updateTimeDisplay();
+        if (progressBarRect.isEmpty() || player->duration() <= 0) return false;
+        double progress = qBound(0.0, static_cast<double>(shownPosition()) / player->duration(), 1.0);
+        int progressWidth = static_cast<int>(progress * progressBarRect.width());
+        if (progressWidth == shownProgressWidth) return false;
+        shownProgressWidth = progressWidth;
+        return true;
+    }
+
+    void updateVisualizer() {
+        if (!mediaLoaded) return;
+
+        // Pick up the newest analyzed frame; keep the previous one if the worker hasn't produced more
+        analyzer->fetchFrame(spectrumFrame);
+
+        float targets[SpectrumAnalyzer::BandCount];
+        for (int i = 0; i < SpectrumAnalyzer::BandCount; ++i) {
+            float bandLevel = isPlaying ? spectrumFrame.bands[i] : 0.0f;
+            float beatEffect = beatLevels[i] * 0.3f;
+            targets[i] = qBound(0.1f, bandLevel + beatEffect, 1.0f);
+        }
+        SpectrumKernel::smooth(audioLevels.data(), peakLevels.data(), targets, SpectrumAnalyzer::BandCount);
+    }
+
+    void updateBeat() {
+        if (!mediaLoaded || !isPlaying) return;
+
+        // Onsets come from the analyzer thread via the frame updateVisualizer() fetched
+        if (spectrumFrame.onsetCount != lastOnsetCount) {
+            lastOnsetCount = spectrumFrame.onsetCount;
+            beatIntensity = 0.4f + 0.4f * spectrumFrame.onsetStrength;
+            beatLevels.fill(beatIntensity);
+        }
+
+        int bpm = qRound(spectrumFrame.bpm);
+        if (bpm != shownBpm) {
+            shownBpm = bpm;
+            timeLabel->setToolTip(bpm > 0 ? QString("Current time / Total time\n~%1 BPM").arg(bpm)
+                                          : QString("Current time / Total time"));
+        }
+
+        beatIntensity *= 0.92f;
+        if (beatIntensity < 0.01f) beatIntensity = 0.0f;
+
+        beatPhase += beatIntensity * 0.05f;
+
+        for (float &level : beatLevels) {
+            level *= 0.9f;
+            if (level < 0.01f) level = 0.0f;
+        }
+    }
+
+    void updateTimeDisplay() {
+        if (!mediaLoaded) return;
+        qint64 position = shownPosition();
+        qint64 duration = player->duration();
+        // Only touch the label when the displayed seconds change
+        if (position / 1000 == shownPositionSecond && duration / 1000 == shownDurationSecond) return;
+        shownPositionSecond = position / 1000;
+        shownDurationSecond = duration / 1000;
+        timeLabel->setTime(position, duration);
+    }
+
+    void updateFileNameDisplay() {
+        if (!mediaLoaded || currentMediaPath.isEmpty()) {
+            fileNameLabel->setText("No file loaded");
+            return;
+        }
+        const TrackTags trackTags = tags->tags(currentMediaPath);
+        fileNameLabel->setText(tags->displayName(currentMediaPath));
+        fileNameLabel->setToolTip(trackTags.album.isEmpty() ? currentMediaPath : trackTags.album + '\n' + currentMediaPath);
+    }
+
+public slots:
+    void loadMediaFile(const QString &fileName) {
+        resetPlayer();
+        analyzer->reset();
+        player->setSource(QUrl::fromLocalFile(fileName));
+        currentMediaPath = fileName;
+        // Files opened from outside the playlist get their tags read too
+        tags->read({fileName});
+        showWaveform(fileName);
+        updateFileNameDisplay();
+        update();
+    }
+
+private:
+    // Swaps the overview behind the seek bar; the static layer is redrawn when it is ready.
+    void showWaveform(const QString &path) {
+        waveform->request(path);
+        staticLayer = QPixmap();
+    }
+
+    void resetPlayer() {
+        seeker->cancel();
+        if (player) {
+            player->stop();
+            player->setSource(QUrl());
+            player->setNextSource(QUrl());
+        }
+        mediaLoaded = false;
+        isPlaying = false;
+        currentMediaPath = "";
+        playButton->setIcon(QIcon(":/images/play.png"));
+        timeLabel->clear();
+        shownPositionSecond = shownDurationSecond = -1;
+        shownProgressWidth = -1;
+        fileNameLabel->setText("No file loaded");
+        update();
+    }
+
+    void setupUI() {
+        setWindowFlags(Qt::Tool | Qt::FramelessWindowHint | Qt::WindowStaysOnTopHint);
+        setAttribute(Qt::WA_TranslucentBackground);
+        setStyleSheet(R"(
+            QWidget {
+                background: transparent;
+                border-radius: 8px;
+                padding: 5px;
+            }
+            QPushButton {
+                background: rgba(0, 86, 143, 150);
+                border: 1px solid rgba(36, 255, 255, 100);
+                border-radius: 4px;
+                padding: 5px;
+            }
+            QPushButton:hover {
+                background: rgba(0, 86, 143, 200);
+                border: 1px solid rgba(36, 255, 255, 200);
+            }
+            QToolTip {
+                color: #24ffff;
+                background-color: #333;
+                border: 1px solid #555;
+                padding: 2px;
+            }
+            QInputDialog {
+                background: rgba(0, 86, 143, 220);
+            }
+            QMessageBox {
+                background: rgba(0, 86, 143, 220);
+            }
+        )");
+
+        QVBoxLayout *mainLayout = new QVBoxLayout(this);
+        mainLayout->setSpacing(5);
+        mainLayout->setContentsMargins(10, 10, 10, 15);
+
+        // Top bar
+        QHBoxLayout *topBarLayout = new QHBoxLayout();
+        topBarLayout->addStretch();
+        QLabel *apexMusicLabel = new QLabel("ApexMusic v1.03.1", this);
+        apexMusicLabel->setAlignment(Qt::AlignCenter);
+        apexMusicLabel->setStyleSheet("QLabel { color: #24ffff; font-size: 12px; font-weight: bold; }");
+        topBarLayout->addWidget(apexMusicLabel);
+        topBarLayout->addStretch();
+        QPushButton *closeButton = new QPushButton(this);
+        closeButton->setIcon(QIcon(":/images/close.png"));
+        closeButton->setIconSize(QSize(16, 16));
+        closeButton->setToolTip("Close");
+        closeButton->setStyleSheet("QPushButton { padding: 2px; }");
+        connect(closeButton, &QPushButton::clicked, this, &QWidget::close);
+        topBarLayout->addWidget(closeButton);
+        mainLayout->addLayout(topBarLayout);
+
+        // File name label
+        fileNameLabel = new QLabel("No file loaded", this);
+        fileNameLabel->setAlignment(Qt::AlignCenter);
+        fileNameLabel->setStyleSheet("QLabel { color: #24ffff; font-size: 10px; font-weight: bold; }");
+        fileNameLabel->setMaximumWidth(200);
+        fileNameLabel->setWordWrap(true);
+        mainLayout->addWidget(fileNameLabel);
+
+        // Fixed space for visualizer
+        mainLayout->addSpacing(30);
+
+        // Timing label
+        timeLabel = new TimeLabel(this);
+        timeLabel->setToolTip("Current time / Total time");
+        mainLayout->addWidget(timeLabel);
+
+        // Control buttons
+        QHBoxLayout *buttonLayout = new QHBoxLayout();
+        buttonLayout->setSpacing(5);
+
+        QPushButton *backButton = new QPushButton(this);
+        backButton->setIcon(QIcon(":/images/back.png"));
+        backButton->setIconSize(QSize(24, 24));
+        backButton->setToolTip("Back 5 seconds");
+        connect(backButton, &QPushButton::clicked, this, [this]() {
+            // Early in a shuffled track, back means the previous track
+            if (shuffleMode && mediaLoaded && player->position() < 3000 && playPreviousRandomSong()) {
+                return;
+            }
+            if (mediaLoaded) {
+                player->setPosition(player->position() - 5000);
+                update(progressArea());
+            }
+        });
+        connect(backButton, &QPushButton::clicked, this, [this, backButton]() { animateButton(backButton); });
+        buttonLayout->addWidget(backButton);
+
+        playButton = new QPushButton(this);
+        playButton->setIcon(QIcon(":/images/play.png"));
+        playButton->setIconSize(QSize(24, 24));
+        playButton->setToolTip("Play/Pause\nDouble-click when playing to open file chooser");
+        connect(playButton, &QPushButton::clicked, this, &MediaControlWidget::togglePlayPause);
+        buttonLayout->addWidget(playButton);
+
+        QPushButton *skipButton = new QPushButton(this);
+        skipButton->setIcon(QIcon(":/images/skip.png"));
+        skipButton->setIconSize(QSize(24, 24));
+        skipButton->setToolTip("Skip 10 seconds");
+        connect(skipButton, &QPushButton::clicked, this, &MediaControlWidget::skipForward);
+        buttonLayout->addWidget(skipButton);
+
+        QPushButton *saveCurrentButton = new QPushButton(this);
+        saveCurrentButton->setIcon(QIcon(":/images/save.png"));
+        saveCurrentButton->setIconSize(QSize(24, 24));
+        saveCurrentButton->setToolTip("Save current song to playlist");
+        connect(saveCurrentButton, &QPushButton::clicked, this, &MediaControlWidget::saveCurrentSong);
+        buttonLayout->addWidget(saveCurrentButton);
+
+        QPushButton *loadPlaylistButton = new QPushButton(this);
+        loadPlaylistButton->setIcon(QIcon(":/images/savelist.png"));
+        loadPlaylistButton->setIconSize(QSize(24, 24));
+        loadPlaylistButton->setToolTip("Load from playlist");
+        connect(loadPlaylistButton, &QPushButton::clicked, this, &MediaControlWidget::loadPlaylist);
+        buttonLayout->addWidget(loadPlaylistButton);
+
+        // NEW: Shuffle button as the 5th button on the right
+        shuffleButton = new QPushButton(this);
+        shuffleButton->setIcon(QIcon(":/images/shuffle.png"));
+        shuffleButton->setIconSize(QSize(24, 24));
+        shuffleButton->setToolTip("Shuffle: OFF\nClick to enable random playback from playlist");
+        connect(shuffleButton, &QPushButton::clicked, this, &MediaControlWidget::toggleShuffle);
+        buttonLayout->addWidget(shuffleButton);
+
+        mainLayout->addLayout(buttonLayout);
+        setLayout(mainLayout);
+        adjustSize();
+    }
+
+    void setupPlayer() {
+        // The engine taps the decoded PCM for the visualizer while updateActivity() says so
+        analyzer = new SpectrumAnalyzer(this);
+        seeker = new SeekScheduler(this);
+        // Tracks play at their measured ReplayGain-style gain once analyzed, unity before that
+        loudness = new LoudnessAnalyzer(this);
+        waveform = new WaveformCache(this);
+        connect(waveform, &WaveformCache::ready, this, [this]() {
+            staticLayer = QPixmap();
+            update(progressArea());
+        });
+        artwork = new ArtworkCache(this);
+        connect(artwork, &ArtworkCache::ready, this, [this](const QString &path) {
+            if (path != currentMediaPath) return;
+            staticLayer = QPixmap();
+            update();
+        });
+        player = createPlayer(QSettings().value("playback/engine").toString() == "stream");
+    }
+
+    // QSettings playback/bufferMs and playback/latencyMs size the stream engine's ring and sink buffer
+    PlaybackEngine *createPlayer(bool stream) {
+        PlaybackEngine *engine;
+        if (stream) {
+            QSettings settings;
+            engine = new StreamPlaybackEngine(settings.value("playback/bufferMs", StreamPlaybackEngine::DefaultBufferMs).toInt(),
+                                              settings.value("playback/latencyMs", StreamPlaybackEngine::DefaultLatencyMs).toInt(),
+                                              this);
+        } else {
+            // Two pipelines, so the next shuffle track can be primed while this one plays
+            engine = new MediaPlayerEngine(this);
+        }
+        seeker->setEngine(engine);
+        engine->setCrossfade(crossfadeMs());
+        engine->setGainLookup([this](const QUrl &source) { return loudness->gain(source.toLocalFile()); });
+        connect(engine, &PlaybackEngine::mediaStatusChanged, this, &MediaControlWidget::handleMediaStatusChanged);
+        connect(engine, &PlaybackEngine::errorOccurred, this, &MediaControlWidget::handleError);
+        connect(engine, &PlaybackEngine::trackAdvanced, this, &MediaControlWidget::handleTrackAdvanced);
+        // The clock only runs while the panel is visible and playing; see updateActivity()
+        connect(engine, &PlaybackEngine::playbackStateChanged, this, &MediaControlWidget::updateActivity);
+        connect(engine, &PlaybackEngine::positionChanged, this, [this]() {
+            // Seeks made while paused still need the label and handle refreshed; a hidden
+            // panel has nothing to refresh and is redrawn in full when shown again
+            if (isVisible() && !frameClock->isActive()) frameClock->requestFrame();
+        });
+        return engine;
+    }
+
+    PlaybackEngine *player;
+    PlaylistStore playlist;
+    PathValidator *pathValidator;
+    TagCache *tags;
+    SearchIndex *search;
+    QPointer<PlaylistDialog> openDialog;  // the song picker while it is open
+    ShuffleEngine shuffle;
+    LibraryScanner *libraryScanner;
+    LibraryWatcher *libraryWatcher;
+    SpectrumAnalyzer *analyzer;
+    SeekScheduler *seeker;
+    LoudnessAnalyzer *loudness;
+    WaveformCache *waveform;
+    ArtworkCache *artwork;
+    QPushButton *playButton;
+    QPushButton *shuffleButton;  // NEW: Shuffle button pointer
+    TimeLabel *timeLabel;
+    QLabel *fileNameLabel;
+    FrameClock *frameClock;
+    bool mediaLoaded;
+    bool isPlaying;
+    QString currentMediaPath;
+    bool hoverOverProgress;
+    bool draggingProgress;
+    bool wasPlayingBeforeDrag;
+    QRect progressBarRect;
+    QRect waveformRect;
+    static constexpr int WaveformHeight = 16;
+    QRect visualizerRect;
+    QPixmap staticLayer;
+    bool staticLayerLoaded;
+    quint64 paintCount;
+    qint64 paintTotalNs;
+    qint64 paintMaxNs;
+    std::array<float, SpectrumAnalyzer::BandCount> audioLevels;
+    std::array<float, SpectrumAnalyzer::BandCount> peakLevels;
+    std::array<float, SpectrumAnalyzer::BandCount> beatLevels;
+    static constexpr int BeatShades = 31;
+    QColor barPalette[2][BeatShades];
+    QColor peakPalette[2][BeatShades];
+    TimeGlyphs bubbleGlyphs;
+    SpectrumAnalyzer::Frame spectrumFrame;
+    float beatPhase;
+    quint32 lastOnsetCount;
+    float beatIntensity;
+    int shownBpm;
+    bool shuffleMode;  // NEW: Shuffle mode state
+    qint64 scannedAdded;
+    bool announceScan;
+    qint64 restorePosition;
+    static constexpr qint64 VisualizerStepMs = 30;
+    static constexpr qint64 BeatStepMs = 20;
+    static constexpr int MaxCatchUpSteps = 4;
+    qint64 visualizerLag;
+    qint64 beatLag;
+    int shownProgressWidth;
+    qint64 shownPositionSecond;
+    qint64 shownDurationSecond;
+};
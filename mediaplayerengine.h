@@ -0,0 +1,241 @@
+#pragma once
+
+#include <QMediaPlayer>
+#include <QAudioOutput>
+#include <QAudioBufferOutput>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <atomic>
+#include <cmath>
+#include "playbackengine.h"
+#include "spectrumanalyzer.h"
+
+// PlaybackEngine on two QMediaPlayer pipelines.
+//
+// One pipeline plays while the other holds the next track, opened and paused
+// so the backend has already demuxed and decoded its first packets. At end of
+// media the standby pipeline is started from the same event that reports the
+// end, then the outgoing one is torn down, so no load or LoadedMedia round
+// trip sits between the two tracks. Only the active pipeline's signals are
+// forwarded; the PCM tap follows whichever pipeline is active.
+//
+// A crossfade starts the standby pipeline that long before the end and hands
+// over at once; the outgoing pipeline keeps playing underneath while both
+// output volumes follow equal-power ramps. The mixing is the audio server's,
+// so the overlap costs this process a timer tick per FadeStepMs.
+//
+// Track gains become the pipelines' output volumes, which cannot go above
+// unity: quiet tracks are not boosted here, only loud ones turned down.
+class MediaPlayerEngine : public PlaybackEngine {
+    Q_OBJECT
+public:
+    explicit MediaPlayerEngine(QObject *parent = nullptr)
+    : PlaybackEngine(parent) {
+        fadeTimer = new QTimer(this);
+        fadeTimer->setInterval(FadeStepMs);
+        connect(fadeTimer, &QTimer::timeout, this, &MediaPlayerEngine::stepFade);
+        // The analyzer copies the PCM off on the emitting thread
+        tap = new QAudioBufferOutput(this);
+        connect(tap, &QAudioBufferOutput::audioBufferReceived, this, [this](const QAudioBuffer &buffer) {
+            if (SpectrumAnalyzer *target = analyzer.load(std::memory_order_acquire)) target->pushBuffer(buffer);
+        }, Qt::DirectConnection);
+        for (int i = 0; i < 2; ++i) {
+            players[i] = new QMediaPlayer(this);
+            outputs[i] = new QAudioOutput(this);
+            players[i]->setAudioOutput(outputs[i]);
+            QMediaPlayer *pipeline = players[i];
+            connect(pipeline, &QMediaPlayer::mediaStatusChanged, this, [this, pipeline](QMediaPlayer::MediaStatus status) {
+                if (pipeline == current()) {
+                    handleStatus(status);
+                } else if (status == QMediaPlayer::LoadedMedia) {
+                    // Preroll: paused from stopped makes the backend open the decoders and fill its queues
+                    pipeline->pause();
+                    nextReady = true;
+                } else if (status == QMediaPlayer::InvalidMedia) {
+                    setNextSource(QUrl());
+                }
+            });
+            connect(pipeline, &QMediaPlayer::playbackStateChanged, this, [this, pipeline](QMediaPlayer::PlaybackState state) {
+                if (pipeline == current()) emit playbackStateChanged(state);
+            });
+            connect(pipeline, &QMediaPlayer::positionChanged, this, [this, pipeline](qint64 position) {
+                if (pipeline != current()) return;
+                // Reports of the position from before the seek still arrive after setPosition()
+                if (seeking && qAbs(position - seekTarget) <= SeekToleranceMs) {
+                    seeking = false;
+                    emit seekFinished();
+                }
+                if (measuringGap && position > 0) {
+                    measuringGap = false;
+                    recordGap(measuringGapless, gapTimer.nsecsElapsed() / 1000);
+                }
+                emit positionChanged(position);
+                // The fade takes whatever is left if the position report came late
+                const qint64 remaining = pipeline->duration() - position;
+                if (crossfadeMs > 0 && nextReady && !fadingOut && pipeline->duration() > 0 && remaining <= crossfadeMs) {
+                    advance(qMax<qint64>(1, remaining));
+                }
+            });
+            connect(pipeline, &QMediaPlayer::errorOccurred, this, [this, pipeline](QMediaPlayer::Error error, const QString &errorString) {
+                if (pipeline == current()) {
+                    emit errorOccurred(error, errorString);
+                } else {
+                    // A bad next track only costs the gapless change; it is found again when loaded cold
+                    setNextSource(QUrl());
+                }
+            });
+        }
+    }
+
+    void setSource(const QUrl &source) override {
+        endFade();
+        seeking = false;
+        gains[active] = qMin(1.0f, trackGain(source));
+        outputs[active]->setVolume(gains[active]);
+        // A new source straight after EndOfMedia is the cold track change gapless play avoids
+        measuringGap = !source.isEmpty() && endedAt.isValid() && endedAt.elapsed() < ColdChangeWindowMs;
+        measuringGapless = false;
+        endedAt.invalidate();
+        current()->setSource(source);
+    }
+
+    QUrl source() const override { return current()->source(); }
+
+    void setNextSource(const QUrl &source) override {
+        if (source == next) return;
+        next = source;
+        nextReady = false;
+        // The standby pipeline is still fading out; endFade() loads next into it
+        if (fadingOut) return;
+        loadStandby();
+    }
+
+    QUrl nextSource() const override { return next; }
+
+    void play() override { current()->play(); }
+    void pause() override {
+        endFade();
+        current()->pause();
+    }
+
+    void stop() override {
+        endFade();
+        measuringGap = false;
+        current()->stop();
+    }
+
+    void setPosition(qint64 position) override {
+        seeking = true;
+        seekTarget = position;
+        current()->setPosition(position);
+    }
+    qint64 position() const override { return current()->position(); }
+    qint64 duration() const override { return current()->duration(); }
+    QMediaPlayer::PlaybackState playbackState() const override { return current()->playbackState(); }
+
+    void setAnalyzer(SpectrumAnalyzer *target) override {
+        analyzer.store(target, std::memory_order_release);
+        current()->setAudioBufferOutput(target ? tap : nullptr);
+    }
+
+    void setCrossfade(int ms) override { crossfadeMs = qMax(0, ms); }
+
+private:
+    static constexpr qint64 ColdChangeWindowMs = 100;
+    // A seek lands on the backend's nearest frame and playback may move on before the first report
+    static constexpr qint64 SeekToleranceMs = 250;
+    static constexpr int FadeStepMs = 16;
+
+    QMediaPlayer *current() const { return players[active]; }
+    QMediaPlayer *standby() const { return players[active ^ 1]; }
+
+    void loadStandby() {
+        standby()->stop();
+        gains[active ^ 1] = qMin(1.0f, trackGain(next));
+        outputs[active ^ 1]->setVolume(gains[active ^ 1]);
+        standby()->setSource(next);
+    }
+
+    void handleStatus(QMediaPlayer::MediaStatus status) {
+        if (status != QMediaPlayer::EndOfMedia) {
+            emit mediaStatusChanged(status);
+            return;
+        }
+        // A track shorter than the fade ends before the previous one has faded out
+        endFade();
+        if (!nextReady) {
+            gapTimer.start();
+            endedAt.start();
+            emit mediaStatusChanged(status);
+            return;
+        }
+        advance(0);
+    }
+
+    // Makes the primed pipeline current and starts it first; tearing down the old one can
+    // wait until after. With fadeMs it keeps playing instead until stepFade() ramps it out.
+    void advance(qint64 fadeMs) {
+        QMediaPlayer *outgoing = current();
+        active ^= 1;
+        seeking = false;
+        gapTimer.start();
+        measuringGap = true;
+        measuringGapless = true;
+        if (fadeMs > 0) {
+            fadingOut = outgoing;
+            fadeLengthMs = fadeMs;
+            fadeClock.start();
+            outputs[active]->setVolume(0.0f);
+            fadeTimer->start();
+        }
+        current()->play();
+        if (analyzer.load(std::memory_order_relaxed)) {
+            outgoing->setAudioBufferOutput(nullptr);
+            current()->setAudioBufferOutput(tap);
+        }
+        if (!fadingOut) {
+            outgoing->stop();
+            outgoing->setSource(QUrl());
+        }
+        const QUrl advanced = next;
+        next.clear();
+        nextReady = false;
+        emit trackAdvanced(advanced);
+    }
+
+    void stepFade() {
+        const double progress = qMin(1.0, static_cast<double>(fadeClock.elapsed()) / fadeLengthMs);
+        outputs[active ^ 1]->setVolume(gains[active ^ 1] * static_cast<float>(std::cos(progress * M_PI / 2)));
+        outputs[active]->setVolume(gains[active] * static_cast<float>(std::sin(progress * M_PI / 2)));
+        if (progress >= 1.0) endFade();
+    }
+
+    // Cuts off whatever is left of the outgoing track and primes any next track set meanwhile.
+    void endFade() {
+        if (!fadingOut) return;
+        fadeTimer->stop();
+        fadingOut = nullptr;
+        outputs[active]->setVolume(gains[active]);
+        loadStandby();
+    }
+
+    QMediaPlayer *players[2];
+    QAudioOutput *outputs[2];
+    float gains[2] = {1.0f, 1.0f};
+    int active = 0;
+    QUrl next;
+    bool nextReady = false;
+    QAudioBufferOutput *tap;
+    std::atomic<SpectrumAnalyzer *> analyzer{nullptr};
+    QElapsedTimer gapTimer;
+    QElapsedTimer endedAt;
+    bool measuringGap = false;
+    bool measuringGapless = false;
+    bool seeking = false;
+    qint64 seekTarget = 0;
+    int crossfadeMs = 0;
+    QTimer *fadeTimer;
+    QElapsedTimer fadeClock;
+    qint64 fadeLengthMs = 0;
+    QMediaPlayer *fadingOut = nullptr;
+};
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "spectrumkernel.h"
+
+// Streaming onset detector and tempo tracker fed with one magnitude spectrum
+// per analysis hop.
+//
+// Onsets are peaks of log-compressed spectral flux that rise above an adaptive
+// threshold (median of the recent flux plus a floor relative to the running
+// maximum). Tempo comes from the autocorrelation of the onset envelope,
+// weighted towards 120 BPM, re-estimated about once a second.
+class OnsetDetector {
+public:
+    static constexpr int ThresholdWindow = 16;
+    static constexpr float MinOnsetInterval = 0.1f;   // seconds
+    static constexpr float EnvelopeSeconds = 8.0f;
+    static constexpr float MinBpm = 60.0f;
+    static constexpr float MaxBpm = 200.0f;
+
+    struct TrackAnalysis {
+        std::vector<double> onsetSeconds;
+        float bpm = 0.0f;
+    };
+
+    OnsetDetector() { reset(1025, 44100.0f / 1024); }
+
+    // bins: magnitudes per spectrum; framesPerSecond: sample rate / hop size.
+    void reset(int bins, float framesPerSecond) {
+        fps = framesPerSecond;
+        previous.assign(bins, 0.0f);
+        fluxHistory.fill(0.0f);
+        envelope.assign(std::max(1, static_cast<int>(EnvelopeSeconds * fps)), 0.0f);
+        frame = 0;
+        lastOnsetFrame = -1000000;
+        fluxBefore = fluxPeak = 0.0f;
+        runningMax = 1e-3f;
+        currentStrength = 0.0f;
+        currentBpm = 0.0f;
+    }
+
+    // Returns true when the previous hop was an onset: peak picking needs one frame of lookahead.
+    bool process(const float *magnitudes, float scale = 1.0f) {
+        const int bins = static_cast<int>(previous.size());
+        float flux = 0.0f;
+        for (int k = 0; k < bins; ++k) {
+            const float compressed = std::log1p(Compression * magnitudes[k] * scale);
+            flux += std::max(0.0f, compressed - previous[k]);
+            previous[k] = compressed;
+        }
+        flux /= bins;
+
+        // Adaptive threshold from the hops before the candidate peak
+        std::array<float, ThresholdWindow> sorted = fluxHistory;
+        std::nth_element(sorted.begin(), sorted.begin() + ThresholdWindow / 2, sorted.end());
+        const float median = sorted[ThresholdWindow / 2];
+        runningMax = std::max(runningMax * RunningMaxDecay, fluxPeak);
+        const float threshold = median * 1.4f + runningMax * 0.1f;
+
+        const float candidate = fluxPeak;
+        const bool isPeak = candidate > fluxBefore && candidate >= flux && candidate > threshold;
+        bool onset = false;
+        if (isPeak && (frame - 1 - lastOnsetFrame) >= MinOnsetInterval * fps) {
+            lastOnsetFrame = frame - 1;
+            currentStrength = std::clamp((candidate - threshold) / std::max(runningMax - threshold, 1e-6f), 0.0f, 1.0f);
+            onset = true;
+        }
+
+        envelope[frame % envelope.size()] = std::max(0.0f, candidate - median);
+        fluxHistory[frame % ThresholdWindow] = candidate;
+        fluxBefore = candidate;
+        fluxPeak = flux;
+        ++frame;
+
+        if (frame % std::max(1, static_cast<int>(fps)) == 0 && frame >= static_cast<long>(envelope.size() / 2)) {
+            const int size = static_cast<int>(envelope.size());
+            const float estimate = estimateTempo(envelope.data(), size, fps, static_cast<int>(frame % size));
+            if (estimate > 0.0f) {
+                // Follow small drifts smoothly, jump straight to a clearly different tempo
+                currentBpm = (currentBpm > 0.0f && std::fabs(estimate - currentBpm) < currentBpm * 0.08f)
+                    ? currentBpm * 0.7f + estimate * 0.3f
+                    : estimate;
+            }
+        }
+        return onset;
+    }
+
+    // 0..1 strength of the most recent onset relative to recent peaks.
+    float strength() const { return currentStrength; }
+    // 0 until enough audio has been seen.
+    float bpm() const { return currentBpm; }
+
+    // Weighted autocorrelation of an onset envelope over the lags between MaxBpm
+    // and MinBpm. A circular envelope passes the index of its oldest value as
+    // start, so the correlation never runs across the seam.
+    //
+    // A beat period rarely falls on a whole hop, so the envelope is smoothed
+    // first: otherwise the true peak splits across two lags and the one at twice
+    // the period, which lands closer to a whole hop, can outscore it. The winner
+    // is then checked against half its lag, and the period refined from the peak
+    // near a multiple of it, where a fraction of a hop is a fraction of a BPM.
+    static float estimateTempo(const float *env, int count, float fps, int start = 0) {
+        const int minLag = std::max(1, static_cast<int>(std::floor(fps * 60.0f / MaxBpm)));
+        const int maxLag = std::min(count - 1, static_cast<int>(std::ceil(fps * 60.0f / MinBpm)));
+        if (maxLag <= minLag + 1) return 0.0f;
+
+        // Binomial [1 4 6 4 1] smoothing, zero mean
+        std::vector<float> smoothed(count);
+        float mean = 0.0f;
+        const auto at = [&](int i) { return env[(start + std::clamp(i, 0, count - 1)) % count]; };
+        for (int i = 0; i < count; ++i) {
+            smoothed[i] = (at(i - 2) + 4.0f * at(i - 1) + 6.0f * at(i) + 4.0f * at(i + 1) + at(i + 2)) / 16.0f;
+            mean += smoothed[i];
+        }
+        mean /= count;
+        for (float &value : smoothed) value -= mean;
+        const auto acf = [&](int lag) {
+            float sum = 0.0f;
+            for (int i = lag; i < count; ++i) sum += smoothed[i] * smoothed[i - lag];
+            return sum / (count - lag);
+        };
+
+        const float preferredLag = fps * 60.0f / 120.0f;
+        float raw[512];
+        const int lags = std::min(maxLag, minLag + 511) - minLag + 1;
+        int best = -1;
+        float bestScore = 0.0f;
+        for (int l = 0; l < lags; ++l) {
+            const int lag = minLag + l;
+            raw[l] = acf(lag);
+            const float octaves = std::log2(lag / preferredLag);
+            const float score = raw[l] * std::exp(-0.5f * octaves * octaves);
+            if (best < 0 || score > bestScore) {
+                best = l;
+                bestScore = score;
+            }
+        }
+        if (best < 0 || bestScore <= 0.0f) return 0.0f;
+
+        // Prefer the faster tempo while it correlates nearly as well
+        while (true) {
+            const int lower = (minLag + best) / 2 - minLag;
+            const int upper = (minLag + best + 1) / 2 - minLag;
+            if (lower < 0) break;
+            const int half = raw[upper] > raw[lower] ? upper : lower;
+            if (half == best || raw[half] < raw[best] * HalfLagRatio) break;
+            best = half;
+        }
+
+        // Refine the period from the peak near the largest multiple of the lag that
+        // still leaves half the envelope to correlate over
+        const int lag = minLag + best;
+        const int multiple = std::clamp(count / 2 / lag, 1, 8);
+        const int centre = lag * multiple;
+        int peak = centre;
+        float peakValue = acf(centre);
+        for (int candidate = std::max(1, centre - multiple); candidate <= std::min(count - 2, centre + multiple); ++candidate) {
+            const float value = acf(candidate);
+            if (value > peakValue) {
+                peak = candidate;
+                peakValue = value;
+            }
+        }
+        float period = static_cast<float>(peak);
+        if (peak > 1 && peak < count - 2) {
+            const float a = acf(peak - 1), b = peakValue, c = acf(peak + 1);
+            const float denominator = a - 2.0f * b + c;
+            if (denominator < 0.0f) period += 0.5f * (a - c) / denominator;
+        }
+        return 60.0f * fps * multiple / period;
+    }
+
+    // Offline pass over a whole decoded mono track, e.g. for library analysis.
+    static TrackAnalysis analyzeTrack(const float *mono, size_t count, int sampleRate,
+                                      int frameSize = 2048, int hopSize = 1024) {
+        TrackAnalysis result;
+        if (sampleRate <= 0 || count < static_cast<size_t>(frameSize)) return result;
+
+        SpectrumKernel kernel(frameSize);
+        std::vector<float> window(frameSize), spectrum(frameSize / 2 + 1);
+        for (int i = 0; i < frameSize; ++i) {
+            window[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (frameSize - 1));
+        }
+
+        const float fps = static_cast<float>(sampleRate) / hopSize;
+        OnsetDetector detector;
+        detector.reset(frameSize / 2 + 1, fps);
+        std::vector<float> envelope;
+        envelope.reserve(count / hopSize + 1);
+        for (size_t start = 0; start + frameSize <= count; start += hopSize) {
+            kernel.magnitudes(mono + start, window.data(), spectrum.data());
+            if (detector.process(spectrum.data(), 4.0f / frameSize)) {
+                // Stamp the onset at the centre of its analysis window
+                const double sample = static_cast<double>(detector.lastOnsetFrame) * hopSize + frameSize / 2;
+                result.onsetSeconds.push_back(sample / sampleRate);
+            }
+            envelope.push_back(detector.envelope[(detector.frame - 1) % detector.envelope.size()]);
+        }
+        result.bpm = estimateTempo(envelope.data(), static_cast<int>(envelope.size()), fps);
+        return result;
+    }
+
+private:
+    static constexpr float Compression = 100.0f;
+    static constexpr float RunningMaxDecay = 0.995f;
+    // Half the winning lag takes over when it correlates at least this well relative to it
+    static constexpr float HalfLagRatio = 0.6f;
+
+    float fps = 0.0f;
+    std::vector<float> previous;
+    std::array<float, ThresholdWindow> fluxHistory{};
+    std::vector<float> envelope;
+    long frame = 0;
+    long lastOnsetFrame = 0;
+    float fluxBefore = 0.0f;
+    float fluxPeak = 0.0f;
+    float runningMax = 0.0f;
+    float currentStrength = 0.0f;
+    float currentBpm = 0.0f;
+};
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QDateTime>
+#include <atomic>
+#include <memory>
+#include "playliststore.h"
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+// Checks playlist paths in the background and remembers what it saw.
+//
+// Entries are grouped by directory and the groups are stat()ed in batches on a
+// private thread pool. A directory whose device/inode/mtime stamp is unchanged
+// since the last pass cannot have gained or lost files, so its entries keep
+// their cached status without touching them again. The cache persists in the
+// app's cache directory, so after a restart only the directories are stat()ed.
+//
+// Statuses start out Unverified and are updated on the GUI thread as batches
+// finish; nothing here ever blocks the caller on the filesystem.
+class PathValidator : public QObject {
+    Q_OBJECT
+public:
+    enum Status : quint8 {
+        Unverified,
+        Ok,
+        Missing
+    };
+
+    explicit PathValidator(QObject *parent = nullptr)
+    : QObject(parent) {
+        // Metadata calls on network mounts are latency bound, so oversubscribe the cores
+        pool.setMaxThreadCount(qMax(4, QThread::idealThreadCount() * 2));
+        cache.cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/pathcache.bin";
+        pool.start([this]() { cache.ensureLoaded(); });
+    }
+
+    ~PathValidator() {
+        ++generation;
+        pool.waitForDone();
+    }
+
+    Status status(qsizetype index) const {
+        return index >= 0 && index < statuses.size() ? static_cast<Status>(statuses[index]) : Unverified;
+    }
+
+    // Marks a path that failed to open, so shuffle stops picking it until the next pass.
+    void markMissing(qsizetype index) {
+        if (index < 0) return;
+        if (index >= statuses.size()) statuses.resize(index + 1, Unverified);
+        statuses[index] = Missing;
+        emit statusesChanged(index, index);
+    }
+
+    // Queues validation of store entries from first to the end. A call with first == 0
+    // supersedes any pass still running.
+    void validate(const PlaylistStore &store, qsizetype first = 0) {
+        const qsizetype count = store.size();
+        if (first == 0) {
+            ++generation;
+            statuses.fill(Unverified);
+        }
+        if (statuses.size() < count) statuses.resize(count, Unverified);
+        if (first >= count) return;
+
+        // Snapshot the paths; the store may keep growing while workers run
+        auto paths = std::make_shared<QStringList>();
+        paths->reserve(count - first);
+        for (qsizetype i = first; i < count; ++i) {
+            paths->append(store.isRemoved(i) ? QString() : store.path(i));
+        }
+
+        // Workers only touch members that outlive them: the destructor waits for the pool
+        const quint64 pass = generation;
+        pool.start([this, paths, first, pass]() {
+            // Stamps checked against an empty cache would all be stat()ed again
+            cache.ensureLoaded();
+            // Group by parent directory on the worker, then fan the groups out in batches
+            QHash<QString, QList<qsizetype>> byDirectory;
+            for (qsizetype i = 0; i < paths->size(); ++i) {
+                if (paths->at(i).isEmpty()) continue;
+                byDirectory[QFileInfo(paths->at(i)).path()].append(first + i);
+            }
+            auto remaining = std::make_shared<std::atomic<int>>(0);
+            QList<QList<QString>> batches;
+            QList<QString> batch;
+            int batchEntries = 0;
+            for (auto it = byDirectory.cbegin(); it != byDirectory.cend(); ++it) {
+                batch.append(it.key());
+                batchEntries += it.value().size();
+                if (batchEntries >= BatchSize) {
+                    batches.append(batch);
+                    batch.clear();
+                    batchEntries = 0;
+                }
+            }
+            if (!batch.isEmpty()) batches.append(batch);
+            if (batches.isEmpty()) return;
+            remaining->store(batches.size());
+
+            auto groups = std::make_shared<QHash<QString, QList<qsizetype>>>(std::move(byDirectory));
+            for (const QList<QString> &directories : std::as_const(batches)) {
+                pool.start([this, paths, groups, directories, first, pass, remaining]() {
+                    QList<qsizetype> indices;
+                    QList<quint8> results;
+                    for (const QString &directory : directories) {
+                        if (generation != pass) break;
+                        cache.checkDirectory(directory, groups->value(directory), *paths, first, indices, results);
+                    }
+                    QMetaObject::invokeMethod(this, [this, indices, results, pass]() {
+                        applyResults(indices, results, pass);
+                    }, Qt::QueuedConnection);
+                    if (remaining->fetch_sub(1) == 1) {
+                        cache.save();
+                        QMetaObject::invokeMethod(this, [this, pass]() {
+                            if (generation == pass) emit passFinished();
+                        }, Qt::QueuedConnection);
+                    }
+                });
+            }
+        });
+    }
+
+signals:
+    void statusesChanged(qsizetype first, qsizetype last);
+    void passFinished();
+
+private:
+    static constexpr int BatchSize = 256;
+
+    struct DirStamp {
+        quint64 device = 0;
+        quint64 inode = 0;
+        qint64 mtimeNs = 0;
+        bool operator==(const DirStamp &other) const = default;
+    };
+
+    struct FileStamp {
+        quint64 inode = 0;
+        qint64 mtimeNs = 0;
+        qint64 size = 0;
+        quint8 status = Unverified;
+    };
+
+    // Stamps shared by all workers
+    struct StampCache {
+        QMutex mutex;
+        QHash<QString, DirStamp> directories;
+        QHash<QString, FileStamp> files;
+        QString cacheFile;
+        bool dirty = false;
+        QMutex loadMutex;
+        bool loaded = false;  // guarded by loadMutex
+
+        // Blocks until the cache file has been read; every worker calls this before its first lookup.
+        void ensureLoaded() {
+            QMutexLocker locker(&loadMutex);
+            if (loaded) return;
+            load();
+            loaded = true;
+        }
+
+        static bool statPath(const QString &path, DirStamp &dir, FileStamp &file) {
+#ifdef Q_OS_UNIX
+            struct stat info;
+            if (::stat(QFile::encodeName(path).constData(), &info) != 0) return false;
+            dir.device = info.st_dev;
+            dir.inode = file.inode = info.st_ino;
+            dir.mtimeNs = file.mtimeNs = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+            file.size = info.st_size;
+            return true;
+#else
+            QFileInfo fileInfo(path);
+            if (!fileInfo.exists()) return false;
+            dir.mtimeNs = file.mtimeNs = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+            file.size = fileInfo.size();
+            return true;
+#endif
+        }
+
+        void checkDirectory(const QString &directory, const QList<qsizetype> &members, const QStringList &paths,
+                            qsizetype first, QList<qsizetype> &indices, QList<quint8> &results) {
+            DirStamp stamp;
+            FileStamp unused;
+            const bool directoryExists = statPath(directory, stamp, unused);
+
+            QList<qsizetype> unknown;
+            {
+                QMutexLocker locker(&mutex);
+                const bool unchanged = directoryExists && directories.value(directory, DirStamp()) == stamp;
+                for (qsizetype index : members) {
+                    const QString &path = paths[index - first];
+                    auto cached = files.constFind(path);
+                    if (!directoryExists) {
+                        indices.append(index);
+                        results.append(Missing);
+                    } else if (unchanged && cached != files.cend() && cached->status != Unverified) {
+                        indices.append(index);
+                        results.append(cached->status);
+                    } else {
+                        unknown.append(index);
+                    }
+                }
+            }
+
+            QList<QPair<QString, FileStamp>> fresh;
+            for (qsizetype index : unknown) {
+                const QString &path = paths[index - first];
+                DirStamp ignored;
+                FileStamp file;
+                file.status = statPath(path, ignored, file) ? Ok : Missing;
+                indices.append(index);
+                results.append(file.status);
+                fresh.append({path, file});
+            }
+
+            QMutexLocker locker(&mutex);
+            for (const auto &entry : std::as_const(fresh)) files.insert(entry.first, entry.second);
+            if (directoryExists) directories.insert(directory, stamp);
+            else directories.remove(directory);
+            dirty = dirty || !fresh.isEmpty() || !directoryExists;
+        }
+
+        void load() {
+            QFile file(cacheFile);
+            if (!file.open(QIODevice::ReadOnly)) return;
+            QDataStream in(&file);
+            quint32 version = 0;
+            in >> version;
+            if (version != CacheVersion) return;
+            qint64 directoryCount = 0, fileCount = 0;
+            QMutexLocker locker(&mutex);
+            in >> directoryCount;
+            for (qint64 i = 0; i < directoryCount && in.status() == QDataStream::Ok; ++i) {
+                QString path;
+                DirStamp stamp;
+                in >> path >> stamp.device >> stamp.inode >> stamp.mtimeNs;
+                // Anything stat()ed since startup is newer than the file
+                if (!directories.contains(path)) directories.insert(path, stamp);
+            }
+            in >> fileCount;
+            for (qint64 i = 0; i < fileCount && in.status() == QDataStream::Ok; ++i) {
+                QString path;
+                FileStamp stamp;
+                in >> path >> stamp.inode >> stamp.mtimeNs >> stamp.size >> stamp.status;
+                if (!files.contains(path)) files.insert(path, stamp);
+            }
+        }
+
+        void save() {
+            QMutexLocker locker(&mutex);
+            if (!dirty) return;
+            QDir().mkpath(QFileInfo(cacheFile).path());
+            QSaveFile file(cacheFile);
+            if (!file.open(QIODevice::WriteOnly)) return;
+            QDataStream out(&file);
+            out << CacheVersion << qint64(directories.size());
+            for (auto it = directories.cbegin(); it != directories.cend(); ++it) {
+                out << it.key() << it->device << it->inode << it->mtimeNs;
+            }
+            out << qint64(files.size());
+            for (auto it = files.cbegin(); it != files.cend(); ++it) {
+                out << it.key() << it->inode << it->mtimeNs << it->size << it->status;
+            }
+            if (file.commit()) dirty = false;
+        }
+    };
+
+    static constexpr quint32 CacheVersion = 1;
+
+    void applyResults(const QList<qsizetype> &indices, const QList<quint8> &results, quint64 pass) {
+        if (pass != generation || indices.isEmpty()) return;
+        qsizetype low = indices.first(), high = indices.first();
+        for (qsizetype i = 0; i < indices.size(); ++i) {
+            if (indices[i] >= statuses.size()) statuses.resize(indices[i] + 1, Unverified);
+            statuses[indices[i]] = results[i];
+            low = qMin(low, indices[i]);
+            high = qMax(high, indices[i]);
+        }
+        emit statusesChanged(low, high);
+    }
+
+    StampCache cache;
+    std::atomic<quint64> generation{0};
+    QList<quint8> statuses;
+    // Declared last so it is destroyed first, after waiting for every worker
+    QThreadPool pool;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QObject>
+#include <QUrl>
+#include <QString>
+#include <QMediaPlayer>
+#include <functional>
+
+class SpectrumAnalyzer;
+
+// What MediaControlWidget needs from a player: the QMediaPlayer calls and
+// signals it already used, plus a primed next track for gapless changes.
+//
+// setNextSource() hands the engine the track to play after the current one.
+// The engine opens and prerolls it in the background; when the current track
+// ends it switches over itself and emits trackAdvanced() instead of
+// EndOfMedia. Without a primed next track, EndOfMedia is reported as before.
+class PlaybackEngine : public QObject {
+    Q_OBJECT
+public:
+    // Silence between the end of one track and audio from the next, by kind of change
+    struct TransitionStats {
+        quint64 gapless;
+        quint64 cold;
+        qint64 lastGapUs;
+        qint64 maxGaplessGapUs;
+        qint64 maxColdGapUs;
+    };
+
+    explicit PlaybackEngine(QObject *parent = nullptr) : QObject(parent) {}
+
+    virtual void setSource(const QUrl &source) = 0;
+    virtual QUrl source() const = 0;
+    virtual void setNextSource(const QUrl &source) = 0;
+    virtual QUrl nextSource() const = 0;
+    virtual void play() = 0;
+    virtual void pause() = 0;
+    virtual void stop() = 0;
+    virtual void setPosition(qint64 position) = 0;
+    virtual qint64 position() const = 0;
+    virtual qint64 duration() const = 0;
+    virtual QMediaPlayer::PlaybackState playbackState() const = 0;
+    // Feeds the PCM of whatever is playing to analyzer; nullptr detaches the tap.
+    virtual void setAnalyzer(SpectrumAnalyzer *analyzer) = 0;
+    // Overlaps the end of a track with the primed next one under equal-power gains; 0 is a hard cut.
+    virtual void setCrossfade(int ms) = 0;
+
+    TransitionStats transitionStats() const { return stats; }
+
+    // Linear gain for a track, asked for whenever a source or next source is set. Engines
+    // apply it for as long as that track plays; without a lookup every track plays at unity.
+    void setGainLookup(std::function<float(const QUrl &)> lookup) { gainLookup = std::move(lookup); }
+
+signals:
+    void mediaStatusChanged(QMediaPlayer::MediaStatus status);
+    void playbackStateChanged(QMediaPlayer::PlaybackState state);
+    void positionChanged(qint64 position);
+    void errorOccurred(QMediaPlayer::Error error, const QString &errorString);
+    // The primed next track took over; source() now returns it.
+    void trackAdvanced(const QUrl &source);
+    // The last setPosition() has taken effect in the backend
+    void seekFinished();
+
+protected:
+    float trackGain(const QUrl &source) const { return gainLookup && !source.isEmpty() ? gainLookup(source) : 1.0f; }
+
+    void recordGap(bool gapless, qint64 gapUs) {
+        if (gapless) {
+            ++stats.gapless;
+            stats.maxGaplessGapUs = qMax(stats.maxGaplessGapUs, gapUs);
+        } else {
+            ++stats.cold;
+            stats.maxColdGapUs = qMax(stats.maxColdGapUs, gapUs);
+        }
+        stats.lastGapUs = gapUs;
+    }
+
+    TransitionStats stats{};
+    std::function<float(const QUrl &)> gainLookup;
+};
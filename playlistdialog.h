@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QDialog>
+#include <QListView>
+#include <QVBoxLayout>
+#include <QDialogButtonBox>
+#include <QLabel>
+#include <QLineEdit>
+#include <QThreadPool>
+#include <atomic>
+#include "playliststore.h"
+#include "pathvalidator.h"
+#include "tagcache.h"
+#include "searchindex.h"
+#include "playlistmodel.h"
+
+// Song picker over the playlist store. The list is a view on PlaylistModel, so
+// only the rows on screen are ever read, named and styled, and their status
+// and name follow the validator and tag reader as they report back; opening
+// the picker never waits on the filesystem or on the size of the playlist.
+// Typing in the search box replaces the rows with the best matches from the
+// search index. A common word can take tens of milliseconds to rank, so each
+// keystroke's query runs on a private thread and only the latest one's result
+// is shown.
+class PlaylistDialog : public QDialog {
+    Q_OBJECT
+public:
+    PlaylistDialog(const PlaylistStore &store, PathValidator *validator, const TagCache *tags, const SearchIndex *search,
+                   QWidget *parent = nullptr)
+    : QDialog(parent), validator(validator), search(search) {
+        queries.setMaxThreadCount(1);
+        setWindowTitle("Load Playlist");
+        QVBoxLayout *layout = new QVBoxLayout(this);
+        layout->addWidget(new QLabel("Select a song:", this));
+        filter = new QLineEdit(this);
+        filter->setPlaceholderText("Search title, artist, album or file name");
+        filter->setClearButtonEnabled(true);
+        layout->addWidget(filter);
+        model = new PlaylistModel(store, validator, tags, this);
+        list = new QListView(this);
+        // Without uniform sizes the view would measure every row up front
+        list->setUniformItemSizes(true);
+        list->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        list->setModel(model);
+        layout->addWidget(list);
+        QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel, this);
+        connect(buttons, &QDialogButtonBox::accepted, this, &QDialog::accept);
+        connect(buttons, &QDialogButtonBox::rejected, this, &QDialog::reject);
+        connect(list, &QListView::doubleClicked, this, &QDialog::accept);
+        layout->addWidget(buttons);
+        // Enter in the search box goes to the default button and so picks the best match
+        connect(filter, &QLineEdit::textChanged, this, &PlaylistDialog::applyFilter);
+
+        empty = model->rowCount() == 0;
+        selectFirst();
+        resize(480, 360);
+    }
+
+    ~PlaylistDialog() {
+        ++queryGeneration;
+        queries.clear();
+        queries.waitForDone();
+    }
+
+    // Whether the playlist had nothing to list when the dialog opened
+    bool isEmpty() const { return empty; }
+
+    // The store lost entries while the dialog is open: the rows are reset and the selection
+    // stays on the same entry if it is still there.
+    void storeChanged() {
+        const QModelIndex current = list->currentIndex();
+        const qsizetype entry = current.isValid() ? model->entryAt(current.row()) : -1;
+        model->storeChanged();
+        const int row = entry >= 0 ? model->rowOf(entry) : -1;
+        if (row >= 0) list->setCurrentIndex(model->index(row));
+        else selectFirst();
+    }
+
+    QString selectedPath() const {
+        const QModelIndex current = list->currentIndex();
+        if (!current.isValid()) return QString();
+        if (validator->status(current.data(PlaylistModel::EntryRole).toLongLong()) == PathValidator::Missing) return QString();
+        return current.data(PlaylistModel::PathRole).toString();
+    }
+
+private slots:
+    void applyFilter(const QString &text) {
+        const quint64 query = ++queryGeneration;
+        queries.clear();
+        if (text.trimmed().isEmpty()) {
+            model->showAll();
+            selectFirst();
+            return;
+        }
+        queries.start([this, text, query]() {
+            if (query != queryGeneration) return;
+            const QList<qsizetype> found = search->search(text);
+            QMetaObject::invokeMethod(this, [this, found, query]() {
+                if (query != queryGeneration) return;
+                model->setEntries(found);
+                selectFirst();
+            }, Qt::QueuedConnection);
+        });
+    }
+
+private:
+    void selectFirst() {
+        if (model->rowCount() > 0) list->setCurrentIndex(model->index(0));
+    }
+
+    PathValidator *validator;
+    const SearchIndex *search;
+    PlaylistModel *model;
+    QLineEdit *filter;
+    QListView *list;
+    bool empty = false;
+    std::atomic<quint64> queryGeneration{0};
+    QThreadPool queries;
+};
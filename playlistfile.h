@@ -0,0 +1,287 @@
+#pragma once
+
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QUrl>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QElapsedTimer>
+#include <QXmlStreamReader>
+#include <QXmlStreamWriter>
+#include <cstring>
+#include "playliststore.h"
+#include "tagcache.h"
+
+// Imports playlist files into a PlaylistStore and exports the store as one.
+//
+// Formats are plain one-path-per-line lists, M3U/M3U8 (with #EXTINF), PLS
+// and XSPF, chosen by extension and, for imports, by sniffing the first
+// bytes. Line formats are read through a memory map (falling back to
+// buffered line reads for files that cannot be mapped) and XSPF through
+// QXmlStreamReader, so only the current line or element is ever decoded.
+// Entries are resolved against the playlist's own folder, non-file URLs are
+// skipped, and new paths go into the store in batches, which keeps a large
+// import in constant memory. Exports stream the store straight to disk with
+// names and durations from the tag cache.
+class PlaylistFile {
+public:
+    enum Format {
+        PlainText,
+        M3u,
+        Pls,
+        Xspf
+    };
+
+    struct ImportStats {
+        qint64 entries = 0;  // paths found in the file
+        qint64 added = 0;
+        qint64 skipped = 0;  // already in the store, repeated or not a local file
+        qint64 bytes = 0;
+        qint64 elapsedMs = 0;
+    };
+
+    explicit PlaylistFile(PlaylistStore &store) : store(store) {}
+
+    QString errorString() const { return error; }
+    ImportStats importStats() const { return stats; }
+
+    static Format formatFor(const QString &fileName, QByteArrayView head = QByteArrayView()) {
+        const QString suffix = QFileInfo(fileName).suffix().toLower();
+        if (suffix == "m3u" || suffix == "m3u8") return M3u;
+        if (suffix == "pls") return Pls;
+        if (suffix == "xspf") return Xspf;
+        if (head.startsWith("\xef\xbb\xbf")) head = head.sliced(3);
+        if (head.startsWith("#EXTM3U")) return M3u;
+        if (head.startsWith("[playlist]")) return Pls;
+        if (head.startsWith("<?xml") || head.startsWith("<playlist")) return Xspf;
+        return PlainText;
+    }
+
+    // Adds every local file the playlist names that the store does not hold yet.
+    // Returns the number of entries added, or -1 if the file can't be read or the store written.
+    int importFile(const QString &fileName) {
+        stats = ImportStats();
+        QElapsedTimer timer;
+        timer.start();
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            error = file.errorString();
+            return -1;
+        }
+        stats.bytes = file.size();
+        baseDir = QFileInfo(fileName).absoluteDir();
+        const Format format = formatFor(fileName, file.peek(16));
+        // .m3u predates M3U8 and is often in a legacy code page; everything else is UTF-8
+        const bool strictUtf8 = format != M3u || QFileInfo(fileName).suffix().toLower() != "m3u";
+        bool ok;
+        if (format == Xspf) {
+            ok = readXspf(file);
+        } else {
+            ok = forEachLine(file, [&](QByteArrayView line) {
+                if (format == Pls) {
+                    // FileN=path; titles, lengths and the header are not needed to import
+                    const qsizetype equals = line.indexOf('=');
+                    if (equals < 5 || line.first(4).compare("file", Qt::CaseInsensitive) != 0) return true;
+                    for (char c : line.sliced(4, equals - 4)) {
+                        if (c < '0' || c > '9') return true;
+                    }
+                    line = line.sliced(equals + 1).trimmed();
+                } else if (line.startsWith('#')) {
+                    return true;
+                }
+                if (line.isEmpty()) return true;
+                const QString text = strictUtf8 || line.isValidUtf8() ? QString::fromUtf8(line) : QString::fromLatin1(line);
+                return add(resolve(text));
+            });
+        }
+        ok = ok && flush();
+        stats.elapsedMs = timer.elapsed();
+        return ok ? static_cast<int>(stats.added) : -1;
+    }
+
+    // Writes the store's live entries to fileName in the format its extension names.
+    bool exportFile(const QString &fileName, const TagCache *tags) {
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) {
+            error = file.errorString();
+            return false;
+        }
+        const Format format = formatFor(fileName);
+        if (format == Xspf) {
+            writeXspf(file, tags);
+        } else {
+            if (format == M3u) file.write("#EXTM3U\n");
+            if (format == Pls) file.write("[playlist]\n");
+            qint64 number = 0;
+            for (qsizetype i = 0; i < store.size(); ++i) {
+                if (store.isRemoved(i)) continue;
+                const QByteArrayView path = store.pathBytes(i);
+                if (format == PlainText) {
+                    file.write(path.data(), path.size());
+                    file.write("\n", 1);
+                    continue;
+                }
+                const QString localPath = QString::fromUtf8(path);
+                const TrackTags trackTags = tags->tags(localPath);
+                const QByteArray title = tags->displayName(localPath).toUtf8();
+                const QByteArray seconds = QByteArray::number(trackTags.durationMs > 0 ? (trackTags.durationMs + 500) / 1000 : -1);
+                if (format == M3u) {
+                    file.write("#EXTINF:" + seconds + ',' + title + '\n');
+                    file.write(path.data(), path.size());
+                    file.write("\n", 1);
+                } else {
+                    const QByteArray n = QByteArray::number(++number);
+                    file.write("File" + n + '=');
+                    file.write(path.data(), path.size());
+                    file.write("\nTitle" + n + '=' + title + "\nLength" + n + '=' + seconds + '\n');
+                }
+            }
+            if (format == Pls) file.write("NumberOfEntries=" + QByteArray::number(number) + "\nVersion=2\n");
+        }
+        if (!file.commit()) {
+            error = file.errorString();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr int BatchSize = 4096;
+
+    // Calls visit with every line, without its line break and surrounding blanks, until it returns false.
+    template <typename Visit>
+    bool forEachLine(QFile &file, Visit visit) {
+        const qint64 size = file.size();
+        uchar *mapped = size > 0 ? file.map(0, size) : nullptr;
+        if (!mapped) {
+            while (!file.atEnd()) {
+                const QByteArray line = file.readLine();
+                if (!visit(QByteArrayView(line).trimmed())) return false;
+            }
+            return true;
+        }
+        const char *at = reinterpret_cast<const char *>(mapped);
+        const char *end = at + size;
+        if (size >= 3 && std::memcmp(at, "\xef\xbb\xbf", 3) == 0) at += 3;
+        bool ok = true;
+        while (ok && at < end) {
+            const char *lineEnd = static_cast<const char *>(std::memchr(at, '\n', end - at));
+            if (!lineEnd) lineEnd = end;
+            ok = visit(QByteArrayView(at, lineEnd - at).trimmed());
+            at = lineEnd + 1;
+        }
+        file.unmap(mapped);
+        return ok;
+    }
+
+    // Only the first location of each track counts; the rest are alternatives for the same track.
+    bool readXspf(QFile &file) {
+        const QUrl base = QUrl::fromLocalFile(baseDir.absolutePath() + '/');
+        QXmlStreamReader xml(&file);
+        bool located = false;
+        while (!xml.atEnd()) {
+            xml.readNext();
+            if (xml.isStartElement() && xml.name() == QLatin1String("track")) {
+                located = false;
+            } else if (xml.isStartElement() && xml.name() == QLatin1String("location") && !located) {
+                located = true;
+                const QUrl location = base.resolved(QUrl(xml.readElementText().trimmed()));
+                ++stats.entries;
+                if (!location.isLocalFile()) {
+                    ++stats.skipped;
+                    continue;
+                }
+                if (!addPath(QDir::cleanPath(location.toLocalFile()))) return false;
+            }
+        }
+        if (xml.hasError() && xml.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+            error = QString("%1 at line %2").arg(xml.errorString()).arg(xml.lineNumber());
+            return false;
+        }
+        return true;
+    }
+
+    void writeXspf(QSaveFile &file, const TagCache *tags) {
+        QXmlStreamWriter xml(&file);
+        xml.setAutoFormatting(true);
+        xml.writeStartDocument();
+        xml.writeStartElement("playlist");
+        xml.writeAttribute("version", "1");
+        xml.writeDefaultNamespace("http://xspf.org/ns/0/");
+        xml.writeStartElement("trackList");
+        for (qsizetype i = 0; i < store.size(); ++i) {
+            if (store.isRemoved(i)) continue;
+            const QString path = store.path(i);
+            const TrackTags trackTags = tags->tags(path);
+            xml.writeStartElement("track");
+            xml.writeTextElement("location", QString::fromLatin1(QUrl::fromLocalFile(path).toEncoded()));
+            if (!trackTags.title.isEmpty()) xml.writeTextElement("title", trackTags.title);
+            if (!trackTags.artist.isEmpty()) xml.writeTextElement("creator", trackTags.artist);
+            if (!trackTags.album.isEmpty()) xml.writeTextElement("album", trackTags.album);
+            if (trackTags.durationMs > 0) xml.writeTextElement("duration", QString::number(trackTags.durationMs));
+            xml.writeEndElement();
+        }
+        xml.writeEndElement();
+        xml.writeEndElement();
+        xml.writeEndDocument();
+    }
+
+    // An entry as a local path: file URLs are converted, other URLs dropped, and relative paths
+    // taken from the playlist's folder. Lists written on Windows use backslashes throughout.
+    QString resolve(QString entry) const {
+        const qsizetype scheme = entry.indexOf(QLatin1String("://"));
+        if (scheme > 1) {
+            bool isUrl = true;
+            for (qsizetype i = 0; i < scheme && isUrl; ++i) isUrl = entry[i].isLetterOrNumber() || entry[i] == '+' || entry[i] == '-' || entry[i] == '.';
+            if (isUrl) {
+                const QUrl url(entry);
+                return url.isLocalFile() ? QDir::cleanPath(url.toLocalFile()) : QString();
+            }
+        }
+        if (entry.contains('\\') && !entry.contains('/')) entry.replace('\\', '/');
+        return QDir::cleanPath(baseDir.absoluteFilePath(entry));
+    }
+
+    bool add(const QString &path) {
+        ++stats.entries;
+        if (path.isEmpty()) {
+            ++stats.skipped;
+            return true;
+        }
+        return addPath(path);
+    }
+
+    bool addPath(const QString &path) {
+        if (store.contains(path) || pending.contains(path)) {
+            ++stats.skipped;
+            return true;
+        }
+        batch.append(path);
+        pending.insert(path);
+        return batch.size() < BatchSize || flush();
+    }
+
+    bool flush() {
+        if (batch.isEmpty()) return true;
+        if (store.appendBatch(batch) < 0) {
+            error = store.errorString();
+            return false;
+        }
+        stats.added += batch.size();
+        batch.clear();
+        pending.clear();
+        return true;
+    }
+
+    PlaylistStore &store;
+    QDir baseDir;
+    QStringList batch;
+    QSet<QString> pending;  // paths of the batch not yet in the store
+    ImportStats stats;
+    QString error;
+};
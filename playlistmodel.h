@@ -0,0 +1,129 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QFont>
+#include <QBrush>
+#include <QColor>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include "playliststore.h"
+#include "pathvalidator.h"
+#include "tagcache.h"
+
+// Rows of the song picker, read straight from the playlist store.
+//
+// Nothing is copied per entry: a row is mapped to its store entry when the
+// view asks for it (PlaylistStore::liveIndex()), and its name, status and
+// tooltip are looked up then. With uniform item sizes the view only asks for
+// the rows it draws, so opening and scrolling cost the same for 10k entries as
+// for a million. Name and status changes repaint the visible rows instead of
+// being applied per entry. setEntries() swaps in an explicit list, such as
+// search results, and showAll() goes back to the whole store. The row count
+// only changes on a reset, so whoever removes entries from the store while a
+// view is open calls storeChanged().
+class PlaylistModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    static constexpr int EntryRole = Qt::UserRole;
+    static constexpr int PathRole = Qt::UserRole + 1;
+
+    PlaylistModel(const PlaylistStore &store, PathValidator *validator, const TagCache *tags, QObject *parent = nullptr)
+    : QAbstractListModel(parent), store(store), validator(validator), tags(tags), liveRows(store.liveCount()) {
+        connect(validator, &PathValidator::statusesChanged, this, &PlaylistModel::refresh);
+        connect(tags, &TagCache::tagsRead, this, &PlaylistModel::refresh);
+    }
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override {
+        if (parent.isValid()) return 0;
+        return static_cast<int>(filtered ? entries.size() : liveRows);
+    }
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override {
+        if (!index.isValid() || index.row() >= rowCount()) return QVariant();
+        const qsizetype entry = entryAt(index.row());
+        if (entry >= store.size()) return QVariant();
+        switch (role) {
+        case Qt::DisplayRole:
+            return tags->displayName(store.path(entry));
+        case EntryRole:
+            return entry;
+        case PathRole:
+            return store.path(entry);
+        case Qt::FontRole: {
+            const PathValidator::Status status = validator->status(entry);
+            if (status == PathValidator::Ok) return QVariant();
+            QFont font;
+            font.setItalic(status == PathValidator::Unverified);
+            font.setStrikeOut(status == PathValidator::Missing);
+            return font;
+        }
+        case Qt::ForegroundRole:
+            switch (validator->status(entry)) {
+            case PathValidator::Ok: return QVariant();
+            case PathValidator::Missing: return QBrush(QColor(200, 80, 80));
+            default: return QBrush(QColor(128, 128, 128));
+            }
+        case Qt::ToolTipRole:
+            switch (validator->status(entry)) {
+            case PathValidator::Ok: return store.path(entry);
+            case PathValidator::Missing: return QStringLiteral("File not found");
+            default: return QStringLiteral("Checking...");
+            }
+        default:
+            return QVariant();
+        }
+    }
+
+    // Store entry shown in row
+    qsizetype entryAt(int row) const { return filtered ? entries[row] : store.liveIndex(row); }
+
+    void setEntries(const QList<qsizetype> &shown) {
+        beginResetModel();
+        entries.clear();
+        entries.reserve(shown.size());
+        for (qsizetype entry : shown) {
+            if (entry < store.size() && !store.isRemoved(entry)) entries.append(entry);
+        }
+        filtered = true;
+        endResetModel();
+    }
+
+    void showAll() {
+        beginResetModel();
+        entries.clear();
+        filtered = false;
+        liveRows = store.liveCount();
+        endResetModel();
+    }
+
+    // Resets the rows against the store after entries were removed; a filtered list keeps
+    // the entries that are still live.
+    void storeChanged() {
+        if (filtered) setEntries(QList<qsizetype>(entries));
+        else showAll();
+    }
+
+    // Row showing entry, or -1
+    int rowOf(qsizetype entry) const {
+        const qsizetype row = filtered ? entries.indexOf(entry) : store.liveRow(entry);
+        return row >= 0 && row < rowCount() ? static_cast<int>(row) : -1;
+    }
+
+private slots:
+    // Whatever changed, only the rows on screen are repainted, and those re-read their data
+    void refresh() {
+        const int rows = rowCount();
+        if (rows > 0) emit dataChanged(index(0), index(rows - 1));
+    }
+
+private:
+    const PlaylistStore &store;
+    PathValidator *validator;
+    const TagCache *tags;
+    // The row count is taken when rows are reset, so entries the library watcher adds or
+    // removes meanwhile never leave the view with rows it was not told about
+    qsizetype liveRows;
+    QList<qsizetype> entries;
+    bool filtered = false;
+};
@@ -0,0 +1,345 @@
+#pragma once
+
+#include <QFile>
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+// Persistent playlist kept as two append-only files:
+//   <base>.dat  16-byte header, then the UTF-8 bytes of every path back to back
+//   <base>.idx  16-byte header, then one 16-byte entry per track:
+//               quint64 data offset, quint32 byte length, quint32 flags
+// Both files are memory-mapped on open. Entries appended afterwards are
+// written through to disk and also kept in a small in-memory tail, so random
+// access, append and path lookup are all O(1) and nothing is reparsed.
+class PlaylistStore {
+public:
+    enum EntryFlag : quint32 {
+        Removed = 0x1
+    };
+
+    PlaylistStore() = default;
+    ~PlaylistStore() { close(); }
+    PlaylistStore(const PlaylistStore &) = delete;
+    PlaylistStore &operator=(const PlaylistStore &) = delete;
+
+    bool open(const QString &basePath) {
+        close();
+        dataFile.setFileName(basePath + ".dat");
+        indexFile.setFileName(basePath + ".idx");
+        if (!openFile(dataFile, DataMagic) || !openFile(indexFile, IndexMagic)) {
+            close();
+            return false;
+        }
+
+        dataSize = dataFile.size();
+        qint64 indexBytes = indexFile.size() - HeaderSize;
+        // A crash between the data and index writes leaves at most a partial trailing entry
+        mappedCount = indexBytes / EntrySize;
+        mappedData = dataSize > HeaderSize ? dataFile.map(0, dataSize) : nullptr;
+        mappedIndex = mappedCount > 0 ? indexFile.map(HeaderSize, mappedCount * EntrySize) : nullptr;
+        if ((dataSize > HeaderSize && !mappedData) || (mappedCount > 0 && !mappedIndex)) {
+            error = QString("Could not map playlist: %1").arg(indexFile.errorString());
+            close();
+            return false;
+        }
+        // Drop trailing entries that point past the data actually written
+        while (mappedCount > 0) {
+            Entry last = mappedEntry(mappedCount - 1);
+            if (last.offset + last.length <= static_cast<quint64>(dataSize)) break;
+            --mappedCount;
+        }
+        indexFile.resize(HeaderSize + mappedCount * EntrySize);
+        mappedDataSize = dataSize;
+        return true;
+    }
+
+    void close() {
+        if (mappedData) dataFile.unmap(mappedData);
+        if (mappedIndex) indexFile.unmap(mappedIndex);
+        mappedData = mappedIndex = nullptr;
+        mappedCount = 0;
+        mappedDataSize = dataSize = 0;
+        tail.clear();
+        tailData.clear();
+        lookup.clear();
+        lookupBuilt = false;
+        removed.clear();
+        removedBuilt = false;
+        dataFile.close();
+        indexFile.close();
+    }
+
+    bool isOpen() const { return dataFile.isOpen() && indexFile.isOpen(); }
+    QString errorString() const { return error; }
+
+    // Number of entries, removed ones included, so indices stay stable.
+    qsizetype size() const { return mappedCount + tail.size(); }
+
+    QByteArrayView pathBytes(qsizetype index) const {
+        const Entry entry = entryAt(index);
+        if (entry.offset < static_cast<quint64>(mappedDataSize)) {
+            return QByteArrayView(reinterpret_cast<const char *>(mappedData) + entry.offset, entry.length);
+        }
+        return QByteArrayView(tailData.constData() + (entry.offset - mappedDataSize), entry.length);
+    }
+
+    QString path(qsizetype index) const { return QString::fromUtf8(pathBytes(index)); }
+
+    bool isRemoved(qsizetype index) const { return entryAt(index).flags & Removed; }
+
+    // Live entries are numbered by rows that skip the removed ones, so a view can show the
+    // store without copying it. Both directions are a binary search over the removed indices.
+    qsizetype liveCount() const {
+        if (!removedBuilt) buildRemoved();
+        return size() - removed.size();
+    }
+
+    // Index of the row-th live entry.
+    qsizetype liveIndex(qsizetype row) const {
+        if (!removedBuilt) buildRemoved();
+        // removed[j] - j live entries come before removed[j], a non-decreasing sequence
+        qsizetype low = 0, high = removed.size();
+        while (low < high) {
+            const qsizetype middle = (low + high) / 2;
+            if (removed[middle] - middle <= row) low = middle + 1;
+            else high = middle;
+        }
+        return row + low;
+    }
+
+    // Row of a live entry, or -1 for a removed one.
+    qsizetype liveRow(qsizetype index) const {
+        if (!removedBuilt) buildRemoved();
+        const auto before = std::lower_bound(removed.cbegin(), removed.cend(), index);
+        if (before != removed.cend() && *before == index) return -1;
+        return index - (before - removed.cbegin());
+    }
+
+    // First live entry with this path, or -1.
+    qsizetype indexOf(const QString &path) const {
+        if (!lookupBuilt) buildLookup();
+        return lookup.value(path, -1);
+    }
+
+    bool contains(const QString &path) const { return indexOf(path) >= 0; }
+
+    // Returns the new entry's index, or -1 on a write error.
+    qsizetype append(const QString &path) {
+        return appendBatch(QStringList{path});
+    }
+
+    // One write per file for the whole batch. Returns the index of the first new entry, or -1.
+    qsizetype appendBatch(const QStringList &paths) {
+        if (!isOpen() || paths.isEmpty()) return -1;
+        QByteArray data;
+        QByteArray index;
+        QList<Entry> entries;
+        entries.reserve(paths.size());
+        index.reserve(paths.size() * EntrySize);
+        quint64 offset = dataSize;
+        for (const QString &path : paths) {
+            const QByteArray utf8 = path.toUtf8();
+            Entry entry{offset, static_cast<quint32>(utf8.size()), 0};
+            data += utf8;
+            appendEntry(index, entry);
+            entries.append(entry);
+            offset += utf8.size();
+        }
+
+        // Data first: an index entry must never point at bytes that are not on disk yet
+        if (!dataFile.seek(dataSize) || dataFile.write(data) != data.size() || !dataFile.flush()) {
+            error = dataFile.errorString();
+            return -1;
+        }
+        const qint64 indexEnd = HeaderSize + size() * EntrySize;
+        if (!indexFile.seek(indexEnd) || indexFile.write(index) != index.size() || !indexFile.flush()) {
+            error = indexFile.errorString();
+            indexFile.resize(indexEnd);
+            return -1;
+        }
+
+        const qsizetype first = size();
+        dataSize = offset;
+        tailData += data;
+        tail += entries;
+        if (lookupBuilt) {
+            for (qsizetype i = 0; i < paths.size(); ++i) {
+                if (!lookup.contains(paths[i])) lookup.insert(paths[i], first + i);
+            }
+        }
+        return first;
+    }
+
+    // Flags entries as removed in place; indices of the other entries don't move.
+    // Returns the number of entries newly removed, or -1 on a write error.
+    int removeBatch(const QList<qsizetype> &indices) {
+        if (!isOpen()) return -1;
+        int count = 0;
+        for (qsizetype index : indices) {
+            if (index < 0 || index >= size()) continue;
+            Entry entry = entryAt(index);
+            if (entry.flags & Removed) continue;
+            entry.flags |= Removed;
+            char raw[4];
+            qToLittleEndian<quint32>(entry.flags, raw);
+            // The mapping shares the page cache, so mapped entries see this write too
+            if (!indexFile.seek(HeaderSize + index * EntrySize + 12) || indexFile.write(raw, 4) != 4) {
+                error = indexFile.errorString();
+                return -1;
+            }
+            if (index >= mappedCount) tail[index - mappedCount] = entry;
+            if (lookupBuilt) {
+                const QString key = path(index);
+                if (lookup.value(key, -1) == index) lookup.remove(key);
+            }
+            if (removedBuilt) removed.insert(std::lower_bound(removed.begin(), removed.end(), index), index);
+            ++count;
+        }
+        if (!indexFile.flush()) {
+            error = indexFile.errorString();
+            return -1;
+        }
+        return count;
+    }
+
+    // Imports a plain one-path-per-line list such as musiclist.txt, skipping paths already stored.
+    // Returns the number of entries added, or -1 if the file can't be read.
+    int importTextFile(const QString &fileName) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            error = file.errorString();
+            return -1;
+        }
+        int added = 0;
+        QStringList batch;
+        QSet<QString> pending;
+        while (!file.atEnd()) {
+            const QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (line.isEmpty() || contains(line) || pending.contains(line)) continue;
+            batch << line;
+            pending.insert(line);
+            if (batch.size() >= ImportBatchSize) {
+                if (appendBatch(batch) < 0) return -1;
+                added += batch.size();
+                batch.clear();
+                pending.clear();
+            }
+        }
+        if (!batch.isEmpty()) {
+            if (appendBatch(batch) < 0) return -1;
+            added += batch.size();
+        }
+        return added;
+    }
+
+    bool exportTextFile(const QString &fileName) const {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            error = file.errorString();
+            return false;
+        }
+        for (qsizetype i = 0; i < size(); ++i) {
+            if (isRemoved(i)) continue;
+            const QByteArrayView bytes = pathBytes(i);
+            file.write(bytes.data(), bytes.size());
+            file.write("\n", 1);
+        }
+        return file.flush();
+    }
+
+private:
+    struct Entry {
+        quint64 offset;
+        quint32 length;
+        quint32 flags;
+    };
+
+    static constexpr qint64 HeaderSize = 16;
+    static constexpr qint64 EntrySize = 16;
+    static constexpr quint32 FormatVersion = 1;
+    static constexpr int ImportBatchSize = 4096;
+    static constexpr char DataMagic[9] = "APXPLDAT";
+    static constexpr char IndexMagic[9] = "APXPLIDX";
+
+    bool openFile(QFile &file, const char *magic) {
+        if (!file.open(QIODevice::ReadWrite)) {
+            error = QString("Could not open %1: %2").arg(file.fileName(), file.errorString());
+            return false;
+        }
+        char header[HeaderSize] = {};
+        if (file.size() == 0) {
+            std::memcpy(header, magic, 8);
+            qToLittleEndian<quint32>(FormatVersion, header + 8);
+            if (file.write(header, HeaderSize) != HeaderSize || !file.flush()) {
+                error = file.errorString();
+                return false;
+            }
+            return true;
+        }
+        if (file.read(header, HeaderSize) != HeaderSize || std::memcmp(header, magic, 8) != 0
+            || qFromLittleEndian<quint32>(header + 8) != FormatVersion) {
+            error = QString("%1 is not a playlist store").arg(file.fileName());
+            return false;
+        }
+        return true;
+    }
+
+    Entry mappedEntry(qsizetype index) const {
+        const uchar *raw = mappedIndex + index * EntrySize;
+        return {qFromLittleEndian<quint64>(raw), qFromLittleEndian<quint32>(raw + 8), qFromLittleEndian<quint32>(raw + 12)};
+    }
+
+    Entry entryAt(qsizetype index) const {
+        return index < mappedCount ? mappedEntry(index) : tail[index - mappedCount];
+    }
+
+    static void appendEntry(QByteArray &out, const Entry &entry) {
+        char raw[EntrySize];
+        qToLittleEndian<quint64>(entry.offset, raw);
+        qToLittleEndian<quint32>(entry.length, raw + 8);
+        qToLittleEndian<quint32>(entry.flags, raw + 12);
+        out.append(raw, EntrySize);
+    }
+
+    void buildLookup() const {
+        lookup.reserve(size());
+        for (qsizetype i = 0; i < size(); ++i) {
+            if (isRemoved(i)) continue;
+            const QString key = path(i);
+            if (!lookup.contains(key)) lookup.insert(key, i);
+        }
+        lookupBuilt = true;
+    }
+
+    void buildRemoved() const {
+        removed.clear();
+        for (qsizetype i = 0; i < size(); ++i) {
+            if (isRemoved(i)) removed.append(i);
+        }
+        removedBuilt = true;
+    }
+
+    QFile dataFile;
+    QFile indexFile;
+    uchar *mappedData = nullptr;
+    uchar *mappedIndex = nullptr;
+    qsizetype mappedCount = 0;
+    qint64 mappedDataSize = 0;
+    qint64 dataSize = 0;
+    QList<Entry> tail;
+    QByteArray tailData;
+    mutable QHash<QString, qsizetype> lookup;
+    mutable bool lookupBuilt = false;
+    mutable QList<qsizetype> removed;  // sorted indices of removed entries
+    mutable bool removedBuilt = false;
+    mutable QString error;
+};
@@ -0,0 +1,449 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <string_view>
+#include <vector>
+#include "tagcache.h"
+
+// Incremental fuzzy search over the playlist by artist, title, album, file
+// name and folder name.
+//
+// Each entry is reduced to one normalized text (case-folded, accents and
+// punctuation stripped, words separated by single spaces) kept in an arena,
+// and an inverted index maps keys to the entries containing them. The keys of
+// a word are its one- and two-letter prefixes and every trigram inside it, so
+// short queries have keys too; a key folds three characters into 18 bits, so
+// the lists live in one flat table. Posting lists are zig-zag varint deltas,
+// about a byte per posting for entries indexed in order.
+//
+// A query may miss up to half of its keys, which absorbs typos, but entries
+// holding every key always rank first. Those all hold the query's rarest key,
+// so when checking that one list against the texts finds enough of them the
+// search ends there. Otherwise, by pigeonhole, a match holds one of the
+// rarest missing + 1 keys, so only those lists open candidates and the rest
+// only add to the candidates' key tallies. Candidates with enough keys are
+// scored: the share of query keys they have, a bonus when they hold the whole
+// query as a phrase, and shorter texts first. Keys that an entry lost on
+// re-indexing stay in the lists, so such entries are recounted against their
+// own text, until the stale postings outnumber the live ones and the lists
+// are rebuilt.
+//
+// The work of one query is bounded by the whole matches ranked, the
+// candidates opened and the postings decoded. Past those bounds a query ranks
+// what it has found so far, the earliest entries in playlist order, so a key
+// held by most of a large library still answers within a frame.
+//
+// Entries are indexed on a private worker in chunks, in the order index() and
+// remove() were called; search() holds the lock only for the query itself.
+// The worker is the only writer, so it rebuilds compacted texts and lists
+// without the lock and takes it just to swap them in.
+class SearchIndex : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int DefaultLimit = 200;
+
+    explicit SearchIndex(TagCache *tags, QObject *parent = nullptr)
+    : QObject(parent), tags(tags), lists(KeyCount), marker(KeyCount, 0) {
+        // One worker keeps index() and remove() in call order
+        pool.setMaxThreadCount(1);
+    }
+
+    ~SearchIndex() {
+        stopping = true;
+        pool.clear();
+        pool.waitForDone();
+    }
+
+    // Indexes playlist entries under their paths and whatever tags are cached for them. Called
+    // again for an entry, e.g. once its tags have been read, it replaces the entry's text.
+    void index(const QList<qsizetype> &entries, const QStringList &paths) {
+        if (entries.isEmpty()) return;
+        pool.start([this, entries, paths]() { indexEntries(entries, paths); });
+    }
+
+    void remove(const QList<qsizetype> &entries) {
+        if (entries.isEmpty()) return;
+        pool.start([this, entries]() {
+            {
+                QMutexLocker locker(&mutex);
+                for (qsizetype entry : entries) setText(entry, QByteArray());
+            }
+            compact();
+        });
+    }
+
+    // Blocks until everything passed to index() and remove() so far is in.
+    void waitForIndexed() { pool.waitForDone(); }
+
+    // Entries best matching query, best first, at most limit of them.
+    QList<qsizetype> search(const QString &query, int limit = DefaultLimit) const {
+        QList<qsizetype> found;
+        const QByteArray phrase = normalize(query);
+        if (phrase.isEmpty() || limit <= 0) return found;
+        std::vector<quint32> keys = queryKeys(phrase);
+
+        QMutexLocker locker(&mutex);
+        std::sort(keys.begin(), keys.end(), [this](quint32 a, quint32 b) { return lists[a].count < lists[b].count; });
+        if (keys.size() > MaxQueryKeys) keys.resize(MaxQueryKeys);
+        const int total = static_cast<int>(keys.size());
+        const int missing = total / 2;
+        qint64 postings = 0;
+        for (int i = 0; i < total; ++i) {
+            marker[keys[i]] = static_cast<quint8>(i + 1);
+            postings += lists[keys[i]].count;
+        }
+        const std::string_view needle(phrase.constData(), phrase.size());
+        std::vector<std::pair<qint64, quint32>> scored;
+        const auto recount = [this](std::string_view text) {
+            quint64 present = 0;
+            forEachKey(text, [this, &present](quint32 key) {
+                if (marker[key]) present |= quint64(1) << (marker[key] - 1);
+            });
+            return std::popcount(present);
+        };
+        // Entries with every key outrank all others; within a tier the phrase and short texts win
+        const auto keep = [&](quint32 entry, std::string_view text, int matched) {
+            qint64 score = qint64(matched) * 1000 / total - qMin<qint64>(qint64(text.size()) / 4, 250);
+            if (matched == total) score += 1000;
+            const size_t at = text.find(needle);
+            if (at != std::string_view::npos) score += (at == 0 || text[at - 1] == ' ') ? 500 : 400;
+            scored.emplace_back(score, entry);
+        };
+
+        // Whole matches all hold the rarest key, so checking that one list against the texts
+        // finds them; when there are enough of them, decoding every list is skipped. A query
+        // of a single key has no partial matches, so its list is all there is to check.
+        if (missing == 0 || qint64(lists[keys[0]].count) * RecountCost < postings) {
+            nextSerial();
+            size_t checked = 0;
+            forEachPosting(lists[keys[0]], [&](quint32 entry) {
+                if (entry >= tally.size() || (tally[entry] >> 8) == serial) return true;
+                tally[entry] = serial << 8;
+                const std::string_view text(arena.data() + textOffset[entry], textLength[entry]);
+                if (!text.empty() && ((total == 1 && !lostKeys[entry]) || recount(text) == total)) keep(entry, text, total);
+                return scored.size() < MaxWholeMatches && ++checked < MaxCandidates;
+            });
+            if (scored.size() < static_cast<size_t>(limit) && missing > 0) scored.clear();
+        }
+
+        if (scored.empty() && missing > 0) {
+            // Only the rarest lists open candidates; the common ones just add to their tallies.
+            // Once the candidates are known, or their cap or the posting budget is reached,
+            // their texts are checked instead of decoding what is left.
+            nextSerial();
+            std::vector<quint32> candidates;
+            qint64 remaining = postings;
+            qint64 budget = MaxDecodedPostings;
+            bool tallied = true;
+            for (int i = 0; i < total && tallied; ++i) {
+                const bool opens = i <= missing;
+                if (!opens && qint64(candidates.size()) * RecountCost < remaining) {
+                    tallied = false;
+                    break;
+                }
+                remaining -= lists[keys[i]].count;
+                forEachPosting(lists[keys[i]], [&](quint32 entry) {
+                    if (--budget < 0) {
+                        tallied = false;
+                        return false;
+                    }
+                    if (entry >= tally.size()) return true;
+                    quint32 &count = tally[entry];
+                    if ((count >> 8) != serial) {
+                        if (!opens) return true;
+                        if (candidates.size() == MaxCandidates) {
+                            tallied = false;
+                            return false;
+                        }
+                        count = serial << 8;
+                        candidates.push_back(entry);
+                    }
+                    if ((count & 0xff) < 0xff) ++count;
+                    return true;
+                });
+            }
+            for (quint32 candidate : candidates) {
+                int matched = tally[candidate] & 0xff;
+                if (tallied && matched < total - missing) continue;
+                const std::string_view text(arena.data() + textOffset[candidate], textLength[candidate]);
+                if (text.empty()) continue;
+                // Stale postings may have been counted, so such entries are checked against their text
+                if (!tallied || lostKeys[candidate]) {
+                    matched = recount(text);
+                    if (matched < total - missing) continue;
+                }
+                keep(candidate, text, matched);
+            }
+        }
+        for (quint32 key : keys) marker[key] = 0;
+
+        // Best score first; equal scores keep playlist order
+        const auto better = [](const std::pair<qint64, quint32> &a, const std::pair<qint64, quint32> &b) {
+            return a.first != b.first ? a.first > b.first : a.second < b.second;
+        };
+        const size_t count = qMin(scored.size(), static_cast<size_t>(limit));
+        std::partial_sort(scored.begin(), scored.begin() + count, scored.end(), better);
+        found.reserve(count);
+        for (size_t i = 0; i < count; ++i) found.append(scored[i].second);
+        return found;
+    }
+
+private:
+    static constexpr int KeyBits = 6;
+    static constexpr quint32 KeyCount = 1u << (3 * KeyBits);
+    static constexpr size_t MaxQueryKeys = 64;
+    static constexpr int ChunkSize = 2048;
+    static constexpr int MaxTextBytes = 0xffff;
+    // Checking a text costs about as much as decoding this many postings
+    static constexpr qint64 RecountCost = 32;
+    // Bounds on one query's work, so keys held by most of a large library still answer within a
+    // frame: past them, results are ranked among the matches found so far, in playlist order
+    static constexpr size_t MaxWholeMatches = 4096;
+    static constexpr size_t MaxCandidates = 16384;
+    static constexpr qint64 MaxDecodedPostings = 2 * 1024 * 1024;
+
+    struct Postings {
+        QByteArray bytes;
+        quint32 last = 0;
+        quint32 count = 0;
+    };
+
+    // Lower-case ASCII letters and digits get their own codes; the bytes of other UTF-8
+    // characters share the rest, collisions being sorted out by the scoring pass.
+    static quint32 fold(uchar c) {
+        if (c >= 'a' && c <= 'z') return c - 'a' + 1;
+        if (c >= '0' && c <= '9') return c - '0' + 27;
+        return 37 + c % 27;
+    }
+
+    // The keys of a normalized text, one per byte: a word's first byte gives its one-letter
+    // prefix, the second its two-letter prefix and every later byte the trigram ending there.
+    // Prefix keys have zero high codes, so they never collide with trigrams.
+    template <typename Visit>
+    static void forEachKey(std::string_view text, Visit visit) {
+        quint32 window = 0;
+        for (char c : text) {
+            if (c == ' ') {
+                window = 0;
+                continue;
+            }
+            window = ((window << KeyBits) | fold(uchar(c))) & (KeyCount - 1);
+            visit(window);
+        }
+    }
+
+    // A query word of one or two letters must start a word; a longer one is looked for
+    // anywhere by its trigrams, with its two-letter prefix as a tiebreaker for word starts.
+    static std::vector<quint32> queryKeys(const QByteArray &phrase) {
+        std::vector<quint32> keys;
+        for (const QByteArray &word : phrase.split(' ')) {
+            quint32 window = 0;
+            for (qsizetype i = 0; i < word.size(); ++i) {
+                window = ((window << KeyBits) | fold(uchar(word[i]))) & (KeyCount - 1);
+                if (i >= 2 || i == qMin<qsizetype>(word.size(), 2) - 1) keys.push_back(window);
+            }
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    static std::vector<quint32> keysOf(std::string_view text) {
+        std::vector<quint32> keys;
+        keys.reserve(text.size());
+        forEachKey(text, [&keys](quint32 key) { keys.push_back(key); });
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    // Case-folded, with accents dropped and every run of other characters turned into one space
+    static QByteArray normalize(const QString &text) {
+        const QString decomposed = text.normalized(QString::NormalizationForm_KD).toCaseFolded();
+        QString out;
+        out.reserve(decomposed.size());
+        bool space = true;
+        for (QChar c : decomposed) {
+            if (c.isMark()) continue;
+            if (c.isLetterOrNumber()) {
+                out.append(c);
+                space = false;
+            } else if (!space) {
+                out.append(QLatin1Char(' '));
+                space = true;
+            }
+        }
+        if (out.endsWith(QLatin1Char(' '))) out.chop(1);
+        return out.toUtf8().left(MaxTextBytes);
+    }
+
+    // Artist, title and album, then the file name without its extension and the folder it is in
+    static QString documentText(const QString &path, const TrackTags &trackTags) {
+        const qsizetype slash = path.lastIndexOf(QLatin1Char('/'));
+        const qsizetype dot = path.lastIndexOf(QLatin1Char('.'));
+        const QString fileName = path.mid(slash + 1, dot > slash ? dot - slash - 1 : -1);
+        const qsizetype parent = slash > 0 ? path.lastIndexOf(QLatin1Char('/'), slash - 1) : -1;
+        const QString folder = slash > 0 ? path.mid(parent + 1, slash - parent - 1) : QString();
+        return trackTags.artist + ' ' + trackTags.title + ' ' + trackTags.album + ' ' + fileName + ' ' + folder;
+    }
+
+    // Worker: texts are built outside the lock, a chunk at a time, so a search waits at most
+    // for one chunk to be inserted.
+    void indexEntries(const QList<qsizetype> &entries, const QStringList &paths) {
+        tags->ensureLoaded();
+        for (qsizetype first = 0; first < entries.size(); first += ChunkSize) {
+            if (stopping) return;
+            const qsizetype last = qMin(first + ChunkSize, entries.size());
+            QList<QByteArray> texts;
+            texts.reserve(last - first);
+            for (qsizetype i = first; i < last; ++i) texts.append(normalize(documentText(paths[i], tags->tags(paths[i]))));
+            {
+                QMutexLocker locker(&mutex);
+                for (qsizetype i = first; i < last; ++i) setText(entries[i], texts[i - first]);
+            }
+            compact();
+        }
+    }
+
+    // Starts a query's tallies; they are reset lazily by comparing serials
+    void nextSerial() const {
+        if (++serial == (1u << 24)) {
+            std::fill(tally.begin(), tally.end(), 0);
+            serial = 1;
+        }
+    }
+
+    // Calls visit with each entry of list in posting order until it returns false.
+    template <typename Visit>
+    static void forEachPosting(const Postings &list, Visit visit) {
+        const auto *p = reinterpret_cast<const uchar *>(list.bytes.constData());
+        const auto *end = p + list.bytes.size();
+        qint64 entry = 0;
+        while (p < end) {
+            quint64 zigzag = 0;
+            for (int shift = 0; p < end; shift += 7) {
+                const uchar byte = *p++;
+                zigzag |= quint64(byte & 0x7f) << shift;
+                if (!(byte & 0x80)) break;
+            }
+            entry += (zigzag & 1) ? -qint64((zigzag + 1) >> 1) : qint64(zigzag >> 1);
+            if (!visit(static_cast<quint32>(entry))) return;
+        }
+    }
+
+    static void appendPosting(Postings &list, quint32 entry) {
+        const qint64 delta = qint64(entry) - qint64(list.last);
+        quint64 zigzag = delta >= 0 ? quint64(delta) << 1 : (quint64(-delta) << 1) - 1;
+        while (zigzag >= 0x80) {
+            list.bytes.append(char(zigzag | 0x80));
+            zigzag >>= 7;
+        }
+        list.bytes.append(char(zigzag));
+        list.last = entry;
+        ++list.count;
+    }
+
+    // Replaces the text of entry, posting only the keys it did not have before. Under mutex.
+    void setText(qsizetype entry, const QByteArray &text) {
+        if (entry < 0) return;
+        const auto id = static_cast<quint32>(entry);
+        if (id >= textOffset.size()) {
+            textOffset.resize(id + 1, 0);
+            textLength.resize(id + 1, 0);
+            lostKeys.resize(id + 1, 0);
+            tally.resize(id + 1, 0);
+        }
+        const std::string_view before(arena.data() + textOffset[id], textLength[id]);
+        const std::string_view after(text.constData(), text.size());
+        if (before == after) return;
+        const std::vector<quint32> oldKeys = keysOf(before);
+        const std::vector<quint32> newKeys = keysOf(after);
+        garbageBytes += textLength[id];
+        textOffset[id] = static_cast<quint32>(arena.size());
+        textLength[id] = static_cast<quint16>(text.size());
+        arena.insert(arena.end(), text.constData(), text.constData() + text.size());
+
+        // Both key lists are sorted; keys in both stay posted, the rest are added or go stale
+        qint64 shared = 0;
+        auto old = oldKeys.cbegin();
+        for (quint32 key : newKeys) {
+            while (old != oldKeys.cend() && *old < key) ++old;
+            if (old != oldKeys.cend() && *old == key) {
+                ++shared;
+                continue;
+            }
+            appendPosting(lists[key], id);
+        }
+        const qint64 dropped = qint64(oldKeys.size()) - shared;
+        livePostings += qint64(newKeys.size()) - shared - dropped;
+        stalePostings += dropped;
+        if (dropped > 0) lostKeys[id] = 1;
+    }
+
+    // Drops the texts and postings left behind by re-indexed and removed entries once they
+    // take more room than the live ones. Worker only, without the lock held: searches keep
+    // running on the old structures until the rebuilt ones are swapped in, and the old ones
+    // are freed after the lock is released again.
+    void compact() {
+        if (garbageBytes > qint64(arena.size()) / 2 && garbageBytes > CompactBytes) {
+            std::vector<char> packed;
+            std::vector<quint32> offsets(textOffset.size());
+            packed.reserve(arena.size() - garbageBytes);
+            for (size_t id = 0; id < textOffset.size(); ++id) {
+                offsets[id] = static_cast<quint32>(packed.size());
+                packed.insert(packed.end(), arena.begin() + textOffset[id], arena.begin() + textOffset[id] + textLength[id]);
+            }
+            QMutexLocker locker(&mutex);
+            arena.swap(packed);
+            textOffset.swap(offsets);
+            garbageBytes = 0;
+        }
+        if (stalePostings > livePostings && stalePostings > CompactPostings) {
+            std::vector<Postings> rebuilt(KeyCount);
+            qint64 live = 0;
+            for (size_t id = 0; id < textOffset.size(); ++id) {
+                for (quint32 key : keysOf(std::string_view(arena.data() + textOffset[id], textLength[id]))) {
+                    appendPosting(rebuilt[key], static_cast<quint32>(id));
+                    ++live;
+                }
+            }
+            QMutexLocker locker(&mutex);
+            lists.swap(rebuilt);
+            livePostings = live;
+            stalePostings = 0;
+            std::fill(lostKeys.begin(), lostKeys.end(), 0);
+        }
+    }
+
+    static constexpr qint64 CompactBytes = 1024 * 1024;
+    static constexpr qint64 CompactPostings = 1024 * 1024;
+
+    TagCache *tags;
+    mutable QMutex mutex;
+    // Everything below is written under mutex, by the worker only, which may read it without the
+    // lock; the query scratch is mutated by search()
+    std::vector<Postings> lists;
+    std::vector<char> arena;
+    std::vector<quint32> textOffset;
+    std::vector<quint16> textLength;
+    qint64 garbageBytes = 0;
+    qint64 livePostings = 0;
+    qint64 stalePostings = 0;
+    std::vector<quint8> lostKeys;  // per entry: 1 when some of its postings went stale
+    mutable std::vector<quint8> marker;
+    mutable std::vector<quint32> tally;  // per entry: query serial << 8 | keys counted
+    mutable quint32 serial = 0;
+    std::atomic<bool> stopping{false};
+    // Declared last so it is destroyed first, after waiting for the worker
+    QThreadPool pool;
+};
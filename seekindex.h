@@ -0,0 +1,433 @@
+#pragma once
+
+#include <QIODevice>
+#include <QThreadPool>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QString>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "sourcestamp.h"
+
+// Byte offsets of decodable frames in an MP3 or FLAC file, about one per
+// second of audio, so a seek can hand the decoder the stream from the frame
+// just before the target and drop only the samples in between.
+//
+// Samples are counted in the file's own rate from its first audio frame.
+// leadIn is how many of those a decoder trims when it plays the file from
+// the start (LAME encoder delay plus the MP3 decoder delay), so presentation
+// sample p is stream sample p + leadIn. headerBytes is the prefix a decoder
+// needs before any frame: the FLAC signature and metadata, nothing for MP3.
+struct SeekIndex {
+    enum Kind : quint32 {
+        Mp3 = 1,
+        Flac = 2
+    };
+
+    struct Entry {
+        quint64 sample;
+        quint64 offset;
+    };
+
+    // Frames decoded ahead of the target: MP3 frames borrow bits from the ones
+    // before them and overlap with their predecessor.
+    static constexpr int Mp3WarmupFrames = 3;
+
+    Kind kind = Mp3;
+    quint32 sampleRate = 0;
+    quint32 leadIn = 0;
+    quint32 warmupSamples = 0;
+    quint64 headerBytes = 0;
+    quint64 totalSamples = 0;
+    std::vector<Entry> entries;
+
+    // Latest entry at least warmupSamples before stream sample target
+    const Entry &entryFor(quint64 target) const {
+        const quint64 wanted = target > warmupSamples ? target - warmupSamples : 0;
+        auto it = std::upper_bound(entries.begin(), entries.end(), wanted,
+                                   [](quint64 sample, const Entry &entry) { return sample < entry.sample; });
+        return it == entries.begin() ? entries.front() : *(it - 1);
+    }
+
+    static bool build(const uchar *data, qint64 size, SeekIndex &index) {
+        const qint64 start = id3Size(data, size);
+        if (size - start >= 4 && std::memcmp(data + start, "fLaC", 4) == 0) return scanFlac(data, size, start, index);
+        return scanMp3(data, size, start, index);
+    }
+
+    // Length of a leading ID3v2 tag, 0 when there is none
+    static qint64 id3Size(const uchar *data, qint64 size) {
+        if (size < 10 || std::memcmp(data, "ID3", 3) != 0) return 0;
+        const qint64 body = (qint64(data[6] & 0x7f) << 21) | (qint64(data[7] & 0x7f) << 14)
+                            | (qint64(data[8] & 0x7f) << 7) | qint64(data[9] & 0x7f);
+        return qMin(size, 10 + body + ((data[5] & 0x10) ? 10 : 0));
+    }
+
+    // CRC-8 (polynomial 0x07) that closes every FLAC frame header
+    static quint8 crc8(const uchar *data, qint64 length) {
+        quint8 crc = 0;
+        for (qint64 i = 0; i < length; ++i) {
+            crc ^= data[i];
+            for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+        }
+        return crc;
+    }
+
+    struct Mp3Frame {
+        int version;  // 0 MPEG-2.5, 2 MPEG-2, 3 MPEG-1
+        int sampleRate;
+        int samples;
+        int length;
+        bool mono;
+    };
+
+    // Decodes the MPEG audio Layer III frame header at p; false for anything else
+    static bool parseMp3Header(const uchar *p, Mp3Frame &frame) {
+        static constexpr int Mpeg1Bitrates[16] = {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, -1};
+        static constexpr int Mpeg2Bitrates[16] = {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, -1};
+        static constexpr int Rates[3] = {44100, 48000, 32000};
+        if (p[0] != 0xff || (p[1] & 0xe0) != 0xe0) return false;
+        frame.version = (p[1] >> 3) & 3;
+        const int layer = (p[1] >> 1) & 3;
+        const int bitrateIndex = p[2] >> 4;
+        const int rateIndex = (p[2] >> 2) & 3;
+        // Layer III only, no free format
+        if (frame.version == 1 || layer != 1 || bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3) return false;
+        const bool mpeg1 = frame.version == 3;
+        const int bitrate = (mpeg1 ? Mpeg1Bitrates : Mpeg2Bitrates)[bitrateIndex] * 1000;
+        frame.sampleRate = Rates[rateIndex] >> (mpeg1 ? 0 : frame.version == 2 ? 1 : 2);
+        frame.samples = mpeg1 ? 1152 : 576;
+        frame.length = (mpeg1 ? 144 : 72) * bitrate / frame.sampleRate + ((p[2] >> 1) & 1);
+        frame.mono = (p[3] >> 6) == 3;
+        return true;
+    }
+
+private:
+    static bool scanMp3(const uchar *data, qint64 size, qint64 offset, SeekIndex &index) {
+        index.kind = Mp3;
+        index.headerBytes = 0;
+        quint64 sample = 0, nextKeep = 0;
+        bool first = true;
+        Mp3Frame frame{}, following{};
+        while (offset + 4 <= size) {
+            if (!parseMp3Header(data + offset, frame)) {
+                ++offset;
+                continue;
+            }
+            // A sync word inside audio data is only believed when the next frame follows it
+            const qint64 end = offset + frame.length;
+            if (end + 4 <= size && (!parseMp3Header(data + end, following) || following.version != frame.version
+                                    || following.sampleRate != frame.sampleRate)) {
+                ++offset;
+                continue;
+            }
+            if (first) {
+                first = false;
+                index.sampleRate = frame.sampleRate;
+                index.warmupSamples = Mp3WarmupFrames * frame.samples;
+                // A Xing/Info frame carries no audio; its LAME extension has the encoder delay
+                const int sideInfo = frame.version == 3 ? (frame.mono ? 17 : 32) : (frame.mono ? 9 : 17);
+                // The last frame of a truncated file may claim more bytes than there are
+                const qint64 available = qMin(end, size);
+                const qint64 tag = offset + 4 + sideInfo;
+                if (tag + 8 <= available && (std::memcmp(data + tag, "Xing", 4) == 0 || std::memcmp(data + tag, "Info", 4) == 0)) {
+                    const quint32 flags = qFromBigEndian<quint32>(data + tag + 4);
+                    qint64 lame = tag + 8 + ((flags & 1) ? 4 : 0) + ((flags & 2) ? 4 : 0) + ((flags & 4) ? 100 : 0)
+                                  + ((flags & 8) ? 4 : 0);
+                    if (lame + 24 <= available && std::memcmp(data + lame, "LAME", 4) == 0) {
+                        index.leadIn = ((quint32(data[lame + 21]) << 4) | (data[lame + 22] >> 4)) + 529;
+                    }
+                    offset = end;
+                    continue;
+                }
+            }
+            if (sample >= nextKeep) {
+                index.entries.push_back({sample, static_cast<quint64>(offset)});
+                nextKeep = sample + index.sampleRate;
+            }
+            sample += frame.samples;
+            offset = end;
+        }
+        index.totalSamples = sample;
+        return !index.entries.empty();
+    }
+
+    static bool scanFlac(const uchar *data, qint64 size, qint64 offset, SeekIndex &index) {
+        index.kind = Flac;
+        index.leadIn = 0;
+        index.warmupSamples = 0;
+        // Metadata blocks up to the last one; STREAMINFO comes first
+        qint64 at = offset + 4;
+        quint32 blockSize = 0;
+        for (bool last = false; !last;) {
+            if (at + 4 > size) return false;
+            last = data[at] & 0x80;
+            const int type = data[at] & 0x7f;
+            const qint64 length = (qint64(data[at + 1]) << 16) | (qint64(data[at + 2]) << 8) | data[at + 3];
+            if (type == 0 && length >= 18 && at + 4 + 18 <= size) {
+                const uchar *info = data + at + 4;
+                blockSize = (quint32(info[0]) << 8) | info[1];
+                index.sampleRate = (quint32(info[10]) << 12) | (quint32(info[11]) << 4) | (info[12] >> 4);
+                index.totalSamples = (quint64(info[13] & 0x0f) << 32) | qFromBigEndian<quint32>(info + 14);
+            }
+            at += 4 + length;
+        }
+        if (index.sampleRate == 0) return false;
+        index.headerBytes = static_cast<quint64>(at);
+
+        // Sync codes also turn up inside frames; a header only counts if it passes its CRC and
+        // continues the sample numbering, which no block can advance by more than 65535
+        quint64 nextKeep = 0;
+        qint64 previous = -1;
+        while (at + 16 <= size) {
+            const uchar *sync = static_cast<const uchar *>(std::memchr(data + at, 0xff, size - at - 15));
+            if (!sync) break;
+            at = sync - data;
+            quint64 sample;
+            int headerLength;
+            if ((sync[1] & 0xfe) == 0xf8 && parseFlacFrame(sync, size - at, blockSize, sample, headerLength)
+                && (previous < 0 ? sample == 0 : sample > quint64(previous) && sample - quint64(previous) <= 65535)) {
+                previous = static_cast<qint64>(sample);
+                if (sample >= nextKeep) {
+                    index.entries.push_back({sample, static_cast<quint64>(at)});
+                    nextKeep = sample + index.sampleRate;
+                }
+                at += headerLength;
+                continue;
+            }
+            ++at;
+        }
+        return !index.entries.empty();
+    }
+
+    // Validates a frame header by its reserved bits and CRC-8 and returns its first sample.
+    static bool parseFlacFrame(const uchar *p, qint64 available, quint32 fixedBlockSize, quint64 &sample, int &length) {
+        const bool variable = p[1] & 1;
+        const int blockCode = p[2] >> 4;
+        const int rateCode = p[2] & 0x0f;
+        if (blockCode == 0 || rateCode == 15 || (p[3] & 1) || ((p[3] >> 1) & 7) == 3 || ((p[3] >> 1) & 7) == 7
+            || (p[3] >> 4) > 10) {
+            return false;
+        }
+        // UTF-8 style coded frame or sample number
+        int at = 4;
+        quint64 number = p[at];
+        int extra = 0;
+        if (number >= 0x80) {
+            if ((number & 0xe0) == 0xc0) extra = 1, number &= 0x1f;
+            else if ((number & 0xf0) == 0xe0) extra = 2, number &= 0x0f;
+            else if ((number & 0xf8) == 0xf0) extra = 3, number &= 0x07;
+            else if ((number & 0xfc) == 0xf8) extra = 4, number &= 0x03;
+            else if ((number & 0xfe) == 0xfc) extra = 5, number &= 0x01;
+            else if (number == 0xfe) extra = 6, number = 0;
+            else return false;
+        }
+        for (int i = 1; i <= extra; ++i) {
+            if ((p[at + i] & 0xc0) != 0x80) return false;
+            number = (number << 6) | (p[at + i] & 0x3f);
+        }
+        at += 1 + extra;
+        if (blockCode == 6) at += 1;
+        else if (blockCode == 7) at += 2;
+        if (rateCode == 12) at += 1;
+        else if (rateCode == 13 || rateCode == 14) at += 2;
+        if (at >= available || crc8(p, at) != p[at]) return false;
+        sample = variable ? number : number * fixedBlockSize;
+        length = at + 1;
+        return true;
+    }
+};
+
+// A file as a decoder sees it when playback starts at a seek index entry: the
+// header prefix followed directly by the frames from the entry on.
+class SplicedDevice : public QIODevice {
+public:
+    SplicedDevice(const QString &path, quint64 headerBytes, quint64 frameOffset)
+    : file(path), headerBytes(headerBytes), frameOffset(frameOffset) {
+        if (file.open(QIODevice::ReadOnly)) open(QIODevice::ReadOnly);
+    }
+
+    bool isSequential() const override { return false; }
+    qint64 size() const override { return static_cast<qint64>(headerBytes) + file.size() - static_cast<qint64>(frameOffset); }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override {
+        const qint64 at = pos();
+        qint64 got = 0;
+        if (at < static_cast<qint64>(headerBytes)) {
+            if (!file.seek(at)) return -1;
+            got = file.read(data, qMin<qint64>(maxlen, headerBytes - at));
+            if (got <= 0 || got == maxlen) return got;
+        }
+        const qint64 tail = at + got - static_cast<qint64>(headerBytes);
+        if (!file.seek(static_cast<qint64>(frameOffset) + tail)) return got ? got : -1;
+        const qint64 more = file.read(data + got, maxlen - got);
+        return more < 0 ? (got ? got : -1) : got + more;
+    }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    QFile file;
+    quint64 headerBytes;
+    quint64 frameOffset;
+};
+
+// Builds seek indexes in the background and keeps them: on disk in the app's
+// cache directory, stamped with the source's size and mtime, and in memory for
+// the last few files. find() is safe from any thread and never blocks on I/O.
+class SeekIndexCache {
+public:
+    static constexpr int MemoryEntries = 16;
+
+    SeekIndexCache() {
+        pool.setMaxThreadCount(1);
+        directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/seekindex";
+    }
+
+    ~SeekIndexCache() {
+        pool.clear();
+        pool.waitForDone();
+    }
+
+    // Loads or builds the index of path unless it is already known.
+    void prepare(const QString &path) {
+        if (path.isEmpty() || !isIndexable(path)) return;
+        {
+            QMutexLocker locker(&mutex);
+            if (indexes.contains(path) || preparing.contains(path)) return;
+            preparing.insert(path);
+        }
+        pool.start([this, path]() {
+            std::shared_ptr<const SeekIndex> index = loadOrBuild(path);
+            QMutexLocker locker(&mutex);
+            preparing.remove(path);
+            if (!index) return;
+            indexes.insert(path, index);
+            order.append(path);
+            while (order.size() > MemoryEntries) indexes.remove(order.takeFirst());
+        });
+    }
+
+    std::shared_ptr<const SeekIndex> find(const QString &path) const {
+        QMutexLocker locker(&mutex);
+        return indexes.value(path);
+    }
+
+private:
+    static constexpr char Magic[8] = {'A', 'P', 'X', 'S', 'E', 'E', 'K', '1'};
+    static constexpr quint32 Version = 1;
+
+    struct FileHeader {
+        char magic[8];
+        quint32 version;
+        quint32 kind;
+        qint64 sourceSize;
+        qint64 sourceMtimeNs;
+        quint32 sampleRate;
+        quint32 leadIn;
+        quint32 warmupSamples;
+        quint32 reserved;
+        quint64 headerBytes;
+        quint64 totalSamples;
+        quint64 count;
+    };
+
+    static bool isIndexable(const QString &path) {
+        return path.endsWith(".mp3", Qt::CaseInsensitive) || path.endsWith(".flac", Qt::CaseInsensitive);
+    }
+
+    // A stored index is only trusted if every offset lies inside the source and the samples ascend,
+    // which is what entryFor() and the decoders rely on
+    static bool isConsistent(const FileHeader &header, const std::vector<SeekIndex::Entry> &entries, qint64 size) {
+        if ((header.kind != SeekIndex::Mp3 && header.kind != SeekIndex::Flac) || header.sampleRate == 0
+            || header.headerBytes > quint64(size)) {
+            return false;
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (entries[i].offset >= quint64(size) || (i > 0 && entries[i].sample <= entries[i - 1].sample)) return false;
+        }
+        return true;
+    }
+
+    std::shared_ptr<const SeekIndex> loadOrBuild(const QString &path) const {
+        SourceStamp stamp;
+        if (!SourceStamp::read(path, stamp)) return nullptr;
+        const qint64 size = stamp.size;
+        const QString indexPath = directory + '/' + QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex() + ".idx";
+
+        auto index = std::make_shared<SeekIndex>();
+        QFile stored(indexPath);
+        FileHeader header;
+        // The entry count has to account for exactly the rest of the file before anything is allocated
+        if (stored.open(QIODevice::ReadOnly) && stored.read(reinterpret_cast<char *>(&header), sizeof(header)) == sizeof(header)
+            && std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 && header.version == Version
+            && header.sourceSize == size && header.sourceMtimeNs == stamp.mtimeNs && header.count > 0
+            && header.count == quint64(stored.size() - qint64(sizeof(FileHeader))) / sizeof(SeekIndex::Entry)
+            && quint64(stored.size() - qint64(sizeof(FileHeader))) % sizeof(SeekIndex::Entry) == 0) {
+            index->entries.resize(header.count);
+            const qint64 bytes = static_cast<qint64>(header.count * sizeof(SeekIndex::Entry));
+            if (stored.read(reinterpret_cast<char *>(index->entries.data()), bytes) == bytes
+                && isConsistent(header, index->entries, size)) {
+                index->kind = static_cast<SeekIndex::Kind>(header.kind);
+                index->sampleRate = header.sampleRate;
+                index->leadIn = header.leadIn;
+                index->warmupSamples = header.warmupSamples;
+                index->headerBytes = header.headerBytes;
+                index->totalSamples = header.totalSamples;
+                return index;
+            }
+            index->entries.clear();
+        }
+        stored.close();
+
+        QFile source(path);
+        if (!source.open(QIODevice::ReadOnly) || source.size() == 0) return nullptr;
+        const uchar *data = source.map(0, source.size());
+        if (!data) return nullptr;
+        const bool built = SeekIndex::build(data, source.size(), *index);
+        source.unmap(const_cast<uchar *>(data));
+        if (!built) return nullptr;
+
+        header = {};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.kind = index->kind;
+        header.sourceSize = size;
+        header.sourceMtimeNs = stamp.mtimeNs;
+        header.sampleRate = index->sampleRate;
+        header.leadIn = index->leadIn;
+        header.warmupSamples = index->warmupSamples;
+        header.headerBytes = index->headerBytes;
+        header.totalSamples = index->totalSamples;
+        header.count = index->entries.size();
+        QDir().mkpath(directory);
+        QSaveFile file(indexPath);
+        if (file.open(QIODevice::WriteOnly)) {
+            file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(index->entries.data()),
+                       static_cast<qint64>(index->entries.size() * sizeof(SeekIndex::Entry)));
+            file.commit();
+        }
+        return index;
+    }
+
+    QString directory;
+    mutable QMutex mutex;
+    QHash<QString, std::shared_ptr<const SeekIndex>> indexes;  // guarded by mutex, as are the two below
+    QList<QString> order;
+    QSet<QString> preparing;
+    QThreadPool pool;
+};
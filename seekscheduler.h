@@ -0,0 +1,94 @@
+#pragma once
+
+#include <QObject>
+#include <QTimer>
+#include "playbackengine.h"
+
+// Coalesces the seeks of a progress-bar drag.
+//
+// Every request only replaces the target. A seek is issued when none is in
+// flight; the next one waits for the engine's seekFinished() (or a timeout,
+// for backends that stay silent when the position does not move), by which
+// time any number of requests may have collapsed into the latest. While a drag
+// is active the UI shows target() instead of the engine's position, so the
+// handle and time follow the mouse even though the audio catches up later.
+// commit() ends the drag; the final target is issued exactly, after whatever
+// is still in flight.
+class SeekScheduler : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int SeekTimeoutMs = 500;
+
+    struct Stats {
+        quint64 requested;
+        quint64 issued;
+    };
+
+    explicit SeekScheduler(QObject *parent = nullptr)
+    : QObject(parent) {
+        timeout.setSingleShot(true);
+        timeout.setInterval(SeekTimeoutMs);
+        connect(&timeout, &QTimer::timeout, this, &SeekScheduler::finished);
+    }
+
+    // Follows engine, dropping any seek still queued for the previous one.
+    void setEngine(PlaybackEngine *newEngine) {
+        if (engine) disconnect(engine, nullptr, this, nullptr);
+        engine = newEngine;
+        cancel();
+        if (engine) connect(engine, &PlaybackEngine::seekFinished, this, &SeekScheduler::finished);
+    }
+
+    void request(qint64 position) {
+        ++stats.requested;
+        target = position;
+        active = pending = true;
+        if (!inFlight) issue();
+    }
+
+    // The drag is over: once the last target has been issued and has landed, the engine's
+    // own position is shown again.
+    void commit() {
+        committing = true;
+        if (!inFlight && !pending) cancel();
+    }
+
+    // Forgets the drag, for when the track changes under it.
+    void cancel() {
+        timeout.stop();
+        active = pending = inFlight = committing = false;
+    }
+
+    bool isActive() const { return active; }
+    qint64 targetPosition() const { return target; }
+    Stats seekStats() const { return stats; }
+
+private:
+    void issue() {
+        pending = false;
+        inFlight = true;
+        ++stats.issued;
+        timeout.start();
+        engine->setPosition(target);
+    }
+
+    void finished() {
+        if (!inFlight) return;
+        timeout.stop();
+        inFlight = false;
+        if (pending) {
+            issue();
+        } else if (committing) {
+            cancel();
+        }
+    }
+
+    PlaybackEngine *engine = nullptr;
+    QTimer timeout;
+    qint64 target = 0;
+    bool active = false;
+    bool pending = false;
+    bool inFlight = false;
+    bool committing = false;
+    Stats stats{};
+};
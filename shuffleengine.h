@@ -0,0 +1,119 @@
+#pragma once
+
+#include <QRandomGenerator>
+#include <QtGlobal>
+#include <array>
+#include <vector>
+
+// Shuffled play order over playlist indices.
+//
+// The order is a Fisher-Yates permutation walked front to back, so every track
+// plays once per cycle and next() is O(1). At the end of a cycle the order is
+// reshuffled and the first few slots are repaired so nothing from the tail of
+// the previous cycle comes back within the no-repeat window. Tracks appended
+// while a cycle is running are swapped into a random unplayed slot, which keeps
+// the order uniform without reshuffling. previous() walks a short history ring.
+class ShuffleEngine {
+public:
+    static constexpr int DefaultWindow = 32;
+    static constexpr int HistoryDepth = 64;
+
+    explicit ShuffleEngine(int window = DefaultWindow)
+    : random(QRandomGenerator::global()->generate()), window(qMax(0, window)) {}
+
+    // Rebuilds the order over indices 0..count-1, O(n).
+    void reset(qsizetype count) {
+        order.resize(count);
+        for (qsizetype i = 0; i < count; ++i) order[i] = static_cast<quint32>(i);
+        lastPlayed.assign(count, 0);
+        tick = 0;
+        historyCount = 0;
+        forwardCount = 0;
+        reshuffle();
+        cursor = 0;
+    }
+
+    qsizetype size() const { return static_cast<qsizetype>(order.size()); }
+    int noRepeatWindow() const { return window; }
+    void setNoRepeatWindow(int tracks) { window = qMax(0, tracks); }
+
+    // Adds the next playlist index (== size()) to the running cycle, O(1).
+    void append() {
+        const quint32 index = static_cast<quint32>(order.size());
+        order.push_back(index);
+        lastPlayed.push_back(0);
+        const quint32 unplayed = static_cast<quint32>(order.size() - cursor);
+        std::swap(order.back(), order[cursor + random.bounded(unplayed)]);
+    }
+
+    // Next index to play, or -1 when empty. Re-walks history first after previous().
+    qsizetype next() {
+        if (order.empty()) return -1;
+        quint32 index;
+        if (forwardCount > 0) {
+            index = forward[--forwardCount];
+        } else {
+            if (cursor == order.size()) {
+                reshuffle();
+                cursor = 0;
+            }
+            index = order[cursor++];
+        }
+        lastPlayed[index] = ++tick;
+        pushHistory(index);
+        return index;
+    }
+
+    // Index played before the current one, or -1 when the history is exhausted.
+    qsizetype previous() {
+        if (historyCount < 2) return -1;
+        const quint32 current = history[(historyHead + HistoryDepth - 1) % HistoryDepth];
+        historyHead = (historyHead + HistoryDepth - 1) % HistoryDepth;
+        --historyCount;
+        if (forwardCount < HistoryDepth) forward[forwardCount++] = current;
+        return history[(historyHead + HistoryDepth - 1) % HistoryDepth];
+    }
+
+private:
+    void reshuffle() {
+        for (size_t i = order.size(); i > 1; --i) {
+            const size_t j = random.bounded(static_cast<quint32>(i));
+            std::swap(order[i - 1], order[j]);
+        }
+        // Slots past the window are at least window draws away from anything played
+        // last cycle; only the head can collide, so swap offenders with later slots.
+        const size_t guard = qMin<size_t>(static_cast<size_t>(window), order.size() / 2);
+        if (tick == 0 || guard == 0) return;
+        for (size_t i = 0; i < guard; ++i) {
+            for (int attempt = 0; attempt < MaxRepairAttempts && isRecent(order[i], i, guard); ++attempt) {
+                const size_t j = guard + random.bounded(static_cast<quint32>(order.size() - guard));
+                std::swap(order[i], order[j]);
+            }
+        }
+    }
+
+    // True if playing index at slot of the new cycle would fall inside the guarded window.
+    bool isRecent(quint32 index, size_t slot, size_t guard) const {
+        return lastPlayed[index] != 0 && tick + 1 + slot - lastPlayed[index] <= guard;
+    }
+
+    void pushHistory(quint32 index) {
+        history[historyHead] = index;
+        historyHead = (historyHead + 1) % HistoryDepth;
+        if (historyCount < HistoryDepth) ++historyCount;
+    }
+
+    static constexpr int MaxRepairAttempts = 16;
+
+    QRandomGenerator random;
+    int window;
+    std::vector<quint32> order;
+    std::vector<quint64> lastPlayed;
+    size_t cursor = 0;
+    quint64 tick = 0;
+    std::array<quint32, HistoryDepth> history{};
+    int historyHead = 0;
+    int historyCount = 0;
+    std::array<quint32, HistoryDepth> forward{};
+    int forwardCount = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+
+#ifdef Q_OS_UNIX
+#include <sys/stat.h>
+#endif
+
+// Size and modification time of a source file. The tag, artwork, loudness,
+// waveform and seek index caches store one with everything they derive from a
+// file, and trust the stored result only while the file's stamp still matches.
+struct SourceStamp {
+    qint64 size = 0;
+    qint64 mtimeNs = 0;
+
+    bool operator==(const SourceStamp &other) const = default;
+
+    // False when path does not exist or is not a regular file. A single stat() on Unix.
+    static bool read(const QString &path, SourceStamp &stamp) {
+#ifdef Q_OS_UNIX
+        struct stat info;
+        if (::stat(QFile::encodeName(path).constData(), &info) != 0 || !S_ISREG(info.st_mode)) return false;
+        stamp.size = info.st_size;
+        stamp.mtimeNs = qint64(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+        return true;
+#else
+        QFileInfo fileInfo(path);
+        if (!fileInfo.isFile()) return false;
+        stamp.size = fileInfo.size();
+        stamp.mtimeNs = fileInfo.lastModified().toMSecsSinceEpoch() * 1000000;
+        return true;
+#endif
+    }
+};
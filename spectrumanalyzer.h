@@ -0,0 +1,244 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QSemaphore>
+#include <QElapsedTimer>
+#include <QAudioBuffer>
+#include <QAudioFormat>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "onsetdetector.h"
+#include "spectrumkernel.h"
+#include "lockfree.h"
+
+// Turns decoded PCM into log-spaced band levels, onsets and a tempo estimate
+// for the visualizer.
+// Any single thread may push audio; a private worker thread does the windowed
+// FFT and publishes each result through a triple buffer, so the GUI thread only
+// ever does a lock-free fetch.
+class SpectrumAnalyzer : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int BandCount = 16;
+    static constexpr int FrameSize = 2048;
+    static constexpr int HopSize = 1024;
+    // Backlog beyond this is dropped so one wakeup never analyzes more than a few frames.
+    static constexpr int MaxBacklog = FrameSize * 2;
+
+    struct Frame {
+        std::array<float, BandCount> bands{};
+        quint64 sequence = 0;
+        // Counts every detected onset, so a reader that skips frames still sees new beats
+        quint32 onsetCount = 0;
+        float onsetStrength = 0.0f;
+        float bpm = 0.0f;
+    };
+
+    struct Stats {
+        quint64 frames = 0;
+        qint64 lastNs = 0;
+        qint64 maxNs = 0;
+        qint64 averageNs = 0;
+        quint64 droppedSamples = 0;
+    };
+
+    explicit SpectrumAnalyzer(QObject *parent = nullptr)
+    : QObject(parent), ring(FrameSize * 8), window(FrameSize), history(FrameSize, 0.0f),
+    spectrum(FrameSize / 2 + 1), kernel(FrameSize) {
+        for (int i = 0; i < FrameSize; ++i) {
+            window[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (FrameSize - 1));
+        }
+        worker = QThread::create([this]() { run(); });
+        worker->setObjectName("SpectrumAnalyzer");
+        worker->start(QThread::LowPriority);
+    }
+
+    ~SpectrumAnalyzer() {
+        stopping.store(true, std::memory_order_relaxed);
+        wakeup.release();
+        worker->wait();
+        delete worker;
+    }
+
+    // Producer side: downmixes to mono and queues the samples. Never blocks.
+    void pushBuffer(const QAudioBuffer &buffer) {
+        const QAudioFormat format = buffer.format();
+        const int channels = format.channelCount();
+        const qsizetype frames = buffer.frameCount();
+        if (channels <= 0 || frames <= 0) return;
+        if (static_cast<qsizetype>(mono.size()) < frames) mono.resize(frames);
+
+        switch (format.sampleFormat()) {
+        case QAudioFormat::Float:
+            downmix(buffer.constData<float>(), frames, channels, 1.0f);
+            break;
+        case QAudioFormat::Int16:
+            downmix(buffer.constData<qint16>(), frames, channels, 1.0f / 32768.0f);
+            break;
+        case QAudioFormat::Int32:
+            downmix(buffer.constData<qint32>(), frames, channels, 1.0f / 2147483648.0f);
+            break;
+        case QAudioFormat::UInt8: {
+            const quint8 *data = buffer.constData<quint8>();
+            for (qsizetype i = 0; i < frames; ++i) {
+                float sum = 0.0f;
+                for (int c = 0; c < channels; ++c) sum += (data[i * channels + c] - 128) / 128.0f;
+                mono[i] = sum / channels;
+            }
+            break;
+        }
+        default:
+            return;
+        }
+        pushSamples(mono.data(), frames, format.sampleRate());
+    }
+
+    void pushSamples(const float *samples, qsizetype count, int sampleRate) {
+        if (sampleRate > 0) this->sampleRate.store(sampleRate, std::memory_order_relaxed);
+        const size_t written = ring.write(samples, static_cast<size_t>(count));
+        if (written < static_cast<size_t>(count)) droppedSamples.fetch_add(count - written, std::memory_order_relaxed);
+        if (ring.readAvailable() >= static_cast<size_t>(HopSize)) wakeup.release();
+    }
+
+    // Forgets the analysis history and tempo, e.g. when a new track starts. Never blocks.
+    void reset() {
+        resetRequested.store(true, std::memory_order_relaxed);
+    }
+
+    // GUI side: returns true and fills out when a newer frame is available.
+    bool fetchFrame(Frame &out) {
+        if (!frames.fetch()) return false;
+        out = frames.readBuffer();
+        return true;
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.frames = frameCount.load(std::memory_order_relaxed);
+        s.lastNs = lastNs.load(std::memory_order_relaxed);
+        s.maxNs = maxNs.load(std::memory_order_relaxed);
+        s.averageNs = s.frames ? static_cast<qint64>(totalNs.load(std::memory_order_relaxed) / s.frames) : 0;
+        s.droppedSamples = droppedSamples.load(std::memory_order_relaxed);
+        return s;
+    }
+
+private:
+    template <typename Sample>
+    void downmix(const Sample *data, qsizetype frames, int channels, float scale) {
+        const float gain = scale / channels;
+        for (qsizetype i = 0; i < frames; ++i) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; ++c) sum += static_cast<float>(data[i * channels + c]);
+            mono[i] = sum * gain;
+        }
+    }
+
+    void run() {
+        while (true) {
+            wakeup.acquire();
+            if (stopping.load(std::memory_order_relaxed)) return;
+            wakeup.tryAcquire(wakeup.available());
+
+            const size_t backlog = ring.readAvailable();
+            if (backlog > static_cast<size_t>(MaxBacklog)) {
+                const size_t excess = (backlog - MaxBacklog) / HopSize * HopSize;
+                droppedSamples.fetch_add(ring.skip(excess), std::memory_order_relaxed);
+            }
+            while (ring.readAvailable() >= static_cast<size_t>(HopSize)) {
+                std::copy(history.begin() + HopSize, history.end(), history.begin());
+                ring.read(history.data() + FrameSize - HopSize, HopSize);
+                analyzeFrame();
+            }
+        }
+    }
+
+    void analyzeFrame() {
+        QElapsedTimer timer;
+        timer.start();
+
+        const int rate = sampleRate.load(std::memory_order_relaxed);
+        if (resetRequested.exchange(false, std::memory_order_relaxed)) {
+            std::fill(history.begin(), history.end() - HopSize, 0.0f);
+            bandRate = 0;
+        }
+        if (rate != bandRate) {
+            buildBands(rate);
+            onsets.reset(FrameSize / 2 + 1, static_cast<float>(rate) / HopSize);
+        }
+
+        kernel.magnitudes(history.data(), window.data(), spectrum.data());
+        SpectrumKernel::bandPeaks(spectrum.data(), bandStart.data(), BandCount, bandPeak.data());
+
+        // Hann coherent gain is 0.5, so a full-scale sine peaks at FrameSize / 4.
+        const float normalize = 4.0f / FrameSize;
+        if (onsets.process(spectrum.data(), normalize)) ++onsetCount;
+
+        Frame &frame = frames.writeBuffer();
+        for (int b = 0; b < BandCount; ++b) {
+            const float db = 20.0f * std::log10(bandPeak[b] * normalize + 1e-9f);
+            frame.bands[b] = std::clamp((db - FloorDb) / -FloorDb, 0.0f, 1.0f);
+        }
+        frame.sequence = ++sequence;
+        frame.onsetCount = onsetCount;
+        frame.onsetStrength = onsets.strength();
+        frame.bpm = onsets.bpm();
+        frames.publish();
+
+        const qint64 elapsed = timer.nsecsElapsed();
+        lastNs.store(elapsed, std::memory_order_relaxed);
+        if (elapsed > maxNs.load(std::memory_order_relaxed)) maxNs.store(elapsed, std::memory_order_relaxed);
+        totalNs.fetch_add(elapsed, std::memory_order_relaxed);
+        frameCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Log-spaced band edges between 40 Hz and 16 kHz (or Nyquist), at least one bin wide.
+    void buildBands(int rate) {
+        bandRate = rate;
+        const float binHz = static_cast<float>(rate) / FrameSize;
+        const float low = 40.0f;
+        const float high = std::min(16000.0f, rate / 2.0f);
+        int previous = std::max(1, static_cast<int>(low / binHz));
+        for (int b = 0; b <= BandCount; ++b) {
+            const float hz = low * std::pow(high / low, static_cast<float>(b) / BandCount);
+            int bin = std::clamp(static_cast<int>(std::lround(hz / binHz)), 1, FrameSize / 2);
+            if (b > 0 && bin <= previous) bin = std::min(previous + 1, FrameSize / 2);
+            bandStart[b] = bin;
+            previous = bin;
+        }
+    }
+
+    static constexpr float FloorDb = -60.0f;
+
+    QThread *worker = nullptr;
+    QSemaphore wakeup;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> resetRequested{false};
+    std::atomic<int> sampleRate{44100};
+    SpscRingBuffer<float> ring;
+    TripleBuffer<Frame> frames;
+
+    // Producer scratch
+    std::vector<float> mono;
+
+    // Worker state
+    std::vector<float> window;
+    std::vector<float> history;
+    std::vector<float> spectrum;
+    SpectrumKernel kernel;
+    OnsetDetector onsets;
+    quint32 onsetCount = 0;
+    std::array<int, BandCount + 1> bandStart{};
+    std::array<float, BandCount> bandPeak{};
+    int bandRate = 0;
+    quint64 sequence = 0;
+
+    std::atomic<quint64> frameCount{0};
+    std::atomic<qint64> lastNs{0};
+    std::atomic<qint64> maxNs{0};
+    std::atomic<quint64> totalNs{0};
+    std::atomic<quint64> droppedSamples{0};
+};
@@ -0,0 +1,447 @@
+#include "spectrumkernel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define APEX_X86_SIMD 1
+#include <immintrin.h>
+#define APEX_TARGET_SSE2 __attribute__((target("sse2")))
+#define APEX_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+namespace {
+
+// One radix-2 decimation-in-time stage over split real/imaginary arrays.
+// w points at this stage's halfSpan twiddles.
+void stageScalar(float *re, float *im, const float *wr, const float *wi, int n, int halfSpan) {
+    for (int start = 0; start < n; start += halfSpan * 2) {
+        float *ar = re + start, *ai = im + start;
+        float *br = ar + halfSpan, *bi = ai + halfSpan;
+        for (int j = 0; j < halfSpan; ++j) {
+            const float tr = wr[j] * br[j] - wi[j] * bi[j];
+            const float ti = wr[j] * bi[j] + wi[j] * br[j];
+            br[j] = ar[j] - tr;
+            bi[j] = ai[j] - ti;
+            ar[j] += tr;
+            ai[j] += ti;
+        }
+    }
+}
+
+// Real spectrum split for bins [from, to), fused with the magnitude.
+void splitScalar(const float *re, const float *im, const float *sr, const float *si, int m,
+                 float *out, int from, int to) {
+    for (int k = from; k < to; ++k) {
+        const float ar = re[k], ai = im[k];
+        const float br = re[m - k], bi = im[m - k];
+        const float er = 0.5f * (ar + br), ei = 0.5f * (ai - bi);
+        const float orr = 0.5f * (ai + bi), oi = 0.5f * (br - ar);
+        const float xr = er + sr[k] * orr - si[k] * oi;
+        const float xi = ei + sr[k] * oi + si[k] * orr;
+        out[k] = std::sqrt(xr * xr + xi * xi);
+    }
+}
+
+float peakScalar(const float *x, int count) {
+    float peak = 0.0f;
+    for (int i = 0; i < count; ++i) peak = std::max(peak, x[i]);
+    return peak;
+}
+
+void smoothScalar(float *levels, float *peaks, const float *targets, int count) {
+    for (int i = 0; i < count; ++i) {
+        levels[i] = levels[i] * 0.8f + targets[i] * 0.2f;
+        peaks[i] = levels[i] > peaks[i] ? levels[i] : peaks[i] * 0.97f;
+    }
+}
+
+void crossfadeScalar(const float *outgoing, const float *incoming, const float *outGain, const float *inGain,
+                     float *dst, int count) {
+    for (int i = 0; i < count; ++i) dst[i] = outgoing[i] * outGain[i] + incoming[i] * inGain[i];
+}
+
+void int16ToFloatScalar(const int16_t *src, float scale, float *dst, int count) {
+    for (int i = 0; i < count; ++i) dst[i] = static_cast<float>(src[i]) * scale;
+}
+
+void interleaveStereoScalar(const int32_t *left, const int32_t *right, float scale, float *dst, int count) {
+    for (int i = 0; i < count; ++i) {
+        dst[i * 2] = static_cast<float>(left[i]) * scale;
+        dst[i * 2 + 1] = static_cast<float>(right[i]) * scale;
+    }
+}
+
+void restoreLpcScalar(const int32_t *coefs, int order, int shift, int32_t *samples, int count) {
+    for (int i = order; i < count; ++i) {
+        int32_t sum = 0;
+        for (int j = 0; j < order; ++j) sum += coefs[j] * samples[i - 1 - j];
+        samples[i] += sum >> shift;
+    }
+}
+
+#ifdef APEX_X86_SIMD
+
+APEX_TARGET_SSE2 void stageSse2(float *re, float *im, const float *wr, const float *wi, int n, int halfSpan) {
+    for (int start = 0; start < n; start += halfSpan * 2) {
+        float *ar = re + start, *ai = im + start;
+        float *br = ar + halfSpan, *bi = ai + halfSpan;
+        for (int j = 0; j < halfSpan; j += 4) {
+            const __m128 twr = _mm_loadu_ps(wr + j), twi = _mm_loadu_ps(wi + j);
+            const __m128 xbr = _mm_loadu_ps(br + j), xbi = _mm_loadu_ps(bi + j);
+            const __m128 xar = _mm_loadu_ps(ar + j), xai = _mm_loadu_ps(ai + j);
+            const __m128 tr = _mm_sub_ps(_mm_mul_ps(twr, xbr), _mm_mul_ps(twi, xbi));
+            const __m128 ti = _mm_add_ps(_mm_mul_ps(twr, xbi), _mm_mul_ps(twi, xbr));
+            _mm_storeu_ps(br + j, _mm_sub_ps(xar, tr));
+            _mm_storeu_ps(bi + j, _mm_sub_ps(xai, ti));
+            _mm_storeu_ps(ar + j, _mm_add_ps(xar, tr));
+            _mm_storeu_ps(ai + j, _mm_add_ps(xai, ti));
+        }
+    }
+}
+
+APEX_TARGET_SSE2 void splitSse2(const float *re, const float *im, const float *sr, const float *si, int m,
+                                float *out, int from, int to) {
+    const __m128 halfV = _mm_set1_ps(0.5f);
+    int k = from;
+    // The mirrored operand is loaded from m - k - 3 .. m - k and reversed in register
+    for (; k + 4 <= to && m - k - 3 >= 1; k += 4) {
+        const __m128 ar = _mm_loadu_ps(re + k), ai = _mm_loadu_ps(im + k);
+        const __m128 br = _mm_shuffle_ps(_mm_loadu_ps(re + m - k - 3), _mm_loadu_ps(re + m - k - 3), _MM_SHUFFLE(0, 1, 2, 3));
+        const __m128 bi = _mm_shuffle_ps(_mm_loadu_ps(im + m - k - 3), _mm_loadu_ps(im + m - k - 3), _MM_SHUFFLE(0, 1, 2, 3));
+        const __m128 er = _mm_mul_ps(halfV, _mm_add_ps(ar, br));
+        const __m128 ei = _mm_mul_ps(halfV, _mm_sub_ps(ai, bi));
+        const __m128 orr = _mm_mul_ps(halfV, _mm_add_ps(ai, bi));
+        const __m128 oi = _mm_mul_ps(halfV, _mm_sub_ps(br, ar));
+        const __m128 wr = _mm_loadu_ps(sr + k), wi = _mm_loadu_ps(si + k);
+        const __m128 xr = _mm_add_ps(er, _mm_sub_ps(_mm_mul_ps(wr, orr), _mm_mul_ps(wi, oi)));
+        const __m128 xi = _mm_add_ps(ei, _mm_add_ps(_mm_mul_ps(wr, oi), _mm_mul_ps(wi, orr)));
+        _mm_storeu_ps(out + k, _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(xr, xr), _mm_mul_ps(xi, xi))));
+    }
+    splitScalar(re, im, sr, si, m, out, k, to);
+}
+
+APEX_TARGET_SSE2 float peakSse2(const float *x, int count) {
+    __m128 peak = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 4 <= count; i += 4) peak = _mm_max_ps(peak, _mm_loadu_ps(x + i));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(1, 0, 3, 2)));
+    peak = _mm_max_ps(peak, _mm_shuffle_ps(peak, peak, _MM_SHUFFLE(2, 3, 0, 1)));
+    return std::max(_mm_cvtss_f32(peak), peakScalar(x + i, count - i));
+}
+
+APEX_TARGET_SSE2 void smoothSse2(float *levels, float *peaks, const float *targets, int count) {
+    const __m128 keep = _mm_set1_ps(0.8f), blend = _mm_set1_ps(0.2f), decay = _mm_set1_ps(0.97f);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 level = _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(levels + i), keep),
+                                        _mm_mul_ps(_mm_loadu_ps(targets + i), blend));
+        const __m128 peak = _mm_loadu_ps(peaks + i);
+        const __m128 rising = _mm_cmpgt_ps(level, peak);
+        _mm_storeu_ps(levels + i, level);
+        _mm_storeu_ps(peaks + i, _mm_or_ps(_mm_and_ps(rising, level), _mm_andnot_ps(rising, _mm_mul_ps(peak, decay))));
+    }
+    smoothScalar(levels + i, peaks + i, targets + i, count - i);
+}
+
+APEX_TARGET_SSE2 void crossfadeSse2(const float *outgoing, const float *incoming, const float *outGain,
+                                    const float *inGain, float *dst, int count) {
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 a = _mm_mul_ps(_mm_loadu_ps(outgoing + i), _mm_loadu_ps(outGain + i));
+        const __m128 b = _mm_mul_ps(_mm_loadu_ps(incoming + i), _mm_loadu_ps(inGain + i));
+        _mm_storeu_ps(dst + i, _mm_add_ps(a, b));
+    }
+    crossfadeScalar(outgoing + i, incoming + i, outGain + i, inGain + i, dst + i, count - i);
+}
+
+APEX_TARGET_SSE2 void int16ToFloatSse2(const int16_t *src, float scale, float *dst, int count) {
+    const __m128 scaleV = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+        // Each sample into the top half of a 32-bit lane, then shifted down with its sign
+        const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(x, x), 16);
+        const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(x, x), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scaleV));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scaleV));
+    }
+    int16ToFloatScalar(src + i, scale, dst + i, count - i);
+}
+
+APEX_TARGET_SSE2 void interleaveStereoSse2(const int32_t *left, const int32_t *right, float scale, float *dst, int count) {
+    const __m128 scaleV = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128 l = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(left + i))), scaleV);
+        const __m128 r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(right + i))), scaleV);
+        _mm_storeu_ps(dst + i * 2, _mm_unpacklo_ps(l, r));
+        _mm_storeu_ps(dst + i * 2 + 4, _mm_unpackhi_ps(l, r));
+    }
+    interleaveStereoScalar(left + i, right + i, scale, dst + i * 2, count - i);
+}
+
+APEX_TARGET_AVX2 void stageAvx2(float *re, float *im, const float *wr, const float *wi, int n, int halfSpan) {
+    for (int start = 0; start < n; start += halfSpan * 2) {
+        float *ar = re + start, *ai = im + start;
+        float *br = ar + halfSpan, *bi = ai + halfSpan;
+        for (int j = 0; j < halfSpan; j += 8) {
+            const __m256 twr = _mm256_loadu_ps(wr + j), twi = _mm256_loadu_ps(wi + j);
+            const __m256 xbr = _mm256_loadu_ps(br + j), xbi = _mm256_loadu_ps(bi + j);
+            const __m256 xar = _mm256_loadu_ps(ar + j), xai = _mm256_loadu_ps(ai + j);
+            const __m256 tr = _mm256_fmsub_ps(twr, xbr, _mm256_mul_ps(twi, xbi));
+            const __m256 ti = _mm256_fmadd_ps(twr, xbi, _mm256_mul_ps(twi, xbr));
+            _mm256_storeu_ps(br + j, _mm256_sub_ps(xar, tr));
+            _mm256_storeu_ps(bi + j, _mm256_sub_ps(xai, ti));
+            _mm256_storeu_ps(ar + j, _mm256_add_ps(xar, tr));
+            _mm256_storeu_ps(ai + j, _mm256_add_ps(xai, ti));
+        }
+    }
+}
+
+APEX_TARGET_AVX2 void splitAvx2(const float *re, const float *im, const float *sr, const float *si, int m,
+                                float *out, int from, int to) {
+    const __m256 halfV = _mm256_set1_ps(0.5f);
+    const __m256i reverse = _mm256_set_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    int k = from;
+    for (; k + 8 <= to && m - k - 7 >= 1; k += 8) {
+        const __m256 ar = _mm256_loadu_ps(re + k), ai = _mm256_loadu_ps(im + k);
+        const __m256 br = _mm256_permutevar8x32_ps(_mm256_loadu_ps(re + m - k - 7), reverse);
+        const __m256 bi = _mm256_permutevar8x32_ps(_mm256_loadu_ps(im + m - k - 7), reverse);
+        const __m256 er = _mm256_mul_ps(halfV, _mm256_add_ps(ar, br));
+        const __m256 ei = _mm256_mul_ps(halfV, _mm256_sub_ps(ai, bi));
+        const __m256 orr = _mm256_mul_ps(halfV, _mm256_add_ps(ai, bi));
+        const __m256 oi = _mm256_mul_ps(halfV, _mm256_sub_ps(br, ar));
+        const __m256 wr = _mm256_loadu_ps(sr + k), wi = _mm256_loadu_ps(si + k);
+        const __m256 xr = _mm256_add_ps(er, _mm256_fmsub_ps(wr, orr, _mm256_mul_ps(wi, oi)));
+        const __m256 xi = _mm256_add_ps(ei, _mm256_fmadd_ps(wr, oi, _mm256_mul_ps(wi, orr)));
+        _mm256_storeu_ps(out + k, _mm256_sqrt_ps(_mm256_fmadd_ps(xr, xr, _mm256_mul_ps(xi, xi))));
+    }
+    splitSse2(re, im, sr, si, m, out, k, to);
+}
+
+APEX_TARGET_AVX2 float peakAvx2(const float *x, int count) {
+    __m256 peak = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) peak = _mm256_max_ps(peak, _mm256_loadu_ps(x + i));
+    __m128 folded = _mm_max_ps(_mm256_castps256_ps128(peak), _mm256_extractf128_ps(peak, 1));
+    folded = _mm_max_ps(folded, _mm_shuffle_ps(folded, folded, _MM_SHUFFLE(1, 0, 3, 2)));
+    folded = _mm_max_ps(folded, _mm_shuffle_ps(folded, folded, _MM_SHUFFLE(2, 3, 0, 1)));
+    return std::max(_mm_cvtss_f32(folded), peakSse2(x + i, count - i));
+}
+
+APEX_TARGET_AVX2 void smoothAvx2(float *levels, float *peaks, const float *targets, int count) {
+    const __m256 keep = _mm256_set1_ps(0.8f), blend = _mm256_set1_ps(0.2f), decay = _mm256_set1_ps(0.97f);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 level = _mm256_fmadd_ps(_mm256_loadu_ps(levels + i), keep,
+                                             _mm256_mul_ps(_mm256_loadu_ps(targets + i), blend));
+        const __m256 peak = _mm256_loadu_ps(peaks + i);
+        const __m256 rising = _mm256_cmp_ps(level, peak, _CMP_GT_OQ);
+        _mm256_storeu_ps(levels + i, level);
+        _mm256_storeu_ps(peaks + i, _mm256_blendv_ps(_mm256_mul_ps(peak, decay), level, rising));
+    }
+    smoothSse2(levels + i, peaks + i, targets + i, count - i);
+}
+
+APEX_TARGET_AVX2 void crossfadeAvx2(const float *outgoing, const float *incoming, const float *outGain,
+                                    const float *inGain, float *dst, int count) {
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 b = _mm256_mul_ps(_mm256_loadu_ps(incoming + i), _mm256_loadu_ps(inGain + i));
+        _mm256_storeu_ps(dst + i, _mm256_fmadd_ps(_mm256_loadu_ps(outgoing + i), _mm256_loadu_ps(outGain + i), b));
+    }
+    crossfadeSse2(outgoing + i, incoming + i, outGain + i, inGain + i, dst + i, count - i);
+}
+
+APEX_TARGET_AVX2 void int16ToFloatAvx2(const int16_t *src, float scale, float *dst, int count) {
+    const __m256 scaleV = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i x = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(x), scaleV));
+    }
+    int16ToFloatScalar(src + i, scale, dst + i, count - i);
+}
+
+APEX_TARGET_AVX2 void interleaveStereoAvx2(const int32_t *left, const int32_t *right, float scale, float *dst, int count) {
+    const __m256 scaleV = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256 l = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(left + i))), scaleV);
+        const __m256 r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(right + i))), scaleV);
+        // Unpacking works within 128-bit lanes: frames 0-1 and 4-5 in lo, 2-3 and 6-7 in hi
+        const __m256 lo = _mm256_unpacklo_ps(l, r), hi = _mm256_unpackhi_ps(l, r);
+        _mm256_storeu_ps(dst + i * 2, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(dst + i * 2 + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+    }
+    interleaveStereoSse2(left + i, right + i, scale, dst + i * 2, count - i);
+}
+
+// Each prediction is a dot product with the previous order samples. With the
+// coefficients reversed those samples are contiguous, eight taps per multiply;
+// the samples themselves still have to be restored one after another.
+APEX_TARGET_AVX2 void restoreLpcAvx2(const int32_t *coefs, int order, int shift, int32_t *samples, int count) {
+    if (order < 8) {
+        restoreLpcScalar(coefs, order, shift, samples, count);
+        return;
+    }
+    alignas(32) int32_t reversed[32];
+    for (int j = 0; j < order; ++j) reversed[j] = coefs[order - 1 - j];
+    const int vectorTaps = order & ~7;
+    for (int i = order; i < count; ++i) {
+        const int32_t *history = samples + i - order;
+        __m256i acc = _mm256_setzero_si256();
+        for (int j = 0; j < vectorTaps; j += 8) {
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_load_si256(reinterpret_cast<const __m256i *>(reversed + j)),
+                                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(history + j))));
+        }
+        __m128i folded = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+        folded = _mm_add_epi32(folded, _mm_shuffle_epi32(folded, _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm_add_epi32(folded, _mm_shuffle_epi32(folded, _MM_SHUFFLE(2, 3, 0, 1)));
+        int32_t sum = _mm_cvtsi128_si32(folded);
+        for (int j = vectorTaps; j < order; ++j) sum += reversed[j] * history[j];
+        samples[i] += sum >> shift;
+    }
+}
+
+#endif
+
+struct KernelOps {
+    SpectrumKernel::Isa isa;
+    int width;
+    void (*stage)(float *, float *, const float *, const float *, int, int);
+    void (*split)(const float *, const float *, const float *, const float *, int, float *, int, int);
+    float (*peak)(const float *, int);
+    void (*smooth)(float *, float *, const float *, int);
+    void (*crossfade)(const float *, const float *, const float *, const float *, float *, int);
+    void (*int16ToFloat)(const int16_t *, float, float *, int);
+    void (*interleaveStereo)(const int32_t *, const int32_t *, float, float *, int);
+    void (*restoreLpc)(const int32_t *, int, int, int32_t *, int);
+};
+
+KernelOps detectOps() {
+    KernelOps ops{SpectrumKernel::Scalar, 1, stageScalar, splitScalar, peakScalar, smoothScalar, crossfadeScalar,
+                   int16ToFloatScalar, interleaveStereoScalar, restoreLpcScalar};
+#ifdef APEX_X86_SIMD
+    const char *forced = std::getenv("APEXMUSIC_SIMD");
+    const bool allowSse2 = !forced || std::strcmp(forced, "scalar") != 0;
+    const bool allowAvx2 = allowSse2 && (!forced || std::strcmp(forced, "sse2") != 0);
+    __builtin_cpu_init();
+    if (allowSse2 && __builtin_cpu_supports("sse2")) {
+        // SSE2 has no 32-bit multiply, so prediction stays scalar there
+        ops = {SpectrumKernel::Sse2, 4, stageSse2, splitSse2, peakSse2, smoothSse2, crossfadeSse2,
+               int16ToFloatSse2, interleaveStereoSse2, restoreLpcScalar};
+    }
+    if (allowAvx2 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        ops = {SpectrumKernel::Avx2, 8, stageAvx2, splitAvx2, peakAvx2, smoothAvx2, crossfadeAvx2,
+               int16ToFloatAvx2, interleaveStereoAvx2, restoreLpcAvx2};
+    }
+#endif
+    return ops;
+}
+
+const KernelOps &ops() {
+    static const KernelOps selected = detectOps();
+    return selected;
+}
+
+} // namespace
+
+SpectrumKernel::Isa SpectrumKernel::isa() {
+    return ops().isa;
+}
+
+const char *SpectrumKernel::isaName(Isa isa) {
+    switch (isa) {
+    case Avx2: return "avx2";
+    case Sse2: return "sse2";
+    default: return "scalar";
+    }
+}
+
+void SpectrumKernel::setSize(int size) {
+    n = size;
+    half = size / 2;
+    re.assign(half, 0.0f);
+    im.assign(half, 0.0f);
+
+    int bits = 0;
+    while ((1 << bits) < half) ++bits;
+    reversed.resize(half);
+    for (int i = 0; i < half; ++i) {
+        int r = 0;
+        for (int b = 0; b < bits; ++b) r |= ((i >> b) & 1) << (bits - 1 - b);
+        reversed[i] = r;
+    }
+
+    stageRe.clear();
+    stageIm.clear();
+    for (int halfSpan = 1; halfSpan < half; halfSpan <<= 1) {
+        for (int j = 0; j < halfSpan; ++j) {
+            const double angle = -M_PI * j / halfSpan;
+            stageRe.push_back(static_cast<float>(std::cos(angle)));
+            stageIm.push_back(static_cast<float>(std::sin(angle)));
+        }
+    }
+
+    splitRe.resize(half + 1);
+    splitIm.resize(half + 1);
+    for (int k = 0; k <= half; ++k) {
+        const double angle = -2.0 * M_PI * k / n;
+        splitRe[k] = static_cast<float>(std::cos(angle));
+        splitIm[k] = static_cast<float>(std::sin(angle));
+    }
+}
+
+void SpectrumKernel::magnitudes(const float *input, const float *window, float *out) {
+    const KernelOps &k = ops();
+
+    // Pack even/odd samples as one half-size complex signal, windowed and bit reversed
+    for (int i = 0; i < half; ++i) {
+        const int j = reversed[i];
+        re[j] = input[2 * i] * window[2 * i];
+        im[j] = input[2 * i + 1] * window[2 * i + 1];
+    }
+
+    int twiddle = 0;
+    for (int halfSpan = 1; halfSpan < half; halfSpan <<= 1) {
+        auto stage = halfSpan >= k.width ? k.stage : stageScalar;
+        stage(re.data(), im.data(), stageRe.data() + twiddle, stageIm.data() + twiddle, half, halfSpan);
+        twiddle += halfSpan;
+    }
+
+    out[0] = std::fabs(re[0] + im[0]);
+    out[half] = std::fabs(re[0] - im[0]);
+    k.split(re.data(), im.data(), splitRe.data(), splitIm.data(), half, out, 1, half);
+}
+
+void SpectrumKernel::bandPeaks(const float *spectrum, const int *bandStart, int bandCount, float *out) {
+    const KernelOps &k = ops();
+    for (int b = 0; b < bandCount; ++b) {
+        out[b] = k.peak(spectrum + bandStart[b], bandStart[b + 1] - bandStart[b]);
+    }
+}
+
+void SpectrumKernel::smooth(float *levels, float *peaks, const float *targets, int count) {
+    ops().smooth(levels, peaks, targets, count);
+}
+
+void SpectrumKernel::crossfade(const float *outgoing, const float *incoming, const float *outGain, const float *inGain,
+                               float *dst, int count) {
+    ops().crossfade(outgoing, incoming, outGain, inGain, dst, count);
+}
+
+void SpectrumKernel::int16ToFloat(const int16_t *src, float scale, float *dst, int count) {
+    ops().int16ToFloat(src, scale, dst, count);
+}
+
+void SpectrumKernel::interleaveStereo(const int32_t *left, const int32_t *right, float scale, float *dst, int count) {
+    ops().interleaveStereo(left, right, scale, dst, count);
+}
+
+void SpectrumKernel::restoreLpc(const int32_t *coefs, int order, int shift, int32_t *samples, int count) {
+    ops().restoreLpc(coefs, order, shift, samples, count);
+}
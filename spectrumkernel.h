@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// Vectorized DSP kernels behind the spectrum analyzer: a real-input FFT with
+// fused windowing and magnitude, band peak binning and the level smoothing /
+// peak decay the visualizer applies each frame. The stream engine's crossfade
+// mix and the native decoders' sample conversion and LPC restore live here too,
+// to share the dispatch.
+//
+// The instruction set (AVX2, SSE2 or scalar) is picked once at runtime from the
+// CPU features; APEXMUSIC_SIMD=scalar|sse2|avx2 forces a narrower path.
+class SpectrumKernel {
+public:
+    enum Isa { Scalar, Sse2, Avx2 };
+
+    static Isa isa();
+    static const char *isaName(Isa isa);
+
+    explicit SpectrumKernel(int size = 2048) { setSize(size); }
+
+    void setSize(int size);
+    int size() const { return n; }
+
+    // Applies window to a size-sample frame and writes size/2 + 1 bin magnitudes.
+    void magnitudes(const float *input, const float *window, float *out);
+
+    // out[b] = max(spectrum[bandStart[b] .. bandStart[b + 1]))
+    static void bandPeaks(const float *spectrum, const int *bandStart, int bandCount, float *out);
+
+    // levels = levels * 0.8 + targets * 0.2; peaks follow levels up and decay by 0.97 otherwise.
+    static void smooth(float *levels, float *peaks, const float *targets, int count);
+
+    // dst = outgoing * outGain + incoming * inGain, elementwise; dst may alias either input.
+    static void crossfade(const float *outgoing, const float *incoming, const float *outGain, const float *inGain,
+                          float *dst, int count);
+
+    // dst = src * scale as float, for count 16-bit samples.
+    static void int16ToFloat(const int16_t *src, float scale, float *dst, int count);
+
+    // Interleaves two planar channels into float stereo: dst[2i] = left[i] * scale,
+    // dst[2i + 1] = right[i] * scale. left and right may be the same channel.
+    static void interleaveStereo(const int32_t *left, const int32_t *right, float scale, float *dst, int count);
+
+    // FLAC linear prediction: samples[0, order) are warmup samples and samples[order, count)
+    // hold residuals, replaced in place by residual + (sum coefs[j] * samples[i - 1 - j]) >> shift.
+    // The whole sum must fit in 32 bits; callers with wider streams predict in 64 bits themselves.
+    static void restoreLpc(const int32_t *coefs, int order, int shift, int32_t *samples, int count);
+
+private:
+    int n = 0;
+    int half = 0;
+    std::vector<float> re;
+    std::vector<float> im;
+    // Twiddles of every butterfly stage laid out back to back so each stage reads them contiguously
+    std::vector<float> stageRe;
+    std::vector<float> stageIm;
+    // Twiddles that split the half-size complex transform into the real spectrum
+    std::vector<float> splitRe;
+    std::vector<float> splitIm;
+    std::vector<int> reversed;
+};
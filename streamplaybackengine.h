@@ -0,0 +1,776 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QIODevice>
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QAudioFormat>
+#include <QAudioSink>
+#include <QAudioDevice>
+#include <QMediaDevices>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QUrl>
+#include <QFile>
+#include <QThreadPool>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+#include "lockfree.h"
+#include "playbackengine.h"
+#include "spectrumanalyzer.h"
+#include "spectrumkernel.h"
+#include "seekindex.h"
+#include "nativedecoder.h"
+
+// State shared by the decode thread (producer), the audio device (consumer)
+// and the GUI thread. Everything in the ring is interleaved float stereo at the
+// sink rate, so consecutive tracks splice at an exact frame.
+struct StreamShared {
+    static constexpr quint64 NoBoundary = std::numeric_limits<quint64>::max();
+
+    SpscRingBuffer<float> ring;
+    std::atomic<quint64> framesWritten{0};
+    std::atomic<quint64> framesRead{0};
+    // Ring frame where the next track starts, and that track's serial
+    std::atomic<quint64> boundaryFrame{NoBoundary};
+    std::atomic<quint64> boundarySerial{0};
+    std::atomic<bool> endOfStream{false};
+    std::atomic<bool> endSignalled{false};
+    std::atomic<bool> primed{false};
+    std::atomic<quint64> epoch{0};
+    std::atomic<quint64> underruns{0};
+    std::atomic<quint64> underrunFrames{0};
+    std::atomic<SpectrumAnalyzer *> analyzer{nullptr};
+};
+
+// Producer: runs QAudioDecoder on its own thread and copies its output into
+// the ring. QAudioDecoder only decodes ahead by one buffer until read() is
+// called, so leaving a buffer unread while the ring is full is the
+// backpressure; a short retry timer resumes once the device has drained room.
+// WAV and FLAC files at the sink rate skip QAudioDecoder and are decoded by
+// NativeDecoder right here, one chunk whenever the last one has gone out.
+// When a track ends and a next one is queued, decoding continues into it and
+// the splice point is published as a ring boundary.
+//
+// With a crossfade set, the last fade length of output is held back while a
+// next track is queued. When the track ends, that held tail is mixed with the
+// start of the next track under equal-power gains and only the mix reaches the
+// ring, so the overlap costs one multiply-add per sample and no second ring.
+class StreamDecoder : public QObject {
+    Q_OBJECT
+public:
+    StreamDecoder(StreamShared &shared, const QAudioFormat &format, const SeekIndexCache &seekIndexes)
+    : shared(shared), format(format), seekIndexes(seekIndexes) {}
+
+    // Runs on the decode thread, so the decoder and timer belong to it.
+    void init() {
+        decoder = new QAudioDecoder(this);
+        decoder->setAudioFormat(format);
+        connect(decoder, &QAudioDecoder::bufferReady, this, &StreamDecoder::pump);
+        connect(decoder, &QAudioDecoder::finished, this, [this]() {
+            decodeFinished = true;
+            pump();
+        });
+        connect(decoder, &QAudioDecoder::durationChanged, this, [this](qint64 duration) {
+            // A spliced stream is shorter than the track; its length comes from the index instead
+            if (duration > 0 && !spliced) emit durationKnown(epoch, serial, duration);
+        });
+        connect(decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), this,
+                [this](QAudioDecoder::Error error) { fail(error, decoder->errorString()); });
+        retry = new QTimer(this);
+        retry->setSingleShot(true);
+        retry->setInterval(RetryMs);
+        connect(retry, &QTimer::timeout, this, &StreamDecoder::pump);
+        gainOut.resize(MixChunk);
+        gainIn.resize(MixChunk);
+        mixed.resize(MixChunk);
+    }
+
+    // Starts decoding source, dropping the first skipFrames frames (a seek). gain scales
+    // its samples as they are converted.
+    void open(const QUrl &source, qint64 skipFrames, quint64 openEpoch, float gain) {
+        halt();
+        epoch = openEpoch;
+        startTrack(source, skipFrames, false, gain);
+    }
+
+    void setNext(const QUrl &source, float gain) {
+        next = source;
+        nextGain = gain;
+        if (source.isEmpty()) {
+            // Nothing to fade into any more; let the held tail play out as it is
+            pump();
+            return;
+        }
+        // Pull the head of the file into the page cache now, so a slow disk
+        // has had the whole ring and fade length of playback to catch up
+        const QString path = source.toLocalFile();
+        QThreadPool::globalInstance()->start([path]() {
+            QFile file(path);
+            if (!file.open(QIODevice::ReadOnly)) return;
+            char block[64 * 1024];
+            qint64 total = 0;
+            for (qint64 got; total < PrefetchBytes && (got = file.read(block, sizeof(block))) > 0;) total += got;
+        });
+    }
+
+    // Takes effect from the next track change that is not already fading.
+    void setCrossfade(qint64 frames) {
+        crossfadeFrames = static_cast<size_t>(qMax<qint64>(0, frames));
+        pump();
+    }
+
+    void halt() {
+        if (!decoder) return;
+        retry->stop();
+        decoder->stop();
+        native.reset();
+        active = false;
+        decodeFinished = false;
+        pendingOffset = pendingSamples = 0;
+        holdStart = holdCount = 0;
+        fading = false;
+    }
+
+signals:
+    // The first frames of an opened (not spliced) track are in the ring
+    void loaded(quint64 epoch, quint64 serial);
+    void durationKnown(quint64 epoch, quint64 serial, qint64 durationMs);
+    void failed(quint64 epoch, bool wasNext, QAudioDecoder::Error error, const QString &message);
+
+private:
+    static constexpr int RetryMs = 10;
+    static constexpr size_t MixChunk = 4096;
+    static constexpr qint64 PrefetchBytes = 4 * 1024 * 1024;
+    static constexpr qint64 NativeChunkFrames = 4096;
+
+    void startTrack(const QUrl &source, qint64 skipFrames, bool asNext, float gain) {
+        decoder->stop();
+        // Detach the old device before it goes out of scope; a native decode never hands the decoder a new source
+        std::unique_ptr<SplicedDevice> previous = std::move(spliced);
+        if (previous) decoder->setSourceDevice(nullptr);
+        qint64 knownDurationMs = 0;
+        native = NativeDecoder::open(source.toLocalFile());
+        if (native && native->sampleRate() != format.sampleRate()) native.reset();
+        if (native) {
+            if (skipFrames > 0) {
+                const std::shared_ptr<const SeekIndex> index = seekIndexes.find(source.toLocalFile());
+                skipFrames -= native->seek(skipFrames, index.get());
+            }
+            if (native->totalFrames() > 0) knownDurationMs = native->totalFrames() * 1000 / format.sampleRate();
+        } else if (skipFrames > 0) {
+            if (std::shared_ptr<const SeekIndex> index = seekIndexes.find(source.toLocalFile())) {
+                // Decode from the indexed frame before the target, so only the stretch after it is dropped
+                const quint64 rate = static_cast<quint64>(format.sampleRate());
+                const quint64 target = static_cast<quint64>(skipFrames) * index->sampleRate / rate + index->leadIn;
+                const SeekIndex::Entry &entry = index->entryFor(target);
+                spliced = std::make_unique<SplicedDevice>(source.toLocalFile(), index->headerBytes, entry.offset);
+                if (spliced->isOpen()) {
+                    skipFrames = static_cast<qint64>((target - qMin(target, entry.sample)) * rate / index->sampleRate);
+                    if (index->totalSamples > index->leadIn) {
+                        knownDurationMs = static_cast<qint64>((index->totalSamples - index->leadIn) * 1000 / index->sampleRate);
+                    }
+                } else {
+                    spliced.reset();
+                }
+            }
+        }
+        sampleGain = gain;
+        active = true;
+        decodeFinished = false;
+        announced = false;
+        startedAsNext = asNext;
+        discardSamples = static_cast<size_t>(qMax<qint64>(0, skipFrames)) * 2;
+        pendingOffset = pendingSamples = 0;
+        ++serial;
+        if (knownDurationMs > 0) emit durationKnown(epoch, serial, knownDurationMs);
+        if (native) {
+            // Starting from inside pump() would recurse into it
+            QMetaObject::invokeMethod(this, &StreamDecoder::pump, Qt::QueuedConnection);
+            return;
+        }
+        if (spliced) {
+            decoder->setSourceDevice(spliced.get());
+        } else {
+            decoder->setSource(source);
+        }
+        decoder->start();
+    }
+
+    void pump() {
+        if (holdCount == 0 && !fading && hold.size() != crossfadeFrames * 2) hold.assign(crossfadeFrames * 2, 0.0f);
+        for (;;) {
+            if (pendingOffset >= pendingSamples) {
+                if (!active) break;
+                if (native) {
+                    if (decodeFinished) break;
+                    const qint64 frames = readNative();
+                    if (frames < 0) {
+                        native.reset();
+                        fail(QAudioDecoder::FormatError, tr("The file could not be decoded"));
+                        return;
+                    }
+                    if (frames == 0) {
+                        decodeFinished = true;
+                        break;
+                    }
+                } else {
+                    if (!decoder->bufferAvailable()) break;
+                    convert(decoder->read());
+                }
+                const size_t dropped = qMin(discardSamples, pendingSamples);
+                pendingOffset = dropped;
+                discardSamples -= dropped;
+                continue;
+            }
+            const size_t before = pendingOffset;
+            const bool done = writePending();
+            if (pendingOffset > before && !announced) {
+                announced = true;
+                if (!startedAsNext) emit loaded(epoch, serial);
+            }
+            if (!done) {
+                retry->start();
+                return;
+            }
+        }
+        // Without a next track to fade into, nothing may stay held back
+        if (!holding() && !fading && !drainHold()) {
+            retry->start();
+            return;
+        }
+        if (active && decodeFinished) finishTrack();
+    }
+
+    bool holding() const { return crossfadeFrames > 0 && !next.isEmpty() && !fading; }
+
+    // Moves the pending buffer on towards the ring; false if the ring ran out of room first.
+    bool writePending() {
+        if (fading) {
+            while (holdCount > 0 && pendingOffset < pendingSamples) {
+                const size_t contiguous = qMin(holdCount, hold.size() - holdStart);
+                const size_t count = std::min({contiguous, pendingSamples - pendingOffset, ringRoom(), MixChunk});
+                if (count == 0) return false;
+                mixFade(hold.data() + holdStart, scratch.data() + pendingOffset, count);
+                commit(mixed.data(), count);
+                holdStart = (holdStart + count) % hold.size();
+                holdCount -= count;
+                pendingOffset += count;
+            }
+            if (holdCount == 0) fading = false;
+            if (pendingOffset == pendingSamples) return true;
+        }
+        // Keep the newest capacity samples held; anything older goes out, held samples first
+        const size_t capacity = holding() ? hold.size() : 0;
+        const size_t incoming = pendingSamples - pendingOffset;
+        const size_t excess = holdCount + incoming > capacity ? holdCount + incoming - capacity : 0;
+        const size_t fromHold = qMin(excess, holdCount);
+        if (!drainHold(fromHold)) return false;
+        const size_t direct = excess - fromHold;
+        if (direct > 0) {
+            const size_t count = qMin(direct, ringRoom());
+            commit(scratch.data() + pendingOffset, count);
+            pendingOffset += count;
+            if (count < direct) return false;
+        }
+        while (pendingOffset < pendingSamples) {
+            const size_t tail = (holdStart + holdCount) % hold.size();
+            const size_t count = qMin(pendingSamples - pendingOffset, hold.size() - tail);
+            std::memcpy(hold.data() + tail, scratch.data() + pendingOffset, count * sizeof(float));
+            holdCount += count;
+            pendingOffset += count;
+        }
+        return true;
+    }
+
+    // Writes up to limit of the oldest held samples to the ring; true once that many are out.
+    bool drainHold(size_t limit = std::numeric_limits<size_t>::max()) {
+        limit = qMin(limit, holdCount);
+        while (limit > 0) {
+            const size_t count = std::min({limit, hold.size() - holdStart, ringRoom()});
+            if (count == 0) return false;
+            commit(hold.data() + holdStart, count);
+            holdStart = (holdStart + count) % hold.size();
+            holdCount -= count;
+            limit -= count;
+        }
+        return true;
+    }
+
+    // Whole frames only, so the ring indices stay on frame boundaries
+    size_t ringRoom() const { return shared.ring.writeAvailable() & ~size_t(1); }
+
+    void commit(const float *samples, size_t count) {
+        const size_t written = shared.ring.write(samples, count);
+        shared.framesWritten.fetch_add(written / 2, std::memory_order_relaxed);
+    }
+
+    // Equal-power gains: outgoing cos, incoming sin of a quarter turn across the fade.
+    // Each chunk starts from an exact angle and rotates per frame, so nothing drifts.
+    void mixFade(const float *outgoing, const float *incoming, size_t count) {
+        const double step = M_PI / 2 / static_cast<double>(fadeLength);
+        const double start = step * (static_cast<double>(fadePosition) + 0.5);
+        double c = std::cos(start), s = std::sin(start);
+        const double cs = std::cos(step), ss = std::sin(step);
+        for (size_t i = 0; i < count; i += 2) {
+            gainOut[i] = gainOut[i + 1] = static_cast<float>(c);
+            gainIn[i] = gainIn[i + 1] = static_cast<float>(s);
+            const double rotated = c * cs - s * ss;
+            s = s * cs + c * ss;
+            c = rotated;
+        }
+        SpectrumKernel::crossfade(outgoing, incoming, gainOut.data(), gainIn.data(), mixed.data(), static_cast<int>(count));
+        fadePosition += count / 2;
+    }
+
+    void finishTrack() {
+        if (!next.isEmpty()) {
+            const QUrl source = next;
+            next.clear();
+            // With a held tail the next track starts where the fade does
+            const quint64 boundary = shared.framesWritten.load(std::memory_order_relaxed);
+            if (holdCount > 0) {
+                fading = true;
+                fadeLength = holdCount / 2;
+                fadePosition = 0;
+            }
+            startTrack(source, 0, true, nextGain);
+            shared.boundarySerial.store(serial, std::memory_order_relaxed);
+            shared.boundaryFrame.store(boundary, std::memory_order_release);
+            return;
+        }
+        active = false;
+        shared.endOfStream.store(true, std::memory_order_release);
+    }
+
+    void fail(QAudioDecoder::Error error, const QString &message) {
+        const bool wasNext = startedAsNext && !announced;
+        if (wasNext) {
+            // The current track still plays out; its held tail goes out unfaded and then it ends
+            shared.boundaryFrame.store(StreamShared::NoBoundary, std::memory_order_release);
+            fading = false;
+            decodeFinished = true;
+            pendingOffset = pendingSamples = 0;
+            emit failed(epoch, wasNext, error, message);
+            pump();
+            return;
+        }
+        active = false;
+        emit failed(epoch, wasNext, error, message);
+    }
+
+    // Decodes the next chunk straight into scratch; frames as NativeDecoder::read() counts them.
+    qint64 readNative() {
+        if (scratch.size() < static_cast<size_t>(NativeChunkFrames) * 2) scratch.resize(NativeChunkFrames * 2);
+        const qint64 frames = native->read(scratch.data(), NativeChunkFrames, sampleGain);
+        pendingSamples = frames > 0 ? static_cast<size_t>(frames) * 2 : 0;
+        return frames;
+    }
+
+    void convert(const QAudioBuffer &buffer) {
+        const QAudioFormat bufferFormat = buffer.format();
+        const int channels = bufferFormat.channelCount();
+        const qsizetype frames = buffer.frameCount();
+        pendingSamples = 0;
+        if (channels <= 0 || frames <= 0) return;
+        if (scratch.size() < static_cast<size_t>(frames) * 2) scratch.resize(frames * 2);
+        switch (bufferFormat.sampleFormat()) {
+        case QAudioFormat::Float:
+            if (channels == 2 && sampleGain == 1.0f) {
+                std::memcpy(scratch.data(), buffer.constData<float>(), frames * 2 * sizeof(float));
+            } else {
+                toStereo(buffer.constData<float>(), frames, channels, sampleGain);
+            }
+            break;
+        case QAudioFormat::Int16:
+            toStereo(buffer.constData<qint16>(), frames, channels, sampleGain / 32768.0f);
+            break;
+        case QAudioFormat::Int32:
+            toStereo(buffer.constData<qint32>(), frames, channels, sampleGain / 2147483648.0f);
+            break;
+        default:
+            return;
+        }
+        pendingSamples = static_cast<size_t>(frames) * 2;
+    }
+
+    // Mono is duplicated; beyond two channels only front left/right are kept.
+    template <typename Sample>
+    void toStereo(const Sample *data, qsizetype frames, int channels, float scale) {
+        const int right = channels > 1 ? 1 : 0;
+        for (qsizetype i = 0; i < frames; ++i) {
+            scratch[i * 2] = static_cast<float>(data[i * channels]) * scale;
+            scratch[i * 2 + 1] = static_cast<float>(data[i * channels + right]) * scale;
+        }
+    }
+
+    StreamShared &shared;
+    QAudioFormat format;
+    const SeekIndexCache &seekIndexes;
+    std::unique_ptr<SplicedDevice> spliced;
+    std::unique_ptr<NativeDecoder> native;
+    QAudioDecoder *decoder = nullptr;
+    QTimer *retry = nullptr;
+    QUrl next;
+    float sampleGain = 1.0f;
+    float nextGain = 1.0f;
+    quint64 epoch = 0;
+    quint64 serial = 0;
+    bool active = false;
+    bool decodeFinished = false;
+    bool announced = false;
+    bool startedAsNext = false;
+    size_t discardSamples = 0;
+    std::vector<float> scratch;
+    size_t pendingOffset = 0;
+    size_t pendingSamples = 0;
+    // Circular hold-back of the newest output while a fade may follow
+    size_t crossfadeFrames = 0;
+    std::vector<float> hold;
+    size_t holdStart = 0;
+    size_t holdCount = 0;
+    bool fading = false;
+    size_t fadeLength = 0;
+    size_t fadePosition = 0;
+    std::vector<float> gainOut;
+    std::vector<float> gainIn;
+    std::vector<float> mixed;
+};
+
+// Consumer: the pull-mode device QAudioSink reads from. Never blocks and never
+// allocates once warmed up; a short read is padded with silence and counted as
+// an underrun unless the stream has simply ended.
+class StreamDevice : public QIODevice {
+    Q_OBJECT
+public:
+    StreamDevice(StreamShared &shared, int sampleRate, QObject *parent)
+    : QIODevice(parent), shared(shared), sampleRate(sampleRate) {}
+
+    bool isSequential() const override { return true; }
+
+signals:
+    // Emitted on the audio thread; connect with a queued connection
+    void boundaryCrossed(quint64 epoch, quint64 serial, quint64 frame, quint64 gapFrames);
+    void endReached(quint64 epoch);
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override {
+        const size_t samples = static_cast<size_t>(maxlen / FrameBytes) * 2;
+        if (samples == 0) return 0;
+        float *out = reinterpret_cast<float *>(data);
+        const size_t got = shared.ring.read(out, samples);
+        size_t missing = 0;
+        if (got > 0) shared.primed.store(true, std::memory_order_relaxed);
+        if (got < samples) {
+            std::memset(out + got, 0, (samples - got) * sizeof(float));
+            if (shared.endOfStream.load(std::memory_order_acquire) && shared.ring.readAvailable() == 0) {
+                if (!shared.endSignalled.exchange(true)) emit endReached(shared.epoch.load(std::memory_order_relaxed));
+            } else if (shared.primed.load(std::memory_order_relaxed)) {
+                missing = (samples - got) / 2;
+                shared.underruns.fetch_add(1, std::memory_order_relaxed);
+                shared.underrunFrames.fetch_add(missing, std::memory_order_relaxed);
+            }
+        }
+        const quint64 read = shared.framesRead.fetch_add(got / 2, std::memory_order_relaxed) + got / 2;
+        quint64 boundary = shared.boundaryFrame.load(std::memory_order_acquire);
+        if (boundary != StreamShared::NoBoundary && read >= boundary
+            && shared.boundaryFrame.compare_exchange_strong(boundary, StreamShared::NoBoundary)) {
+            emit boundaryCrossed(shared.epoch.load(std::memory_order_relaxed),
+                                 shared.boundarySerial.load(std::memory_order_relaxed), boundary, missing);
+        }
+        if (SpectrumAnalyzer *analyzer = shared.analyzer.load(std::memory_order_acquire)) {
+            const size_t frames = got / 2;
+            if (mono.size() < frames) mono.resize(frames);
+            for (size_t i = 0; i < frames; ++i) mono[i] = 0.5f * (out[i * 2] + out[i * 2 + 1]);
+            analyzer->pushSamples(mono.data(), static_cast<qsizetype>(frames), sampleRate);
+        }
+        return static_cast<qint64>(samples / 2) * FrameBytes;
+    }
+
+    qint64 writeData(const char *, qint64) override { return -1; }
+
+private:
+    static constexpr qint64 FrameBytes = 2 * sizeof(float);
+
+    StreamShared &shared;
+    int sampleRate;
+    std::vector<float> mono;
+};
+
+// PlaybackEngine that owns the whole path: QAudioDecoder on a worker thread
+// -> lock-free ring -> pull-mode QAudioSink. The ring holds bufferMs of audio
+// and the sink is asked for latencyMs of device buffering. A queued next track
+// is decoded straight after the current one into the same ring, so the track
+// change is sample accurate, and a crossfade is mixed on the decode thread
+// before it reaches the ring. Track gains are applied during conversion and
+// may boost as well as cut. Seeks restart the decoder and drop frames up to
+// the target; for MP3 and FLAC a seek index built in the background lets
+// the decoder start at the frame just before it instead of the file start.
+// WAV and FLAC at the sink rate are decoded natively instead of through the
+// multimedia backend.
+class StreamPlaybackEngine : public PlaybackEngine {
+    Q_OBJECT
+public:
+    static constexpr int DefaultBufferMs = 2000;
+    static constexpr int DefaultLatencyMs = 100;
+
+    struct StreamStats {
+        quint64 underruns;
+        quint64 underrunFrames;
+        qsizetype bufferedFrames;
+        qsizetype capacityFrames;
+    };
+
+    explicit StreamPlaybackEngine(int bufferMs = DefaultBufferMs, int latencyMs = DefaultLatencyMs, QObject *parent = nullptr)
+    : PlaybackEngine(parent) {
+        const QAudioDevice output = QMediaDevices::defaultAudioOutput();
+        // Float stereo is what desktop mixers run at anyway, and it is what the ring holds
+        format = output.preferredFormat();
+        format.setSampleFormat(QAudioFormat::Float);
+        format.setChannelCount(2);
+        if (format.sampleRate() <= 0) format.setSampleRate(48000);
+        shared.ring.reset(static_cast<size_t>(format.sampleRate()) * qMax(100, bufferMs) / 1000 * 2);
+
+        decoder = new StreamDecoder(shared, format, seekIndexes);
+        decoder->moveToThread(&decodeThread);
+        decodeThread.setObjectName("StreamDecoder");
+        decodeThread.start();
+        QMetaObject::invokeMethod(decoder, &StreamDecoder::init, Qt::QueuedConnection);
+        connect(decoder, &StreamDecoder::loaded, this, &StreamPlaybackEngine::handleLoaded);
+        connect(decoder, &StreamDecoder::durationKnown, this, [this](quint64 epoch, quint64 serial, qint64 durationMs) {
+            if (epoch == currentEpoch) durations.insert(serial, durationMs);
+        });
+        connect(decoder, &StreamDecoder::failed, this, &StreamPlaybackEngine::handleFailed);
+
+        device = new StreamDevice(shared, format.sampleRate(), this);
+        device->open(QIODevice::ReadOnly);
+        connect(device, &StreamDevice::boundaryCrossed, this, &StreamPlaybackEngine::handleBoundary, Qt::QueuedConnection);
+        connect(device, &StreamDevice::endReached, this, &StreamPlaybackEngine::handleEnd, Qt::QueuedConnection);
+
+        sink = new QAudioSink(output, format, this);
+        sink->setBufferSize(static_cast<qsizetype>(format.bytesForDuration(qMax(10, latencyMs) * 1000)));
+        connect(sink, &QAudioSink::stateChanged, this, [this](QAudio::State) {
+            if (sink->error() == QAudio::OpenError || sink->error() == QAudio::FatalError) {
+                emit errorOccurred(QMediaPlayer::ResourceError, tr("Audio output failed"));
+            }
+        });
+    }
+
+    ~StreamPlaybackEngine() {
+        sink->stop();
+        QMetaObject::invokeMethod(decoder, &StreamDecoder::halt, Qt::BlockingQueuedConnection);
+        decodeThread.quit();
+        decodeThread.wait();
+        delete decoder;
+    }
+
+    StreamStats streamStats() const {
+        const qsizetype buffered = static_cast<qsizetype>(shared.framesWritten.load(std::memory_order_relaxed)
+                                                          - shared.framesRead.load(std::memory_order_relaxed));
+        return {shared.underruns.load(std::memory_order_relaxed), shared.underrunFrames.load(std::memory_order_relaxed),
+                buffered, static_cast<qsizetype>(shared.ring.capacity() / 2)};
+    }
+
+    void setSource(const QUrl &source) override {
+        current = source;
+        next.clear();
+        durations.clear();
+        seeking = false;
+        seekIndexes.prepare(source.toLocalFile());
+        loaded = false;
+        currentGain = trackGain(source);
+        QMetaObject::invokeMethod(decoder, [this]() { decoder->setNext(QUrl(), 1.0f); }, Qt::QueuedConnection);
+        setState(QMediaPlayer::StoppedState);
+        if (source.isEmpty()) {
+            restart(-1);
+            emit mediaStatusChanged(QMediaPlayer::NoMedia);
+            return;
+        }
+        measuringCold = endedAt.isValid() && endedAt.elapsed() < ColdChangeWindowMs;
+        endedAt.invalidate();
+        emit mediaStatusChanged(QMediaPlayer::LoadingMedia);
+        restart(0);
+    }
+
+    QUrl source() const override { return current; }
+
+    void setNextSource(const QUrl &source) override {
+        next = source;
+        nextGain = trackGain(source);
+        seekIndexes.prepare(source.toLocalFile());
+        const float gain = nextGain;
+        QMetaObject::invokeMethod(decoder, [this, source, gain]() { decoder->setNext(source, gain); }, Qt::QueuedConnection);
+    }
+
+    QUrl nextSource() const override { return next; }
+
+    void play() override {
+        if (current.isEmpty() || state == QMediaPlayer::PlayingState) return;
+        // Like QMediaPlayer, play after the end starts over
+        if (atEnd) restart(0);
+        if (state == QMediaPlayer::PausedState && sink->state() == QAudio::SuspendedState) {
+            sink->resume();
+        } else {
+            sink->start(device);
+        }
+        setState(QMediaPlayer::PlayingState);
+    }
+
+    void pause() override {
+        if (current.isEmpty() || state == QMediaPlayer::PausedState) return;
+        if (state == QMediaPlayer::PlayingState) sink->suspend();
+        setState(QMediaPlayer::PausedState);
+    }
+
+    void stop() override {
+        if (state == QMediaPlayer::StoppedState) return;
+        setState(QMediaPlayer::StoppedState);
+        restart(0);
+    }
+
+    void setPosition(qint64 position) override {
+        if (current.isEmpty()) return;
+        position = qMax<qint64>(0, position);
+        restart(position);
+        seeking = true;
+        emit positionChanged(position);
+    }
+
+    qint64 position() const override {
+        if (!loaded) return 0;
+        qint64 buffered = 0;
+        if (sink->state() != QAudio::StoppedState) {
+            buffered = (sink->bufferSize() - sink->bytesFree()) / format.bytesPerFrame();
+        }
+        const qint64 played = static_cast<qint64>(shared.framesRead.load(std::memory_order_relaxed)) - buffered - originFrame;
+        return qMax<qint64>(0, played * 1000 / format.sampleRate());
+    }
+
+    qint64 duration() const override { return durations.value(currentSerial, 0); }
+    QMediaPlayer::PlaybackState playbackState() const override { return state; }
+
+    void setAnalyzer(SpectrumAnalyzer *analyzer) override {
+        shared.analyzer.store(analyzer, std::memory_order_release);
+    }
+
+    void setCrossfade(int ms) override {
+        const qint64 frames = static_cast<qint64>(qMax(0, ms)) * format.sampleRate() / 1000;
+        QMetaObject::invokeMethod(decoder, [this, frames]() { decoder->setCrossfade(frames); }, Qt::QueuedConnection);
+    }
+
+private:
+    static constexpr qint64 ColdChangeWindowMs = 100;
+
+    // Stops both ends, empties the ring and, unless startMs is negative, reopens
+    // the current source at startMs. The sink only runs again if playing.
+    void restart(qint64 startMs) {
+        sink->stop();
+        QMetaObject::invokeMethod(decoder, &StreamDecoder::halt, Qt::BlockingQueuedConnection);
+        // Neither side is running now, so the GUI thread may act as the consumer
+        shared.framesRead.fetch_add(shared.ring.skip(shared.ring.readAvailable()) / 2, std::memory_order_relaxed);
+        shared.boundaryFrame.store(StreamShared::NoBoundary, std::memory_order_relaxed);
+        shared.endOfStream.store(false, std::memory_order_relaxed);
+        shared.endSignalled.store(false, std::memory_order_relaxed);
+        shared.primed.store(false, std::memory_order_relaxed);
+        shared.epoch.store(++currentEpoch, std::memory_order_relaxed);
+        atEnd = false;
+        if (startMs < 0) return;
+        const qint64 startFrames = startMs * format.sampleRate() / 1000;
+        originFrame = static_cast<qint64>(shared.framesRead.load(std::memory_order_relaxed)) - startFrames;
+        const QUrl source = current;
+        const quint64 epoch = currentEpoch;
+        const float gain = currentGain;
+        QMetaObject::invokeMethod(decoder, [this, source, startFrames, epoch, gain]() {
+            decoder->open(source, startFrames, epoch, gain);
+        }, Qt::QueuedConnection);
+        if (state == QMediaPlayer::PlayingState) sink->start(device);
+    }
+
+    void setState(QMediaPlayer::PlaybackState newState) {
+        if (state == newState) return;
+        state = newState;
+        emit playbackStateChanged(state);
+    }
+
+    void handleLoaded(quint64 epoch, quint64 serial) {
+        if (epoch != currentEpoch) return;
+        // A seek reopens the same file, which may not report its duration again
+        if (!durations.contains(serial) && durations.contains(currentSerial)) {
+            durations.insert(serial, durations.value(currentSerial));
+        }
+        currentSerial = serial;
+        if (seeking) {
+            seeking = false;
+            emit seekFinished();
+        }
+        if (loaded) return;
+        loaded = true;
+        if (measuringCold) {
+            measuringCold = false;
+            recordGap(false, gapTimer.nsecsElapsed() / 1000);
+        }
+        emit mediaStatusChanged(QMediaPlayer::LoadedMedia);
+    }
+
+    void handleFailed(quint64 epoch, bool wasNext, QAudioDecoder::Error error, const QString &message) {
+        if (epoch != currentEpoch) return;
+        if (wasNext) {
+            // The failed track is dropped, not retried: the current one plays out to EndOfMedia
+            // and the widget picks what plays after it, as if nothing had been primed
+            next.clear();
+            return;
+        }
+        emit errorOccurred(error == QAudioDecoder::FormatError ? QMediaPlayer::FormatError : QMediaPlayer::ResourceError, message);
+    }
+
+    void handleBoundary(quint64 epoch, quint64 serial, quint64 frame, quint64 gapFrames) {
+        if (epoch != currentEpoch) return;
+        originFrame = static_cast<qint64>(frame);
+        currentSerial = serial;
+        current = next;
+        currentGain = nextGain;
+        next.clear();
+        recordGap(true, static_cast<qint64>(gapFrames) * 1000000 / format.sampleRate());
+        emit trackAdvanced(current);
+    }
+
+    void handleEnd(quint64 epoch) {
+        if (epoch != currentEpoch) return;
+        sink->stop();
+        atEnd = true;
+        gapTimer.start();
+        endedAt.start();
+        setState(QMediaPlayer::StoppedState);
+        emit mediaStatusChanged(QMediaPlayer::EndOfMedia);
+    }
+
+    StreamShared shared;
+    QAudioFormat format;
+    SeekIndexCache seekIndexes;
+    QThread decodeThread;
+    StreamDecoder *decoder;
+    StreamDevice *device;
+    QAudioSink *sink;
+    QUrl current;
+    QUrl next;
+    float currentGain = 1.0f;
+    float nextGain = 1.0f;
+    QMediaPlayer::PlaybackState state = QMediaPlayer::StoppedState;
+    quint64 currentEpoch = 0;
+    quint64 currentSerial = 0;
+    QHash<quint64, qint64> durations;
+    qint64 originFrame = 0;
+    bool loaded = false;
+    bool atEnd = false;
+    bool measuringCold = false;
+    bool seeking = false;
+    QElapsedTimer gapTimer;
+    QElapsedTimer endedAt;
+};
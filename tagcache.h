@@ -0,0 +1,686 @@
+#pragma once
+
+#include <QObject>
+#include <QThread>
+#include <QThreadPool>
+#include <QTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QHash>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+#include <QBuffer>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include <atomic>
+#include <cstring>
+#include "seekindex.h"
+#include "sourcestamp.h"
+
+struct TrackTags {
+    QString title;
+    QString artist;
+    QString album;
+    qint64 durationMs = 0;
+};
+
+// Reads title, artist, album and duration from a file's own metadata: ID3v2
+// (plus ID3v1 as a fallback) and the MP3 frame headers, FLAC and Ogg
+// Vorbis/Opus comments, MP4 ilst atoms and RIFF INFO chunks. Only the tag
+// structures are read; audio data is seeked past, and so are embedded
+// pictures unless the caller asks for the cover.
+class TagReader {
+public:
+    // False only when the file cannot be opened; a file without tags reads as empty tags.
+    // With picture set, the encoded bytes of the embedded cover (ID3 APIC, FLAC PICTURE or
+    // MP4 covr, the front cover when there are several) are returned in it as well.
+    static bool read(const QString &path, TrackTags &tags, QByteArray *picture = nullptr) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        const QByteArray head = file.read(12);
+        if (head.size() < 12) return true;
+        const auto *bytes = reinterpret_cast<const uchar *>(head.constData());
+        if (std::memcmp(bytes, "ID3", 3) == 0 || std::memcmp(bytes, "fLaC", 4) == 0) {
+            int pictureType = -1;
+            const qint64 audioStart = readId3(file, tags, picture, pictureType);
+            if (file.seek(audioStart) && file.read(4) == "fLaC") {
+                readFlac(file, audioStart + 4, tags, picture, pictureType);
+            } else {
+                readMp3(file, audioStart, tags);
+            }
+        } else if (std::memcmp(bytes, "OggS", 4) == 0) {
+            readOgg(file, tags);
+        } else if (std::memcmp(bytes + 4, "ftyp", 4) == 0) {
+            readMp4(file, 0, file.size(), tags, picture);
+        } else if (std::memcmp(bytes, "RIFF", 4) == 0 && std::memcmp(bytes + 8, "WAVE", 4) == 0) {
+            readWav(file, tags);
+        } else {
+            readMp3(file, 0, tags);
+        }
+        return true;
+    }
+
+private:
+    // Anything larger than this is a picture or corrupt, never a text frame worth reading
+    static constexpr qint64 MaxTextBytes = 64 * 1024;
+    static constexpr qint64 MaxBlockBytes = 1024 * 1024;
+    static constexpr qint64 MaxPictureBytes = 16 * 1024 * 1024;
+    static constexpr int FrontCover = 3;
+    static constexpr qint64 MaxUnsyncTagBytes = 16 * 1024 * 1024;
+    static constexpr qint64 Mp3ProbeBytes = 64 * 1024;
+
+    static void keep(QString &field, const QString &value) {
+        if (field.isEmpty()) field = value.trimmed();
+    }
+
+    // The first picture wins until a front cover turns up
+    static void keepPicture(QByteArray *picture, int &keptType, int type, const QByteArray &data) {
+        if (data.isEmpty() || keptType == FrontCover || (keptType >= 0 && type != FrontCover)) return;
+        *picture = data;
+        keptType = type;
+    }
+
+    static quint32 syncsafe(const uchar *p) {
+        return (quint32(p[0] & 0x7f) << 21) | (quint32(p[1] & 0x7f) << 14) | (quint32(p[2] & 0x7f) << 7) | (p[3] & 0x7f);
+    }
+
+    static QByteArray removeUnsync(const QByteArray &bytes) {
+        QByteArray out;
+        out.reserve(bytes.size());
+        for (qsizetype i = 0; i < bytes.size(); ++i) {
+            out.append(bytes[i]);
+            if (uchar(bytes[i]) == 0xff && i + 1 < bytes.size() && bytes[i + 1] == 0) ++i;
+        }
+        return out;
+    }
+
+    // An ID3v2 text frame body: encoding byte, then the first of possibly several values.
+    static QString id3Text(const QByteArray &body) {
+        if (body.isEmpty()) return QString();
+        const uchar encoding = uchar(body[0]);
+        const QByteArray text = body.mid(1);
+        if (encoding == 1 || encoding == 2) {
+            bool bigEndian = encoding == 2;
+            qsizetype at = 0;
+            if (text.size() >= 2 && uchar(text[0]) == 0xff && uchar(text[1]) == 0xfe) at = 2;
+            else if (text.size() >= 2 && uchar(text[0]) == 0xfe && uchar(text[1]) == 0xff) at = 2, bigEndian = true;
+            QString value;
+            for (; at + 1 < text.size(); at += 2) {
+                const auto *unit = reinterpret_cast<const uchar *>(text.constData() + at);
+                const char16_t code = bigEndian ? qFromBigEndian<quint16>(unit) : qFromLittleEndian<quint16>(unit);
+                if (code == 0) break;
+                value.append(QChar(code));
+            }
+            return value;
+        }
+        const qsizetype end = text.indexOf('\0');
+        const QByteArray value = end < 0 ? text : text.left(end);
+        return encoding == 3 ? QString::fromUtf8(value) : QString::fromLatin1(value);
+    }
+
+    // An APIC (or ID3v2.2 PIC) body: encoding, MIME type or 3-letter format, picture type,
+    // a description terminated in the frame's encoding, then the image.
+    static void id3Picture(const QByteArray &body, bool v22, QByteArray *picture, int &keptType) {
+        if (body.size() < 2) return;
+        const uchar encoding = uchar(body[0]);
+        qsizetype at = v22 ? 4 : body.indexOf('\0', 1) + 1;
+        if (at <= 0 || at >= body.size()) return;
+        const int type = uchar(body[at++]);
+        if (encoding == 1 || encoding == 2) {
+            while (at + 1 < body.size() && (body[at] != '\0' || body[at + 1] != '\0')) at += 2;
+            at += 2;
+        } else {
+            at = body.indexOf('\0', at) + 1;
+            if (at <= 0) return;
+        }
+        if (at < body.size()) keepPicture(picture, keptType, type, body.mid(at));
+    }
+
+    // Reads the ID3v2 tag at the start of file, if any, and returns where the audio begins.
+    static qint64 readId3(QFile &file, TrackTags &tags, QByteArray *picture, int &pictureType) {
+        if (!file.seek(0)) return 0;
+        const QByteArray header = file.read(10);
+        if (header.size() < 10 || !header.startsWith("ID3")) return 0;
+        const auto *h = reinterpret_cast<const uchar *>(header.constData());
+        const int version = h[3];
+        const int flags = h[5];
+        const qint64 tagSize = syncsafe(h + 6);
+        const qint64 end = 10 + tagSize + ((flags & 0x10) ? 10 : 0);
+        // In ID3v2.2 the 0x40 flag marks a compressed tag, a scheme that was never defined
+        if (version < 2 || version > 4 || (version == 2 && (flags & 0x40))) return end;
+
+        // Whole-tag unsynchronisation hides the frame boundaries, so such a tag is read in
+        // full and undone in memory; otherwise frames are read one by one from the file.
+        QBuffer unsynced;
+        QIODevice *device = &file;
+        qint64 at = 10, limit = 10 + tagSize;
+        if ((flags & 0x80) && version < 4) {
+            if (tagSize > MaxUnsyncTagBytes) return end;
+            unsynced.setData(removeUnsync(file.read(tagSize)));
+            unsynced.open(QIODevice::ReadOnly);
+            device = &unsynced;
+            at = 0;
+            limit = unsynced.size();
+        }
+        if (flags & 0x40) {
+            if (!device->seek(at)) return end;
+            const QByteArray extended = device->read(4);
+            if (extended.size() < 4) return end;
+            const auto *e = reinterpret_cast<const uchar *>(extended.constData());
+            at += version == 4 ? syncsafe(e) : qFromBigEndian<quint32>(e) + 4;
+        }
+
+        const int idLength = version == 2 ? 3 : 4;
+        const int headerLength = version == 2 ? 6 : 10;
+        while (at + headerLength <= limit && device->seek(at)) {
+            const QByteArray frame = device->read(headerLength);
+            if (frame.size() < headerLength || frame[0] == '\0') break;
+            const auto *f = reinterpret_cast<const uchar *>(frame.constData());
+            qint64 size;
+            int formatFlags = 0;
+            if (version == 2) size = (qint64(f[3]) << 16) | (qint64(f[4]) << 8) | f[5];
+            else if (version == 3) size = qFromBigEndian<quint32>(f + 4);
+            else size = syncsafe(f + 4);
+            // Mapped onto the ID3v2.4 bits: grouping 0x40, compression 0x08, encryption 0x04
+            if (version == 3) formatFlags = (f[9] & 0x20 ? 0x40 : 0) | (f[9] & 0x80 ? 0x08 : 0) | (f[9] & 0x40 ? 0x04 : 0);
+            if (version == 4) formatFlags = f[9];
+            const QByteArray id = frame.left(idLength);
+            at += headerLength + size;
+            QString *field = nullptr;
+            bool length = false;
+            if (id == "TIT2" || id == "TT2") field = &tags.title;
+            else if (id == "TPE1" || id == "TP1") field = &tags.artist;
+            else if (id == "TALB" || id == "TAL") field = &tags.album;
+            else if (id == "TLEN" || id == "TLE") length = true;
+            const bool image = picture && (id == "APIC" || id == "PIC");
+            // Compressed and encrypted frames are not worth the trouble for a label
+            if ((!field && !length && !image) || size <= 0 || size > (image ? MaxPictureBytes : MaxTextBytes)
+                || (formatFlags & 0x0c)) {
+                continue;
+            }
+            QByteArray body = device->read(size);
+            if (formatFlags & 0x40) body = body.mid(1);
+            if (formatFlags & 0x01) body = body.mid(4);
+            if (formatFlags & 0x02) body = removeUnsync(body);
+            if (image) {
+                id3Picture(body, version == 2, picture, pictureType);
+                continue;
+            }
+            const QString text = id3Text(body);
+            if (field) keep(*field, text);
+            else if (tags.durationMs <= 0) tags.durationMs = text.toLongLong();
+        }
+        return end;
+    }
+
+    // Duration from the Xing/Info frame count when there is one, else from the first
+    // frame's bitrate, which is exact for constant bitrate files. ID3v1 fills in missing text.
+    static void readMp3(QFile &file, qint64 audioStart, TrackTags &tags) {
+        qint64 audioEnd = file.size();
+        if (audioEnd >= 128 && file.seek(audioEnd - 128)) {
+            const QByteArray v1 = file.read(128);
+            if (v1.startsWith("TAG")) {
+                audioEnd -= 128;
+                const auto field = [&v1](int offset) {
+                    const QByteArray raw = v1.mid(offset, 30);
+                    const qsizetype end = raw.indexOf('\0');
+                    return QString::fromLatin1(end < 0 ? raw : raw.left(end));
+                };
+                keep(tags.title, field(3));
+                keep(tags.artist, field(33));
+                keep(tags.album, field(63));
+            }
+        }
+        if (tags.durationMs > 0 || !file.seek(audioStart)) return;
+        const QByteArray probe = file.read(Mp3ProbeBytes);
+        const auto *data = reinterpret_cast<const uchar *>(probe.constData());
+        SeekIndex::Mp3Frame frame{}, following{};
+        for (qsizetype at = 0; at + 4 <= probe.size(); ++at) {
+            if (!SeekIndex::parseMp3Header(data + at, frame)) continue;
+            const qsizetype end = at + frame.length;
+            if (end + 4 <= probe.size() && !SeekIndex::parseMp3Header(data + end, following)) continue;
+            const int sideInfo = frame.version == 3 ? (frame.mono ? 17 : 32) : (frame.mono ? 9 : 17);
+            const qsizetype tag = at + 4 + sideInfo;
+            if (tag + 12 <= probe.size() && (std::memcmp(data + tag, "Xing", 4) == 0 || std::memcmp(data + tag, "Info", 4) == 0)
+                && (data[tag + 7] & 1)) {
+                const quint64 frames = qFromBigEndian<quint32>(data + tag + 8);
+                tags.durationMs = static_cast<qint64>(frames * frame.samples * 1000 / frame.sampleRate);
+                return;
+            }
+            const qint64 audioBytes = audioEnd - audioStart - at;
+            tags.durationMs = audioBytes / frame.length * frame.samples * 1000 / frame.sampleRate;
+            return;
+        }
+    }
+
+    // Vorbis comment block, as used by FLAC and inside the Ogg comment packets
+    static void readVorbisComment(const QByteArray &block, TrackTags &tags) {
+        const auto *p = reinterpret_cast<const uchar *>(block.constData());
+        const qsizetype size = block.size();
+        if (size < 8) return;
+        qsizetype at = 4 + qFromLittleEndian<quint32>(p);
+        if (at + 4 > size) return;
+        const quint32 count = qFromLittleEndian<quint32>(p + at);
+        at += 4;
+        for (quint32 i = 0; i < count && at + 4 <= size; ++i) {
+            const qsizetype length = qFromLittleEndian<quint32>(p + at);
+            at += 4;
+            if (length > size - at) return;
+            const QByteArray comment = QByteArray::fromRawData(block.constData() + at, length);
+            at += length;
+            const qsizetype equals = comment.indexOf('=');
+            if (equals <= 0) continue;
+            const QByteArray key = comment.left(equals).toUpper();
+            const QString value = QString::fromUtf8(comment.mid(equals + 1));
+            if (key == "TITLE") keep(tags.title, value);
+            else if (key == "ARTIST") keep(tags.artist, value);
+            else if (key == "ALBUM") keep(tags.album, value);
+        }
+    }
+
+    static void readFlac(QFile &file, qint64 at, TrackTags &tags, QByteArray *picture, int &pictureType) {
+        for (bool last = false; !last && file.seek(at);) {
+            const QByteArray header = file.read(4);
+            if (header.size() < 4) return;
+            const auto *h = reinterpret_cast<const uchar *>(header.constData());
+            last = h[0] & 0x80;
+            const int type = h[0] & 0x7f;
+            const qint64 length = (qint64(h[1]) << 16) | (qint64(h[2]) << 8) | h[3];
+            if (type == 0 && length >= 18) {
+                const QByteArray info = file.read(18);
+                if (info.size() < 18) return;
+                const auto *i = reinterpret_cast<const uchar *>(info.constData());
+                const quint64 rate = (quint64(i[10]) << 12) | (quint64(i[11]) << 4) | (i[12] >> 4);
+                const quint64 samples = (quint64(i[13] & 0x0f) << 32) | qFromBigEndian<quint32>(i + 14);
+                if (rate > 0) tags.durationMs = static_cast<qint64>(samples * 1000 / rate);
+            } else if (type == 4 && length <= MaxBlockBytes) {
+                readVorbisComment(file.read(length), tags);
+            } else if (type == 6 && picture && length >= 32 && length <= MaxPictureBytes) {
+                // PICTURE: type, MIME and description with their lengths, four 32-bit
+                // dimensions, then the image with its length, all big-endian
+                const QByteArray block = file.read(length);
+                const auto *b = reinterpret_cast<const uchar *>(block.constData());
+                qint64 offset = 4;
+                for (int field = 0; field < 2 && offset + 4 <= block.size(); ++field) {
+                    offset += 4 + qFromBigEndian<quint32>(b + offset);
+                }
+                offset += 16;
+                if (offset + 4 <= block.size()) {
+                    const qint64 dataLength = qFromBigEndian<quint32>(b + offset);
+                    if (dataLength <= block.size() - offset - 4) {
+                        keepPicture(picture, pictureType, int(qFromBigEndian<quint32>(b)), block.mid(offset + 4, dataLength));
+                    }
+                }
+            }
+            at += 4 + length;
+        }
+    }
+
+    // The identification and comment packets open the first logical stream; the duration
+    // is the granule position of its last page.
+    static void readOgg(QFile &file, TrackTags &tags) {
+        QByteArray packets[2];
+        int packet = 0;
+        quint32 serial = 0;
+        qint64 at = 0;
+        while (packet < 2 && file.seek(at)) {
+            const QByteArray page = file.read(27);
+            if (page.size() < 27 || !page.startsWith("OggS")) break;
+            const auto *p = reinterpret_cast<const uchar *>(page.constData());
+            if (at == 0) serial = qFromLittleEndian<quint32>(p + 14);
+            const QByteArray lacing = file.read(p[26]);
+            if (lacing.size() < p[26]) break;
+            qint64 body = 0;
+            for (char lace : lacing) body += uchar(lace);
+            const QByteArray payload = file.read(body);
+            at += 27 + lacing.size() + body;
+            if (qFromLittleEndian<quint32>(p + 14) != serial) continue;
+            qsizetype offset = 0;
+            for (char lace : lacing) {
+                if (packet >= 2) break;
+                packets[packet].append(payload.mid(offset, uchar(lace)));
+                offset += uchar(lace);
+                // A lacing value below 255 ends the packet
+                if (uchar(lace) < 255) ++packet;
+                if (packets[qMin(packet, 1)].size() > MaxBlockBytes) return;
+            }
+        }
+        quint64 rate = 0, preSkip = 0;
+        if (packets[0].startsWith("\x01vorbis") && packets[0].size() >= 16) {
+            rate = qFromLittleEndian<quint32>(packets[0].constData() + 12);
+            if (packets[1].startsWith("\x03vorbis")) readVorbisComment(packets[1].mid(7), tags);
+        } else if (packets[0].startsWith("OpusHead") && packets[0].size() >= 12) {
+            rate = 48000;
+            preSkip = qFromLittleEndian<quint16>(packets[0].constData() + 10);
+            if (packets[1].startsWith("OpusTags")) readVorbisComment(packets[1].mid(8), tags);
+        }
+        if (rate == 0) return;
+        const qint64 size = file.size();
+        const qint64 tailStart = qMax<qint64>(0, size - Mp3ProbeBytes);
+        if (!file.seek(tailStart)) return;
+        const QByteArray tail = file.read(size - tailStart);
+        for (qsizetype page = tail.lastIndexOf("OggS"); page >= 0; page = tail.lastIndexOf("OggS", page - 1)) {
+            if (page + 27 > tail.size()) continue;
+            const auto *p = reinterpret_cast<const uchar *>(tail.constData() + page);
+            if (qFromLittleEndian<quint32>(p + 14) != serial) continue;
+            const quint64 granule = qFromLittleEndian<quint64>(p + 6);
+            if (granule > preSkip && granule != ~quint64(0)) tags.durationMs = static_cast<qint64>((granule - preSkip) * 1000 / rate);
+            return;
+        }
+    }
+
+    // Walks the boxes in [at, end): moov holds mvhd for the duration and udta/meta/ilst for
+    // the text and the covr picture.
+    static void readMp4(QFile &file, qint64 at, qint64 end, TrackTags &tags, QByteArray *picture, int depth = 0) {
+        while (at + 8 <= end && depth < 6 && file.seek(at)) {
+            const QByteArray header = file.read(8);
+            if (header.size() < 8) return;
+            const auto *h = reinterpret_cast<const uchar *>(header.constData());
+            qint64 size = qFromBigEndian<quint32>(h);
+            const QByteArray type = header.mid(4, 4);
+            qint64 body = at + 8;
+            if (size == 1) {
+                const QByteArray large = file.read(8);
+                if (large.size() < 8) return;
+                size = static_cast<qint64>(qFromBigEndian<quint64>(large.constData()));
+                body += 8;
+            } else if (size == 0) {
+                size = end - at;
+            }
+            if (size < body - at || at + size > end) return;
+            const qint64 next = at + size;
+            if (type == "moov" || type == "udta" || type == "ilst") {
+                readMp4(file, body, next, tags, picture, depth + 1);
+            } else if (type == "meta") {
+                // meta is a full box: version and flags come before its children
+                readMp4(file, body + 4, next, tags, picture, depth + 1);
+            } else if (type == "mvhd" && next - body <= 128) {
+                const QByteArray mvhd = file.read(next - body);
+                const auto *m = reinterpret_cast<const uchar *>(mvhd.constData());
+                const bool wide = mvhd.size() >= 1 && m[0] == 1;
+                if (mvhd.size() >= (wide ? 32 : 20)) {
+                    const quint64 scale = qFromBigEndian<quint32>(m + (wide ? 20 : 12));
+                    const quint64 duration = wide ? qFromBigEndian<quint64>(m + 24) : qFromBigEndian<quint32>(m + 16);
+                    if (scale > 0) tags.durationMs = static_cast<qint64>(duration * 1000 / scale);
+                }
+            } else if ((type == "\xa9nam" || type == "\xa9" "ART" || type == "\xa9" "alb") && next - body <= MaxTextBytes) {
+                // The item's data box: size, 'data', type, locale, then the UTF-8 value
+                const QByteArray item = file.read(next - body);
+                if (item.size() >= 16 && item.mid(4, 4) == "data") {
+                    const qint64 dataSize = qMin<qint64>(qFromBigEndian<quint32>(item.constData()), item.size());
+                    const QString value = QString::fromUtf8(item.mid(16, dataSize - 16));
+                    if (type == "\xa9nam") keep(tags.title, value);
+                    else if (type == "\xa9" "ART") keep(tags.artist, value);
+                    else keep(tags.album, value);
+                }
+            } else if (type == "covr" && picture && picture->isEmpty() && next - body <= MaxPictureBytes) {
+                // Same data box layout; the first image is the cover
+                const QByteArray item = file.read(next - body);
+                if (item.size() > 16 && item.mid(4, 4) == "data") {
+                    const qint64 dataSize = qMin<qint64>(qFromBigEndian<quint32>(item.constData()), item.size());
+                    *picture = item.mid(16, dataSize - 16);
+                }
+            }
+            at = next;
+        }
+    }
+
+    static void readWav(QFile &file, TrackTags &tags) {
+        quint32 byteRate = 0;
+        qint64 dataBytes = -1;
+        qint64 at = 12;
+        const qint64 size = file.size();
+        while (at + 8 <= size && file.seek(at)) {
+            const QByteArray header = file.read(8);
+            if (header.size() < 8) break;
+            const qint64 length = qFromLittleEndian<quint32>(header.constData() + 4);
+            const QByteArray id = header.left(4);
+            if (id == "fmt " && length >= 16) {
+                const QByteArray format = file.read(16);
+                if (format.size() == 16) byteRate = qFromLittleEndian<quint32>(format.constData() + 8);
+            } else if (id == "data") {
+                dataBytes = qMin(length, size - at - 8);
+            } else if (id == "LIST" && length <= MaxBlockBytes) {
+                const QByteArray list = file.read(length);
+                if (list.startsWith("INFO")) {
+                    for (qsizetype i = 4; i + 8 <= list.size();) {
+                        const QByteArray key = list.mid(i, 4);
+                        const qsizetype valueLength = qFromLittleEndian<quint32>(list.constData() + i + 4);
+                        QByteArray value = list.mid(i + 8, valueLength);
+                        const qsizetype nul = value.indexOf('\0');
+                        if (nul >= 0) value.truncate(nul);
+                        if (key == "INAM") keep(tags.title, QString::fromUtf8(value));
+                        else if (key == "IART") keep(tags.artist, QString::fromUtf8(value));
+                        else if (key == "IPRD") keep(tags.album, QString::fromUtf8(value));
+                        i += 8 + valueLength + (valueLength & 1);
+                    }
+                }
+            }
+            at += 8 + length + (length & 1);
+        }
+        if (byteRate > 0 && dataBytes > 0) tags.durationMs = dataBytes * 1000 / byteRate;
+    }
+};
+
+// Artist, title, album and duration of every library track, served from
+// memory so lists and the now-playing label never touch the files.
+//
+// Tags are read on a pool with one worker per core, in batches, so a cold
+// library of 100k tracks is read in parallel. Results are cached in the app's
+// cache directory keyed by path and stamped with the file's size and mtime,
+// and saved whenever the new entries would double the file or SaveIntervalMs
+// has passed, so an interrupted first pass resumes near where it stopped while
+// the total written stays linear in the library size. Finished paths are
+// announced in batches on the GUI thread.
+class TagCache : public QObject {
+    Q_OBJECT
+public:
+    explicit TagCache(QObject *parent = nullptr)
+    : QObject(parent) {
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount()));
+        pool.setThreadPriority(QThread::LowPriority);
+        cacheFile = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/tags.bin";
+        sinceSave.start();
+        pool.start([this]() { ensureLoaded(); });
+    }
+
+    ~TagCache() {
+        stopping = true;
+        pool.clear();
+        pool.waitForDone();
+        save();
+    }
+
+    // Queues the files that have no valid cached tags. Nothing is stat()ed here; the
+    // workers compare stamps.
+    void read(const QStringList &paths) {
+        for (qsizetype first = 0; first < paths.size(); first += BatchSize) {
+            const QStringList batch = paths.mid(first, BatchSize);
+            {
+                QMutexLocker locker(&mutex);
+                ++outstanding;
+            }
+            pool.start([this, batch]() { readBatch(batch); });
+        }
+    }
+
+    // Cached tags for path; empty until it has been read. Never does I/O.
+    TrackTags tags(const QString &path) const {
+        QMutexLocker locker(&mutex);
+        auto cached = results.constFind(path);
+        return cached == results.cend() ? TrackTags() : cached->tags;
+    }
+
+    // "Artist - Title" when the tags have them, else the file name.
+    QString displayName(const QString &path) const {
+        const TrackTags found = tags(path);
+        if (found.title.isEmpty()) return QFileInfo(path).fileName();
+        return found.artist.isEmpty() ? found.title : found.artist + " - " + found.title;
+    }
+
+    // Blocks until the cache file is in. Tags already cached are never announced, so workers
+    // that look up many paths call this first. The cache must also be in before any stamp is
+    // checked, or cached files would be read again.
+    void ensureLoaded() {
+        QMutexLocker locker(&loadMutex);
+        if (loaded) return;
+        load();
+        loaded = true;
+    }
+
+signals:
+    // Emitted on the GUI thread for paths whose tags have just been read
+    void tagsRead(const QStringList &paths);
+
+private:
+    static constexpr quint32 CacheVersion = 1;
+    static constexpr int BatchSize = 256;
+    static constexpr int MinSaveBatch = 512;
+    static constexpr qint64 SaveIntervalMs = 30000;
+    // Two lengths, two stamps, three string lengths and the duration
+    static constexpr qint64 MinEntryBytes = 4 + 8 + 8 + 3 * 4 + 8;
+    static constexpr int AnnounceMs = 200;
+
+    struct Result {
+        qint64 size = 0;
+        qint64 mtimeNs = 0;
+        TrackTags tags;
+    };
+
+    // Pool worker: reads every path of the batch whose stamp is not cached yet.
+    void readBatch(const QStringList &batch) {
+        ensureLoaded();
+        QStringList done;
+        for (const QString &path : batch) {
+            if (stopping) break;
+            SourceStamp stamp;
+            if (path.isEmpty() || !SourceStamp::read(path, stamp)) continue;
+            {
+                QMutexLocker locker(&mutex);
+                auto cached = results.constFind(path);
+                if (cached != results.cend() && cached->size == stamp.size && cached->mtimeNs == stamp.mtimeNs) continue;
+                if (reading.contains(path)) continue;
+                reading.insert(path);
+            }
+            TrackTags tags;
+            const bool ok = TagReader::read(path, tags);
+            QMutexLocker locker(&mutex);
+            reading.remove(path);
+            // Failures are not cached, so a file that could not be opened is tried again next time
+            if (!ok) continue;
+            results.insert(path, {stamp.size, stamp.mtimeNs, tags});
+            dirty = true;
+            ++unsaved;
+            done.append(path);
+        }
+        bool saveNow;
+        bool schedule;
+        {
+            QMutexLocker locker(&mutex);
+            --outstanding;
+            saveNow = dirty && (unsaved >= qMax<qsizetype>(MinSaveBatch, savedSize) || outstanding == 0
+                                || sinceSave.hasExpired(SaveIntervalMs));
+            schedule = !done.isEmpty() && unannounced.isEmpty();
+            unannounced.append(done);
+        }
+        if (saveNow) save();
+        if (schedule) {
+            QMetaObject::invokeMethod(this, [this]() { QTimer::singleShot(AnnounceMs, this, &TagCache::announce); },
+                                      Qt::QueuedConnection);
+        }
+    }
+
+    void announce() {
+        QStringList paths;
+        {
+            QMutexLocker locker(&mutex);
+            paths.swap(unannounced);
+        }
+        if (!paths.isEmpty()) emit tagsRead(paths);
+    }
+
+    void load() {
+        QFile file(cacheFile);
+        if (!file.open(QIODevice::ReadOnly)) return;
+        QDataStream in(&file);
+        quint32 version = 0;
+        in >> version;
+        if (version != CacheVersion) return;
+        qint64 count = 0;
+        in >> count;
+        // Parsed without the lock, so workers and the GUI thread are not held up by the file
+        QHash<QString, Result> stored;
+        stored.reserve(qBound<qint64>(0, count, (file.size() - file.pos()) / MinEntryBytes));
+        for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+            QString path;
+            Result result;
+            in >> path >> result.size >> result.mtimeNs >> result.tags.title >> result.tags.artist >> result.tags.album
+               >> result.tags.durationMs;
+            if (in.status() == QDataStream::Ok) stored.insert(path, result);
+        }
+        QMutexLocker locker(&mutex);
+        savedSize = stored.size();
+        if (results.isEmpty()) {
+            results.swap(stored);
+            return;
+        }
+        // Anything read since startup is newer than the file
+        for (auto it = stored.cbegin(); it != stored.cend(); ++it) {
+            if (!results.contains(it.key())) results.insert(it.key(), it.value());
+        }
+    }
+
+    void save() {
+        QMutexLocker saveLocker(&saveMutex);
+        QHash<QString, Result> snapshot;
+        {
+            QMutexLocker locker(&mutex);
+            if (!dirty) return;
+            snapshot = results;
+            dirty = false;
+            unsaved = 0;
+            savedSize = snapshot.size();
+            sinceSave.restart();
+        }
+        QDir().mkpath(QFileInfo(cacheFile).path());
+        QSaveFile file(cacheFile);
+        bool written = file.open(QIODevice::WriteOnly);
+        if (written) {
+            QDataStream out(&file);
+            out << CacheVersion << qint64(snapshot.size());
+            for (auto it = snapshot.cbegin(); it != snapshot.cend(); ++it) {
+                out << it.key() << it->size << it->mtimeNs << it->tags.title << it->tags.artist << it->tags.album
+                    << it->tags.durationMs;
+            }
+            written = file.commit();
+        }
+        if (!written) {
+            QMutexLocker locker(&mutex);
+            dirty = true;
+        }
+    }
+
+    mutable QMutex mutex;
+    QHash<QString, Result> results;  // guarded by mutex, as are the members up to unannounced
+    QSet<QString> reading;
+    qint64 outstanding = 0;
+    bool dirty = false;
+    qsizetype unsaved = 0;
+    qsizetype savedSize = 0;
+    QElapsedTimer sinceSave;
+    QStringList unannounced;
+    QString cacheFile;
+    QMutex loadMutex;
+    bool loaded = false;  // guarded by loadMutex
+    QMutex saveMutex;
+    std::atomic<bool> stopping{false};
+    QThreadPool pool;
+};
@@ -0,0 +1,8 @@
+# Silence between two synthetic tones on gapless and cold track changes, per engine.
+# Needs an audio output.
+
+TARGET = tst_gapless
+
+include(../tests.pri)
+
+SOURCES += tst_gapless.cpp
@@ -0,0 +1,168 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QMediaDevices>
+#include <memory>
+#include "mediaplayerengine.h"
+#include "streamplaybackengine.h"
+#include "spectrumanalyzer.h"
+#include "tonefile.h"
+
+// Measures the silence between two synthetic tones (440 Hz, then 2500 Hz)
+// when the second is primed as the next source (gapless) and when it is set
+// only after EndOfMedia (cold), for both engines.
+//
+// Three figures are reported per change:
+// - the engine's own measurement from transitionStats(): wall clock from the
+//   end of the first track to the first position report of the second for
+//   QMediaPlayer, frames missing at the splice for the stream engine;
+// - silent analyzer frames between the last frame dominated by the first tone
+//   and the first dominated by the second, i.e. silence inside the PCM stream
+//   the engine hands to the output, at one hop (1024 frames) resolution;
+// - the wall-clock residual between those two frames once the audio they span
+//   is accounted for, i.e. time in which no PCM reached the tap at all.
+// The gapless change must beat the cold one and may not put any silence into
+// the stream; the exact figures are printed for comparison across backends.
+class TestGapless : public QObject {
+    Q_OBJECT
+
+    struct Change {
+        bool reached = false;
+        int silentFrames = 0;
+        double wallResidualMs = 0;
+        qint64 engineGapUs = 0;
+    };
+
+    // Follows analyzer frames and finds the hand-over from the first tone to the second.
+    struct Tracker {
+        static constexpr float SilentLevel = 0.25f;
+
+        int firstBand = -1;
+        quint64 lastFirstSequence = 0;
+        qint64 lastFirstNs = 0;
+        quint64 secondSequence = 0;
+        qint64 secondNs = 0;
+        int silentFrames = 0;
+
+        void add(const SpectrumAnalyzer::Frame &frame, qint64 ns) {
+            if (secondSequence) return;
+            const auto loudest = std::max_element(frame.bands.begin(), frame.bands.end());
+            const int band = static_cast<int>(loudest - frame.bands.begin());
+            if (*loudest < SilentLevel) {
+                if (lastFirstSequence) ++silentFrames;
+                return;
+            }
+            if (firstBand < 0) firstBand = band;
+            if (band == firstBand) {
+                lastFirstSequence = frame.sequence;
+                lastFirstNs = ns;
+                silentFrames = 0;
+            } else if (lastFirstSequence) {
+                secondSequence = frame.sequence;
+                secondNs = ns;
+            }
+        }
+    };
+
+    static constexpr int SampleRate = 44100;
+    static constexpr int ToneMs = 2000;
+
+    QTemporaryDir dir;
+    QUrl first;
+    QUrl second;
+
+    Change play(PlaybackEngine &engine, bool gapless) {
+        Change change;
+        SpectrumAnalyzer analyzer;
+        Tracker tracker;
+        QElapsedTimer clock;
+        clock.start();
+        QTimer poll;
+        poll.setTimerType(Qt::PreciseTimer);
+        poll.setInterval(1);
+        connect(&poll, &QTimer::timeout, this, [&]() {
+            SpectrumAnalyzer::Frame frame;
+            if (analyzer.fetchFrame(frame)) tracker.add(frame, clock.nsecsElapsed());
+        });
+        poll.start();
+
+        bool secondSet = false;
+        const QMetaObject::Connection status = connect(&engine, &PlaybackEngine::mediaStatusChanged, this,
+                                                       [&](QMediaPlayer::MediaStatus state) {
+            if (state == QMediaPlayer::LoadedMedia) {
+                engine.play();
+                if (gapless && !secondSet) {
+                    secondSet = true;
+                    engine.setNextSource(second);
+                }
+            } else if (state == QMediaPlayer::EndOfMedia && !secondSet) {
+                // What the panel does without a primed track
+                secondSet = true;
+                engine.setSource(second);
+            }
+        });
+        engine.setAnalyzer(&analyzer);
+        engine.setSource(first);
+
+        change.reached = QTest::qWaitFor([&]() { return tracker.secondSequence != 0; }, ToneMs + 10000);
+        disconnect(status);
+        engine.setAnalyzer(nullptr);
+        engine.stop();
+        if (!change.reached) return change;
+
+        const double hopMs = 1000.0 * SpectrumAnalyzer::HopSize / SampleRate;
+        change.silentFrames = tracker.silentFrames;
+        change.wallResidualMs = (tracker.secondNs - tracker.lastFirstNs) / 1e6
+                                - (tracker.secondSequence - tracker.lastFirstSequence) * hopMs;
+        change.engineGapUs = engine.transitionStats().lastGapUs;
+        return change;
+    }
+
+    void report(const char *engine, const char *kind, const Change &change) {
+        qInfo("%-12s %-8s engine gap %8.2f ms, %d silent frames in the stream, %7.2f ms without audio at the tap",
+              engine, kind, change.engineGapUs / 1000.0, change.silentFrames, change.wallResidualMs);
+    }
+
+private slots:
+    void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true);
+        if (QMediaDevices::audioOutputs().isEmpty()) QSKIP("No audio output to play through");
+        QVERIFY(dir.isValid());
+        const qint64 frames = static_cast<qint64>(SampleRate) * ToneMs / 1000;
+        QVERIFY(ToneFile::writeWav(dir.filePath("a.wav"), SampleRate, 2, frames, 440.0));
+        QVERIFY(ToneFile::writeWav(dir.filePath("b.wav"), SampleRate, 2, frames, 2500.0));
+        first = QUrl::fromLocalFile(dir.filePath("a.wav"));
+        second = QUrl::fromLocalFile(dir.filePath("b.wav"));
+    }
+
+    void gap_data() {
+        QTest::addColumn<bool>("stream");
+        QTest::newRow("mediaplayer") << false;
+        QTest::newRow("stream") << true;
+    }
+
+    void gap() {
+        QFETCH(bool, stream);
+        const char *name = stream ? "stream" : "mediaplayer";
+        auto engine = [stream]() -> std::unique_ptr<PlaybackEngine> {
+            if (stream) return std::make_unique<StreamPlaybackEngine>();
+            return std::make_unique<MediaPlayerEngine>();
+        };
+
+        std::unique_ptr<PlaybackEngine> coldEngine = engine();
+        const Change cold = play(*coldEngine, false);
+        QVERIFY2(cold.reached, "the second tone never played after a cold change");
+        report(name, "cold", cold);
+        QCOMPARE(coldEngine->transitionStats().cold, quint64(1));
+
+        std::unique_ptr<PlaybackEngine> gaplessEngine = engine();
+        const Change gapless = play(*gaplessEngine, true);
+        QVERIFY2(gapless.reached, "the second tone never played after a gapless change");
+        report(name, "gapless", gapless);
+        QCOMPARE(gaplessEngine->transitionStats().gapless, quint64(1));
+        QCOMPARE(gapless.silentFrames, 0);
+        QVERIFY(gapless.engineGapUs < cold.engineGapUs);
+    }
+};
+
+QTEST_MAIN(TestGapless)
+#include "tst_gapless.moc"
@@ -0,0 +1,8 @@
+# Timer wakeups per second of the control panel in each playback state.
+# Needs an audio output; run headless with QT_QPA_PLATFORM=offscreen.
+
+TARGET = tst_idlewakeups
+
+include(../tests.pri)
+
+SOURCES += tst_idlewakeups.cpp
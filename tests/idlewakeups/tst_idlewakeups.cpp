@@ -0,0 +1,128 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QMediaDevices>
+#include <QPushButton>
+#include "mediacontrolwidget.h"
+#include "tonefile.h"
+
+// Plays a tone in the control panel under both engines and counts, per
+// second, the frames and timer wakeups the panel causes while visible or
+// hidden, playing or paused. Only visible playback may animate; the other
+// three states must not wake the GUI thread on the panel's behalf at all.
+class TestIdleWakeups : public QObject {
+    Q_OBJECT
+
+    // Counts timer events delivered on the GUI thread, and those owned by the panel.
+    class Counter : public QObject {
+    public:
+        explicit Counter(QWidget *panel) : panel(panel) { qApp->installEventFilter(this); }
+        ~Counter() override { qApp->removeEventFilter(this); }
+
+        int panelTimers = 0;
+        int allTimers = 0;
+
+    protected:
+        bool eventFilter(QObject *watched, QEvent *event) override {
+            if (event->type() == QEvent::Timer) {
+                ++allTimers;
+                for (QObject *owner = watched; owner; owner = owner->parent()) {
+                    if (owner == panel) {
+                        ++panelTimers;
+                        break;
+                    }
+                }
+            }
+            return false;
+        }
+
+    private:
+        QWidget *panel;
+    };
+
+    struct Rates {
+        double frames;
+        double panelWakeups;
+        double allTimers;
+    };
+
+    static constexpr int SettleMs = 500;
+    static constexpr int MeasureMs = 2000;
+
+    Rates measure(const char *state, FrameClock *clock, Counter &counter) {
+        // The state change itself may still draw one idle frame
+        QTest::qWait(SettleMs);
+        counter.panelTimers = counter.allTimers = 0;
+        const quint64 firstFrame = clock->frameCount();
+        QTest::qWait(MeasureMs);
+        const double seconds = MeasureMs / 1000.0;
+        const double frames = (clock->frameCount() - firstFrame) / seconds;
+        const Rates rates{frames, frames + counter.panelTimers / seconds, counter.allTimers / seconds};
+        qInfo("%-16s %6.1f frames/s %6.1f panel wakeups/s %6.1f GUI timer events/s", state, rates.frames,
+              rates.panelWakeups, rates.allTimers);
+        return rates;
+    }
+
+    QTemporaryDir dir;
+    QString tone;
+
+private slots:
+    void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true);
+        QCoreApplication::setOrganizationName("ApexMusicTests");
+        if (QMediaDevices::audioOutputs().isEmpty()) QSKIP("No audio output to play through");
+        QVERIFY(dir.isValid());
+        tone = dir.filePath("tone.wav");
+        QVERIFY(ToneFile::writeWav(tone, 44100, 2, 44100 * 60, 440.0));
+    }
+
+    void wakeupsPerState_data() {
+        QTest::addColumn<QString>("engine");
+        QTest::newRow("mediaplayer") << "mediaplayer";
+        QTest::newRow("stream") << "stream";
+    }
+
+    void wakeupsPerState() {
+        QFETCH(QString, engine);
+        QSettings().setValue("playback/engine", engine);
+        MediaControlWidget panel;
+        FrameClock *clock = panel.findChild<FrameClock *>();
+        QVERIFY(clock);
+        QPushButton *playButton = nullptr;
+        for (QPushButton *button : panel.findChildren<QPushButton *>()) {
+            if (button->toolTip().startsWith("Play/Pause")) playButton = button;
+        }
+        QVERIFY(playButton);
+        Counter counter(&panel);
+
+        panel.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&panel));
+        panel.loadMediaFile(tone);
+        QTRY_VERIFY_WITH_TIMEOUT(clock->isActive(), 10000);
+        const Rates playing = measure("visible playing", clock, counter);
+        QVERIFY(playing.frames > 10);
+
+        playButton->click();
+        QTRY_VERIFY(!clock->isActive());
+        const Rates paused = measure("visible paused", clock, counter);
+        QCOMPARE(paused.panelWakeups, 0.0);
+
+        playButton->click();
+        QTRY_VERIFY(clock->isActive());
+        panel.hide();
+        QVERIFY(!clock->isActive());
+        const Rates hidden = measure("hidden playing", clock, counter);
+        QCOMPARE(hidden.panelWakeups, 0.0);
+
+        playButton->click();
+        const Rates idle = measure("hidden paused", clock, counter);
+        QCOMPARE(idle.panelWakeups, 0.0);
+
+        // Shown again it animates straight away
+        playButton->click();
+        panel.show();
+        QTRY_VERIFY(clock->isActive());
+    }
+};
+
+QTEST_MAIN(TestIdleWakeups)
+#include "tst_idlewakeups.moc"
@@ -0,0 +1,8 @@
+# Heap allocations in a steady-state frame: tick, panel paint and time label paint.
+# Needs an audio output; run headless with QT_QPA_PLATFORM=offscreen.
+
+TARGET = tst_paintalloc
+
+include(../tests.pri)
+
+SOURCES += tst_paintalloc.cpp
@@ -0,0 +1,181 @@
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QMediaDevices>
+#include <QImage>
+#include <QPainter>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include "mediacontrolwidget.h"
+#include "tonefile.h"
+
+// Checks that a steady-state frame (frame clock tick, panel paint and time
+// label paint) makes no heap allocation, with the panel shown and playing so
+// the tick consumes analyzer frames, moves the bars and invalidates the
+// progress area as it does on screen. operator new is replaced for the whole
+// program, and on glibc malloc, calloc and realloc are interposed as well,
+// because Qt's containers allocate through malloc directly. Only allocations
+// on the GUI thread inside a measured block count.
+//
+// The tick may not allocate at all. Qt's own dirty-region bookkeeping in
+// update() allocates the first time a widget is dirtied in a frame, so both
+// widgets are dirtied just before the measured tick; the tick's update() calls
+// then find their rects already dirty. A paint always pays for render() and
+// QPainter setup, so each paint is compared against a widget of the same size
+// rendered to the same target whose paintEvent() only opens a painter.
+
+namespace {
+
+thread_local bool counting = false;
+std::atomic<qint64> allocations{0};
+
+void countAllocation() {
+    if (counting) allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename Body>
+qint64 allocationsIn(Body body) {
+    const qint64 before = allocations.load();
+    counting = true;
+    body();
+    counting = false;
+    return allocations.load() - before;
+}
+
+} // namespace
+
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *pointer, size_t size);
+
+void *malloc(size_t size) noexcept {
+    countAllocation();
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t count, size_t size) noexcept {
+    countAllocation();
+    return __libc_calloc(count, size);
+}
+
+void *realloc(void *pointer, size_t size) noexcept {
+    countAllocation();
+    return __libc_realloc(pointer, size);
+}
+}
+#define APEX_RAW_MALLOC __libc_malloc
+#else
+#define APEX_RAW_MALLOC std::malloc
+#endif
+
+void *operator new(std::size_t size) {
+    countAllocation();
+    if (void *pointer = APEX_RAW_MALLOC(size ? size : 1)) return pointer;
+    throw std::bad_alloc();
+}
+
+void *operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+    countAllocation();
+    return APEX_RAW_MALLOC(size ? size : 1);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+void operator delete[](void *pointer) noexcept { std::free(pointer); }
+void operator delete(void *pointer, std::size_t) noexcept { std::free(pointer); }
+void operator delete[](void *pointer, std::size_t) noexcept { std::free(pointer); }
+
+class BareWidget : public QWidget {
+public:
+    explicit BareWidget(QSize size) { resize(size); }
+
+protected:
+    void paintEvent(QPaintEvent *) override { QPainter painter(this); }
+};
+
+class TestPaintAlloc : public QObject {
+    Q_OBJECT
+
+    static constexpr int WarmupFrames = 30;
+    static constexpr int Frames = 120;
+    static constexpr int FrameMs = 16;
+
+    QTemporaryDir dir;
+    QString tone;
+
+private slots:
+    void initTestCase() {
+        QStandardPaths::setTestModeEnabled(true);
+        QCoreApplication::setOrganizationName("ApexMusicTests");
+        QVERIFY(dir.isValid());
+        tone = dir.filePath("tone.wav");
+        QVERIFY(ToneFile::writeWav(tone, 44100, 2, 44100 * 60, 440.0));
+    }
+
+    void steadyStateFrame() {
+        if (QMediaDevices::audioOutputs().isEmpty()) QSKIP("No audio output to play through");
+        MediaControlWidget panel;
+        FrameClock *clock = panel.findChild<FrameClock *>();
+        TimeLabel *timeLabel = panel.findChild<TimeLabel *>();
+        QVERIFY(clock && timeLabel);
+        panel.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&panel));
+        panel.loadMediaFile(tone);
+        QTRY_VERIFY_WITH_TIMEOUT(clock->isActive(), 10000);
+
+        QImage target(panel.size() * panel.devicePixelRatioF(), QImage::Format_ARGB32_Premultiplied);
+        target.setDevicePixelRatio(panel.devicePixelRatioF());
+        QImage labelTarget(timeLabel->size() * panel.devicePixelRatioF(), QImage::Format_ARGB32_Premultiplied);
+        labelTarget.setDevicePixelRatio(panel.devicePixelRatioF());
+        BareWidget bare(panel.size());
+        BareWidget bareLabel(timeLabel->size());
+
+        qint64 tickAllocations = 0;
+        qint64 panelAllocations = 0;
+        qint64 labelAllocations = 0;
+        qint64 bareAllocations = 0;
+        qint64 bareLabelAllocations = 0;
+        for (int frame = 0; frame < WarmupFrames + Frames; ++frame) {
+            // Let playback and the panel's own clock move on between frames, outside the measured blocks
+            QTest::qWait(FrameMs);
+            QVERIFY(clock->isActive());
+            const bool measured = frame >= WarmupFrames;
+            panel.update();
+            timeLabel->update();
+            const qint64 tick = allocationsIn([&]() { emit clock->tick(FrameMs); });
+            const qint64 paint = allocationsIn([&]() { panel.render(&target, QPoint(), QRegion(), {}); });
+            const qint64 barePaint = allocationsIn([&]() { bare.render(&target, QPoint(), QRegion(), {}); });
+            const qint64 label = allocationsIn([&]() { timeLabel->render(&labelTarget, QPoint(), QRegion(), {}); });
+            const qint64 bareLabelPaint = allocationsIn([&]() { bareLabel.render(&labelTarget, QPoint(), QRegion(), {}); });
+            if (!measured) continue;
+            tickAllocations += tick;
+            panelAllocations += paint;
+            labelAllocations += label;
+            bareAllocations += barePaint;
+            bareLabelAllocations += bareLabelPaint;
+        }
+        qInfo("allocations over %d frames: tick %lld, panel paint %lld (bare %lld), time label paint %lld (bare %lld)",
+              Frames, tickAllocations, panelAllocations, bareAllocations, labelAllocations, bareLabelAllocations);
+        QCOMPARE(tickAllocations, qint64(0));
+        QVERIFY2(panelAllocations <= bareAllocations, "the panel paint allocates beyond opening a painter");
+        QVERIFY2(labelAllocations <= bareLabelAllocations, "the time label paint allocates beyond opening a painter");
+    }
+
+    void negativeTimes() {
+        char text[TimeGlyphs::MaxLength];
+        const int length = TimeGlyphs::formatPair(-1, -1, text);
+        QCOMPARE(QByteArray(text, length), QByteArray("00:00 / 00:00"));
+    }
+};
+
+QTEST_MAIN(TestPaintAlloc)
+#include "tst_paintalloc.moc"
@@ -0,0 +1,7 @@
+# Onset detection and tempo estimation on synthetic click tracks, offline and streaming.
+
+TARGET = tst_tempo
+
+include(../tests.pri)
+
+SOURCES += tst_tempo.cpp
@@ -0,0 +1,76 @@
+#include <QtTest>
+#include <cmath>
+#include <random>
+#include <vector>
+#include "onsetdetector.h"
+
+// Click tracks of 30 seconds at 90 to 180 BPM in steps of 5, at 44.1 and
+// 48 kHz: short bursts of decaying noise, one per beat. Every click must be
+// found as an onset, and both analyzeTrack() and the streaming detector must
+// read the tempo within 1 BPM. Beat periods at these rates fall between whole
+// hops, which is where an autocorrelation on whole-hop lags reads half the
+// tempo.
+class TestTempo : public QObject {
+    Q_OBJECT
+
+    static constexpr int Seconds = 30;
+    static constexpr int FrameSize = 2048;
+    static constexpr int HopSize = 1024;
+
+    static std::vector<float> clickTrack(int sampleRate, int bpm) {
+        std::vector<float> samples(static_cast<size_t>(sampleRate) * Seconds);
+        std::mt19937 random(bpm);
+        std::uniform_real_distribution<float> noise(-1.0f, 1.0f);
+        const double period = 60.0 * sampleRate / bpm;
+        for (double at = 0; at < samples.size(); at += period) {
+            const size_t start = static_cast<size_t>(at);
+            // 10 ms, decaying with a 2 ms time constant
+            for (size_t i = 0; i < static_cast<size_t>(sampleRate / 100) && start + i < samples.size(); ++i) {
+                samples[start + i] = noise(random) * std::exp(-static_cast<float>(i) / (sampleRate * 0.002f));
+            }
+        }
+        return samples;
+    }
+
+    static int clicks(int sampleRate, int bpm) {
+        return static_cast<int>(std::ceil(static_cast<double>(sampleRate) * Seconds / (60.0 * sampleRate / bpm)));
+    }
+
+private slots:
+    void tempo_data() {
+        QTest::addColumn<int>("sampleRate");
+        QTest::addColumn<int>("bpm");
+        for (int sampleRate : {44100, 48000}) {
+            for (int bpm = 90; bpm <= 180; bpm += 5) {
+                QTest::addRow("%d Hz, %d BPM", sampleRate, bpm) << sampleRate << bpm;
+            }
+        }
+    }
+
+    void tempo() {
+        QFETCH(int, sampleRate);
+        QFETCH(int, bpm);
+        const std::vector<float> samples = clickTrack(sampleRate, bpm);
+
+        const OnsetDetector::TrackAnalysis analysis = OnsetDetector::analyzeTrack(samples.data(), samples.size(), sampleRate,
+                                                                                  FrameSize, HopSize);
+        QCOMPARE(static_cast<int>(analysis.onsetSeconds.size()), clicks(sampleRate, bpm));
+        QVERIFY2(std::fabs(analysis.bpm - bpm) <= 1.0f, qPrintable(QString("offline read %1 BPM").arg(analysis.bpm)));
+
+        SpectrumKernel kernel(FrameSize);
+        std::vector<float> window(FrameSize), spectrum(FrameSize / 2 + 1);
+        for (int i = 0; i < FrameSize; ++i) {
+            window[i] = 0.5f - 0.5f * std::cos(2.0f * static_cast<float>(M_PI) * i / (FrameSize - 1));
+        }
+        OnsetDetector detector;
+        detector.reset(FrameSize / 2 + 1, static_cast<float>(sampleRate) / HopSize);
+        for (size_t start = 0; start + FrameSize <= samples.size(); start += HopSize) {
+            kernel.magnitudes(samples.data() + start, window.data(), spectrum.data());
+            detector.process(spectrum.data(), 4.0f / FrameSize);
+        }
+        QVERIFY2(std::fabs(detector.bpm() - bpm) <= 1.0f, qPrintable(QString("streaming read %1 BPM").arg(detector.bpm())));
+    }
+};
+
+QTEST_MAIN(TestTempo)
+#include "tst_tempo.moc"
@@ -0,0 +1,11 @@
+# Shared by every test: the app's sources and the synthetic audio helpers.
+
+include(../app.pri)
+
+QT += testlib
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD
+
+HEADERS += $$PWD/tonefile.h
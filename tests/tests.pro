@@ -0,0 +1,9 @@
+# Tests, built apart from the app:
+#   qmake tests/tests.pro && make && make check
+
+TEMPLATE = subdirs
+
+SUBDIRS += idlewakeups \
+    paintalloc \
+    gapless \
+    tempo
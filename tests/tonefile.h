@@ -0,0 +1,363 @@
+#pragma once
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+#include <QtEndian>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Synthetic audio for the tests and benchmarks: sine tones written as 16-bit
+// PCM WAV or FLAC, so every sample of the file is known in advance.
+class ToneFile {
+public:
+    // How writeFlac() codes its subframes. Verbatim stores every sample as is.
+    // Predicted rotates per block and channel through fixed predictors of order
+    // 0 to 4 and LPC of order 8 at 12-bit precision (narrow enough for the
+    // 32-bit restore) and order 12 at 15 bits (which needs 64 bits), with
+    // Rice-coded residuals in up to 16 partitions, escaped where raw bits are
+    // smaller; stereo blocks rotate through independent, left/side, side/right
+    // and mid/side. Its samples come from codedSample().
+    enum class FlacCoding { Verbatim, Predicted };
+
+    // Sample value of channel-independent tone hz at frame, scaled to 16 bits.
+    static qint16 sample(qint64 frame, int sampleRate, double hz, double amplitude = 0.5) {
+        return static_cast<qint16>(std::lround(std::sin(2.0 * M_PI * hz * frame / sampleRate) * amplitude * 32767.0));
+    }
+
+    // Sample value of channel in a FlacCoding::Predicted file: the tone on the first channel and a
+    // fifth above it on the others, each with seven bits of fixed pseudo-random noise so residuals
+    // need more than the smallest Rice parameters.
+    static qint16 codedSample(qint64 frame, int channel, int sampleRate, double hz, double amplitude = 0.5) {
+        const quint32 hash = static_cast<quint32>(frame) * 2654435761u ^ static_cast<quint32>(channel + 1) * 40503u;
+        const int noise = static_cast<int>(hash >> 25) - 64;
+        const int tone = sample(frame, sampleRate, channel == 0 ? hz : hz * 1.5, amplitude);
+        return static_cast<qint16>(qBound(-32768, tone + noise, 32767));
+    }
+
+    static bool writeWav(const QString &fileName, int sampleRate, int channels, qint64 frames, double hz,
+                         double amplitude = 0.5) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+        const quint32 dataBytes = static_cast<quint32>(frames * channels * 2);
+        QByteArray header;
+        header += "RIFF";
+        appendLe<quint32>(header, 36 + dataBytes);
+        header += "WAVEfmt ";
+        appendLe<quint32>(header, 16);
+        appendLe<quint16>(header, 1);
+        appendLe<quint16>(header, static_cast<quint16>(channels));
+        appendLe<quint32>(header, static_cast<quint32>(sampleRate));
+        appendLe<quint32>(header, static_cast<quint32>(sampleRate * channels * 2));
+        appendLe<quint16>(header, static_cast<quint16>(channels * 2));
+        appendLe<quint16>(header, 16);
+        header += "data";
+        appendLe<quint32>(header, dataBytes);
+        if (file.write(header) != header.size()) return false;
+
+        // Written a second at a time so long files never sit in memory whole
+        QByteArray block;
+        for (qint64 frame = 0; frame < frames;) {
+            const qint64 count = qMin<qint64>(sampleRate, frames - frame);
+            block.resize(count * channels * 2);
+            char *out = block.data();
+            for (qint64 i = 0; i < count; ++i) {
+                const qint16 value = sample(frame + i, sampleRate, hz, amplitude);
+                for (int c = 0; c < channels; ++c, out += 2) qToLittleEndian(value, out);
+            }
+            if (file.write(block) != block.size()) return false;
+            frame += count;
+        }
+        return file.flush();
+    }
+
+    // The same tone as FLAC in fixed 4096-frame blocks. Verbatim files are valid for any decoder,
+    // with sample-exact content but no compression; see FlacCoding for Predicted ones.
+    static bool writeFlac(const QString &fileName, int sampleRate, int channels, qint64 frames, double hz,
+                          double amplitude = 0.5, FlacCoding coding = FlacCoding::Verbatim) {
+        QFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+        QByteArray header("fLaC");
+        // Last metadata block, STREAMINFO, 34 bytes
+        header += char(0x80);
+        header += char(0);
+        header += char(0);
+        header += char(34);
+        appendBe<quint16>(header, FlacBlock);
+        appendBe<quint16>(header, FlacBlock);
+        header += QByteArray(6, 0);  // frame sizes unknown
+        const quint64 packed = (quint64(sampleRate) << 44) | (quint64(channels - 1) << 41) | (quint64(15) << 36)
+                               | (quint64(frames) & 0xfffffffffULL);
+        appendBe<quint64>(header, packed);
+        header += QByteArray(16, 0);  // no MD5
+        if (file.write(header) != header.size()) return false;
+
+        QByteArray frame;
+        std::vector<std::vector<qint32>> input(channels, std::vector<qint32>(FlacBlock));
+        for (qint64 first = 0, number = 0; first < frames; first += FlacBlock, ++number) {
+            const int block = static_cast<int>(qMin<qint64>(FlacBlock, frames - first));
+            int assignment = channels - 1;
+            if (coding == FlacCoding::Predicted) {
+                for (int c = 0; c < channels; ++c) {
+                    for (int i = 0; i < block; ++i) input[c][i] = codedSample(first + i, c, sampleRate, hz, amplitude);
+                }
+                if (channels == 2) assignment = decorrelate(input[0].data(), input[1].data(), block, number);
+            }
+            frame.clear();
+            frame += char(0xff);
+            frame += char(0xf8);
+            // 4096 frames or an explicit 16-bit size, sample rate from STREAMINFO
+            frame += char((block == FlacBlock ? 12 : 7) << 4);
+            // Channel assignment, 16 bits
+            frame += char((assignment << 4) | (4 << 1));
+            appendUtf8(frame, static_cast<quint32>(number));
+            if (block != FlacBlock) appendBe<quint16>(frame, static_cast<quint16>(block - 1));
+            frame += char(crc8(frame));
+            if (coding == FlacCoding::Verbatim) {
+                for (int c = 0; c < channels; ++c) {
+                    frame += char(0x02);  // verbatim, no wasted bits
+                    for (int i = 0; i < block; ++i) appendBe<qint16>(frame, sample(first + i, sampleRate, hz, amplitude));
+                }
+            } else {
+                BitWriter out{frame};
+                for (int c = 0; c < channels; ++c) {
+                    // The side channel carries one extra bit
+                    const bool side = (assignment == 8 && c == 1) || (assignment == 9 && c == 0) || (assignment == 10 && c == 1);
+                    writeSubframe(out, input[c].data(), block, side ? 17 : 16, static_cast<int>((number + c) % SubframeKinds));
+                }
+                out.flush();
+            }
+            appendBe<quint16>(frame, crc16(frame));
+            if (file.write(frame) != frame.size()) return false;
+        }
+        return file.flush();
+    }
+
+private:
+    static constexpr int FlacBlock = 4096;
+    // Fixed orders 0-4, then the two LPC variants
+    static constexpr int SubframeKinds = 7;
+    static constexpr int MaxPartitionOrder = 4;
+    static constexpr int MaxRiceParameter = 14;
+
+    // MSB-first bit packing behind a frame's header
+    struct BitWriter {
+        QByteArray &out;
+        quint64 accumulator = 0;
+        int pending = 0;
+
+        void put(quint32 value, int bits) {
+            if (bits == 0) return;
+            accumulator = (accumulator << bits) | (value & ((quint64(1) << bits) - 1));
+            pending += bits;
+            while (pending >= 8) {
+                pending -= 8;
+                out += char(accumulator >> pending);
+            }
+        }
+
+        void putSigned(qint32 value, int bits) { put(static_cast<quint32>(value), bits); }
+
+        void putUnary(quint32 zeros) {
+            for (; zeros >= 31; zeros -= 31) put(0, 31);
+            put(1, static_cast<int>(zeros) + 1);
+        }
+
+        // Pads the last byte with zeros
+        void flush() {
+            if (pending) out += char(accumulator << (8 - pending));
+            pending = 0;
+        }
+    };
+
+    // Rewrites a stereo block for the assignment picked by block number and returns the assignment.
+    static int decorrelate(qint32 *left, qint32 *right, int count, qint64 number) {
+        static constexpr int Assignments[4] = {1, 8, 9, 10};
+        const int assignment = Assignments[number % 4];
+        for (int i = 0; i < count; ++i) {
+            const qint32 side = left[i] - right[i];
+            switch (assignment) {
+            case 8: right[i] = side; break;
+            case 9: left[i] = side; break;
+            case 10:
+                left[i] = (left[i] + right[i]) >> 1;
+                right[i] = side;
+                break;
+            default: break;
+            }
+        }
+        return assignment;
+    }
+
+    // One subframe of count samples of bits each: kind 0-4 is a fixed predictor of that order,
+    // 5 is LPC of order 8 at 12-bit precision and 6 LPC of order 12 at 15 bits. Blocks too short
+    // to partition are written verbatim.
+    static void writeSubframe(BitWriter &out, const qint32 *s, int count, int bits, int kind) {
+        if (count < 64) {
+            out.put(0x02, 8);
+            for (int i = 0; i < count; ++i) out.putSigned(s[i], bits);
+            return;
+        }
+        std::vector<qint32> residual(count);
+        int order;
+        if (kind <= 4) {
+            order = kind;
+            out.put(0, 1);
+            out.put(8 + order, 6);
+            out.put(0, 1);
+            for (int i = 0; i < order; ++i) out.putSigned(s[i], bits);
+            for (int i = order; i < count; ++i) {
+                qint64 predicted = 0;
+                switch (order) {
+                case 1: predicted = s[i - 1]; break;
+                case 2: predicted = 2 * qint64(s[i - 1]) - s[i - 2]; break;
+                case 3: predicted = 3 * (qint64(s[i - 1]) - s[i - 2]) + s[i - 3]; break;
+                case 4: predicted = 4 * (qint64(s[i - 1]) + s[i - 3]) - 6 * qint64(s[i - 2]) - s[i - 4]; break;
+                default: break;
+                }
+                residual[i] = static_cast<qint32>(s[i] - predicted);
+            }
+        } else {
+            order = kind == 5 ? 8 : 12;
+            const int precision = kind == 5 ? 12 : 15;
+            qint32 coefs[12];
+            const int shift = lpcCoefficients(s, count, order, precision, coefs);
+            out.put(0, 1);
+            out.put(32 + order - 1, 6);
+            out.put(0, 1);
+            for (int i = 0; i < order; ++i) out.putSigned(s[i], bits);
+            out.put(precision - 1, 4);
+            out.putSigned(shift, 5);
+            for (int j = 0; j < order; ++j) out.putSigned(coefs[j], precision);
+            for (int i = order; i < count; ++i) {
+                qint64 sum = 0;
+                for (int j = 0; j < order; ++j) sum += qint64(coefs[j]) * s[i - 1 - j];
+                residual[i] = static_cast<qint32>(s[i] - (sum >> shift));
+            }
+        }
+        writeResidual(out, residual.data(), count, order);
+    }
+
+    // Levinson-Durbin on the block's autocorrelation; the predictor is quantized to precision bits
+    // with the rounding error carried forward, as libFLAC does. Returns the shift.
+    static int lpcCoefficients(const qint32 *s, int count, int order, int precision, qint32 *coefs) {
+        double autoc[13] = {};
+        for (int lag = 0; lag <= order; ++lag) {
+            for (int i = lag; i < count; ++i) autoc[lag] += double(s[i]) * s[i - lag];
+        }
+        double lpc[12] = {};
+        double error = autoc[0] * (1.0 + 1e-9);
+        for (int m = 0; m < order && error > 0.0; ++m) {
+            double reflection = autoc[m + 1];
+            for (int j = 0; j < m; ++j) reflection -= lpc[j] * autoc[m - j];
+            reflection /= error;
+            double previous[12];
+            std::copy(lpc, lpc + m, previous);
+            for (int j = 0; j < m; ++j) lpc[j] = previous[j] - reflection * previous[m - 1 - j];
+            lpc[m] = reflection;
+            error *= 1.0 - reflection * reflection;
+        }
+        double largest = 0.0;
+        for (int j = 0; j < order; ++j) largest = std::max(largest, std::fabs(lpc[j]));
+        int exponent = 0;
+        std::frexp(largest, &exponent);
+        const int shift = largest > 0.0 ? qBound(0, precision - 1 - exponent, 15) : 0;
+        const qint32 limit = (1 << (precision - 1)) - 1;
+        double carried = 0.0;
+        for (int j = 0; j < order; ++j) {
+            carried += lpc[j] * (1 << shift);
+            coefs[j] = qBound(-limit - 1, static_cast<qint32>(std::lround(carried)), limit);
+            carried -= coefs[j];
+        }
+        return shift;
+    }
+
+    // Rice coding, method 0, over the most partitions the block size and order allow up to
+    // MaxPartitionOrder. residual holds order unused slots before the coded values.
+    static void writeResidual(BitWriter &out, const qint32 *residual, int count, int order) {
+        int partitionOrder = 0;
+        while (partitionOrder < MaxPartitionOrder && count % (2 << partitionOrder) == 0
+               && (count >> (partitionOrder + 1)) > order) {
+            ++partitionOrder;
+        }
+        out.put(0, 2);
+        out.put(static_cast<quint32>(partitionOrder), 4);
+        const int partitionSize = count >> partitionOrder;
+        for (int p = 0; p < (1 << partitionOrder); ++p) {
+            const qint32 *values = residual + (p == 0 ? order : p * partitionSize);
+            const int n = partitionSize - (p == 0 ? order : 0);
+            quint64 sum = 0;
+            int rawBits = 0;
+            for (int i = 0; i < n; ++i) {
+                sum += fold(values[i]);
+                while (rawBits < 32 && (values[i] < -(qint64(1) << rawBits >> 1) || values[i] > (qint64(1) << rawBits >> 1) - 1)) {
+                    ++rawBits;
+                }
+            }
+            int parameter = 0;
+            while (parameter < MaxRiceParameter && (quint64(n) << (parameter + 1)) <= sum) ++parameter;
+            quint64 riceBits = quint64(n) * (parameter + 1);
+            for (int i = 0; i < n; ++i) riceBits += fold(values[i]) >> parameter;
+            if (5 + quint64(n) * rawBits < riceBits) {
+                out.put(15, 4);
+                out.put(static_cast<quint32>(rawBits), 5);
+                for (int i = 0; i < n; ++i) out.putSigned(values[i], rawBits);
+            } else {
+                out.put(static_cast<quint32>(parameter), 4);
+                for (int i = 0; i < n; ++i) {
+                    const quint32 folded = fold(values[i]);
+                    out.putUnary(folded >> parameter);
+                    out.put(folded, parameter);
+                }
+            }
+        }
+    }
+
+    static quint32 fold(qint32 value) { return (static_cast<quint32>(value) << 1) ^ static_cast<quint32>(value >> 31); }
+
+    static void appendUtf8(QByteArray &out, quint32 value) {
+        if (value < 0x80) {
+            out += char(value);
+        } else if (value < 0x800) {
+            out += char(0xc0 | (value >> 6));
+            out += char(0x80 | (value & 0x3f));
+        } else {
+            out += char(0xe0 | (value >> 12));
+            out += char(0x80 | ((value >> 6) & 0x3f));
+            out += char(0x80 | (value & 0x3f));
+        }
+    }
+
+    static quint8 crc8(const QByteArray &data) {
+        quint8 crc = 0;
+        for (char byte : data) {
+            crc ^= quint8(byte);
+            for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x80) ? quint8((crc << 1) ^ 0x07) : quint8(crc << 1);
+        }
+        return crc;
+    }
+
+    static quint16 crc16(const QByteArray &data) {
+        quint16 crc = 0;
+        for (char byte : data) {
+            crc ^= quint16(quint8(byte)) << 8;
+            for (int bit = 0; bit < 8; ++bit) crc = (crc & 0x8000) ? quint16((crc << 1) ^ 0x8005) : quint16(crc << 1);
+        }
+        return crc;
+    }
+
+    template <typename T>
+    static void appendBe(QByteArray &out, T value) {
+        char bytes[sizeof(T)];
+        qToBigEndian(value, bytes);
+        out.append(bytes, sizeof(T));
+    }
+
+    template <typename T>
+    static void appendLe(QByteArray &out, T value) {
+        char bytes[sizeof(T)];
+        qToLittleEndian(value, bytes);
+        out.append(bytes, sizeof(T));
+    }
+};
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <QWidget>
+#include <QPainter>
+#include <QPixmap>
+#include <QFont>
+#include <QFontMetrics>
+#include <QColor>
+#include <QEvent>
+#include <algorithm>
+
+// Pre-rendered glyphs for "mm:ss / mm:ss" strings. Drawing a time is a few
+// pixmap blits from fixed storage, so per-frame time updates never build a
+// QString or shape text.
+class TimeGlyphs {
+public:
+    static constexpr int MaxLength = 24;
+
+    void render(const QFont &font, const QColor &color, qreal dpr) {
+        QFontMetrics metrics(font);
+        glyphHeight = metrics.height();
+        for (int i = 0; i < GlyphCount; ++i) {
+            const QChar ch = QLatin1Char(Alphabet[i]);
+            advances[i] = metrics.horizontalAdvance(ch);
+            glyphs[i] = QPixmap(QSize(advances[i], glyphHeight) * dpr);
+            glyphs[i].setDevicePixelRatio(dpr);
+            glyphs[i].fill(Qt::transparent);
+            QPainter painter(&glyphs[i]);
+            painter.setFont(font);
+            painter.setPen(color);
+            painter.drawText(QRect(0, 0, advances[i], glyphHeight), Qt::AlignCenter, QString(ch));
+        }
+        renderedFont = font;
+        renderedColor = color;
+        renderedDpr = dpr;
+    }
+
+    bool matches(const QFont &font, const QColor &color, qreal dpr) const {
+        return !glyphs[0].isNull() && renderedFont == font && renderedColor == color && renderedDpr == dpr;
+    }
+
+    int width(const char *text, int length) const {
+        int total = 0;
+        for (int i = 0; i < length; ++i) total += advances[indexOf(text[i])];
+        return total;
+    }
+
+    int height() const { return glyphHeight; }
+
+    void draw(QPainter &painter, QPoint topLeft, const char *text, int length) const {
+        int x = topLeft.x();
+        for (int i = 0; i < length; ++i) {
+            const int glyph = indexOf(text[i]);
+            painter.drawPixmap(x, topLeft.y(), glyphs[glyph]);
+            x += advances[glyph];
+        }
+    }
+
+    // Same "mm:ss" format the widget has always shown. Returns the characters written.
+    // Negative times, which backends report before the duration is known, show as 00:00.
+    static int formatTime(qint64 milliseconds, char *out) {
+        milliseconds = qMax<qint64>(0, milliseconds);
+        const int seconds = (milliseconds / 1000) % 60;
+        const int minutes = (milliseconds / (1000 * 60)) % 60;
+        out[0] = static_cast<char>('0' + minutes / 10);
+        out[1] = static_cast<char>('0' + minutes % 10);
+        out[2] = ':';
+        out[3] = static_cast<char>('0' + seconds / 10);
+        out[4] = static_cast<char>('0' + seconds % 10);
+        return 5;
+    }
+
+    // "position / duration" into out (at least MaxLength chars). Returns the length.
+    static int formatPair(qint64 position, qint64 duration, char *out) {
+        int length = formatTime(position, out);
+        out[length++] = ' ';
+        out[length++] = '/';
+        out[length++] = ' ';
+        return length + formatTime(duration, out + length);
+    }
+
+private:
+    static constexpr int GlyphCount = 13;
+    static constexpr char Alphabet[GlyphCount + 1] = "0123456789:/ ";
+
+    static int indexOf(char ch) {
+        if (ch >= '0' && ch <= '9') return ch - '0';
+        if (ch == ':') return 10;
+        if (ch == '/') return 11;
+        return 12;
+    }
+
+    QPixmap glyphs[GlyphCount];
+    int advances[GlyphCount] = {};
+    int glyphHeight = 0;
+    QFont renderedFont;
+    QColor renderedColor;
+    qreal renderedDpr = 0;
+};
+
+// Drop-in for the old "position / duration" QLabel, painted from TimeGlyphs.
+class TimeLabel : public QWidget {
+    Q_OBJECT
+public:
+    explicit TimeLabel(QWidget *parent = nullptr)
+    : QWidget(parent), color(36, 255, 255), length(0) {
+        QFont labelFont = font();
+        labelFont.setPixelSize(10);
+        labelFont.setBold(true);
+        setFont(labelFont);
+        clear();
+    }
+
+    void setTime(qint64 position, qint64 duration) {
+        char next[TimeGlyphs::MaxLength];
+        const int nextLength = TimeGlyphs::formatPair(position, duration, next);
+        if (nextLength == length && std::equal(next, next + length, text)) return;
+        std::copy(next, next + nextLength, text);
+        length = nextLength;
+        update();
+    }
+
+    void clear() {
+        static const char idle[] = "0:00 / 0:00";
+        length = sizeof(idle) - 1;
+        std::copy(idle, idle + length, text);
+        update();
+    }
+
+    QSize sizeHint() const override {
+        QFontMetrics metrics(font());
+        return QSize(metrics.horizontalAdvance(QStringLiteral("00:00 / 00:00")), metrics.height());
+    }
+
+protected:
+    void paintEvent(QPaintEvent *) override {
+        if (!glyphs.matches(font(), color, devicePixelRatioF())) {
+            glyphs.render(font(), color, devicePixelRatioF());
+        }
+        QPainter painter(this);
+        const int textWidth = glyphs.width(text, length);
+        glyphs.draw(painter, QPoint((width() - textWidth) / 2, (height() - glyphs.height()) / 2), text, length);
+    }
+
+private:
+    TimeGlyphs glyphs;
+    QColor color;
+    char text[TimeGlyphs::MaxLength];
+    int length;
+};
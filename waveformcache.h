@@ -0,0 +1,359 @@
+#pragma once
+
+#include <QObject>
+#include <QThreadPool>
+#include <QEventLoop>
+#include <QAudioDecoder>
+#include <QAudioBuffer>
+#include <QPainter>
+#include <QColor>
+#include <QRect>
+#include <QString>
+#include <QUrl>
+#include <QFile>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include "nativedecoder.h"
+#include "sourcestamp.h"
+
+// Min/max/RMS overview of a whole track for drawing behind the seek bar.
+//
+// Overviews live in the app's cache directory as one peak file per track:
+//   64-byte header (magic, version, source size and mtime, frame count, rate,
+//   level count), a table of level offsets and counts, then the levels.
+// Level 0 has one 4-byte bucket (min, max, rms, pad) per BucketFrames frames
+// of audio; each level above merges LevelFactor buckets of the one below,
+// down to a few hundred. The file is memory-mapped, so showing a track seen
+// before costs a stat() and a map, and drawing reads only the level closest
+// to the width being drawn.
+//
+// Missing or stale files are rebuilt by one decode-only pass on a private
+// worker, through NativeDecoder for WAV and FLAC and QAudioDecoder for
+// everything else; asking for another track abandons a pass still running.
+class WaveformCache : public QObject {
+    Q_OBJECT
+public:
+    static constexpr int BucketFrames = 256;
+    static constexpr int LevelFactor = 4;
+    static constexpr int MaxLevels = 12;
+
+    explicit WaveformCache(QObject *parent = nullptr)
+    : QObject(parent) {
+        pool.setMaxThreadCount(1);
+        directory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/waveforms";
+    }
+
+    ~WaveformCache() {
+        ++generation;
+        pool.waitForDone();
+        unmap();
+    }
+
+    // Drops the current overview and starts finding or building the one for path.
+    void request(const QString &path) {
+        unmap();
+        const quint64 pass = ++generation;
+        if (path.isEmpty()) return;
+        const QString peakPath = peakFileFor(path);
+        pool.start([this, path, peakPath, pass]() {
+            SourceStamp stamp;
+            if (!SourceStamp::read(path, stamp)) return;
+            if (!isCurrent(peakPath, stamp) && !build(path, peakPath, stamp, pass)) return;
+            QMetaObject::invokeMethod(this, [this, path, peakPath, pass]() {
+                if (pass != generation || !map(peakPath)) return;
+                emit ready(path);
+            }, Qt::QueuedConnection);
+        });
+    }
+
+    bool isReady() const { return header != nullptr; }
+
+    // Draws the overview into rect, one column per device pixel: the min..max envelope in
+    // color and the RMS band over it in a brighter shade. Reads at most one level.
+    void draw(QPainter &painter, const QRectF &rect, const QColor &color) const {
+        if (!header || rect.width() < 1) return;
+        const qreal dpr = painter.device() ? painter.device()->devicePixelRatioF() : 1.0;
+        const int columns = qMax(1, qRound(rect.width() * dpr));
+        // The coarsest level that still has a bucket for every column
+        int level = 0;
+        for (int i = static_cast<int>(header->levels) - 1; i > 0; --i) {
+            if (levelCount(i) >= static_cast<quint64>(columns)) {
+                level = i;
+                break;
+            }
+        }
+        const quint64 count = levelCount(level);
+        if (count == 0) return;
+        const Bucket *buckets = levelData(level);
+        const qreal halfHeight = rect.height() / 2;
+        const qreal middle = rect.top() + halfHeight;
+        const qreal columnWidth = rect.width() / columns;
+        const QColor rmsColor = color.lighter(150);
+        for (int x = 0; x < columns; ++x) {
+            const quint64 first = count * x / columns;
+            const quint64 last = qMax(first + 1, count * (x + 1) / columns);
+            int low = 127, high = -128;
+            quint64 energy = 0;
+            for (quint64 b = first; b < last; ++b) {
+                low = qMin<int>(low, buckets[b].min);
+                high = qMax<int>(high, buckets[b].max);
+                energy += quint64(buckets[b].rms) * buckets[b].rms;
+            }
+            if (high < low) continue;
+            const qreal left = rect.left() + x * columnWidth;
+            const qreal top = middle - high / 127.0 * halfHeight;
+            const qreal bottom = middle - low / 127.0 * halfHeight;
+            painter.fillRect(QRectF(left, top, columnWidth, qMax<qreal>(bottom - top, 1.0 / dpr)), color);
+            const qreal rms = std::sqrt(static_cast<double>(energy) / (last - first)) / 255.0 * halfHeight;
+            painter.fillRect(QRectF(left, middle - rms, columnWidth, rms * 2), rmsColor);
+        }
+    }
+
+signals:
+    // The overview of path is mapped and can be drawn
+    void ready(const QString &path);
+
+private:
+    static constexpr char Magic[8] = {'A', 'P', 'X', 'P', 'E', 'A', 'K', 'S'};
+    static constexpr quint32 Version = 1;
+
+    struct Bucket {
+        qint8 min;
+        qint8 max;
+        quint8 rms;
+        quint8 pad;
+    };
+
+    struct Header {
+        char magic[8];
+        quint32 version;
+        quint32 levels;
+        qint64 sourceSize;
+        qint64 sourceMtimeNs;
+        quint64 frames;
+        quint32 sampleRate;
+        quint32 bucketFrames;
+        quint8 reserved[16];
+        quint64 offsets[MaxLevels];
+        quint64 counts[MaxLevels];
+    };
+    static_assert(sizeof(Header) == 64 + MaxLevels * 16, "peak file header layout");
+
+    QString peakFileFor(const QString &path) const {
+        return directory + '/' + QCryptographicHash::hash(path.toUtf8(), QCryptographicHash::Sha1).toHex() + ".peaks";
+    }
+
+    static bool isCurrent(const QString &peakPath, const SourceStamp &stamp) {
+        QFile file(peakPath);
+        Header stored;
+        if (!file.open(QIODevice::ReadOnly) || file.read(reinterpret_cast<char *>(&stored), sizeof(stored)) != sizeof(stored)) {
+            return false;
+        }
+        return std::memcmp(stored.magic, Magic, sizeof(Magic)) == 0 && stored.version == Version
+               && stored.sourceSize == stamp.size && stored.sourceMtimeNs == stamp.mtimeNs;
+    }
+
+    // Worker: decodes path once, folding every frame into level 0, then writes the file.
+    bool build(const QString &path, const QString &peakPath, const SourceStamp &stamp, quint64 pass) {
+        std::vector<Bucket> base;
+        quint64 frames = 0;
+        quint32 sampleRate = 0;
+        float low = 0.0f, high = 0.0f;
+        double energy = 0.0;
+        int filled = 0;
+        auto closeBucket = [&]() {
+            const auto quantize = [](float v) { return static_cast<qint8>(qBound(-127.0f, std::round(v * 127.0f), 127.0f)); };
+            const float rms = filled ? static_cast<float>(std::sqrt(energy / filled)) : 0.0f;
+            base.push_back({quantize(low), quantize(high), static_cast<quint8>(qBound(0.0f, std::round(rms * 255.0f), 255.0f)), 0});
+            low = high = 0.0f;
+            energy = 0.0;
+            filled = 0;
+        };
+
+        // Channels fold into one envelope; the mean of squares keeps RMS comparable across layouts
+        auto fold = [&](const auto *data, qsizetype count, int channels, float scale) {
+            for (qsizetype i = 0; i < count; ++i) {
+                float frameLow = 1.0f, frameHigh = -1.0f, square = 0.0f;
+                for (int c = 0; c < channels; ++c) {
+                    const float v = static_cast<float>(data[i * channels + c]) * scale;
+                    frameLow = qMin(frameLow, v);
+                    frameHigh = qMax(frameHigh, v);
+                    square += v * v;
+                }
+                if (filled == 0) {
+                    low = frameLow;
+                    high = frameHigh;
+                } else {
+                    low = qMin(low, frameLow);
+                    high = qMax(high, frameHigh);
+                }
+                energy += square / channels;
+                if (++filled == BucketFrames) closeBucket();
+            }
+            frames += static_cast<quint64>(count);
+        };
+
+        // WAV and FLAC are read on this thread without the backend's pipeline, as stereo
+        if (std::unique_ptr<NativeDecoder> native = NativeDecoder::open(path)) {
+            sampleRate = static_cast<quint32>(native->sampleRate());
+            std::vector<float> stereo(NativeChunkFrames * 2);
+            while (true) {
+                if (pass != generation) return false;
+                const qint64 count = native->read(stereo.data(), NativeChunkFrames, 1.0f);
+                if (count < 0) return false;
+                if (count == 0) break;
+                fold(stereo.data(), count, 2, 1.0f);
+            }
+        } else if (!decode(path, pass, sampleRate, fold)) {
+            return false;
+        }
+        if (filled > 0) closeBucket();
+        if (base.empty()) return false;
+
+        // Each level merges LevelFactor buckets of the one below; RMS merges as a mean of squares
+        std::vector<std::vector<Bucket>> levels{std::move(base)};
+        while (levels.size() < MaxLevels && levels.back().size() > MinTopBuckets) {
+            const std::vector<Bucket> &below = levels.back();
+            std::vector<Bucket> above((below.size() + LevelFactor - 1) / LevelFactor);
+            for (size_t i = 0; i < above.size(); ++i) {
+                const size_t first = i * LevelFactor;
+                const size_t last = qMin(first + LevelFactor, below.size());
+                qint8 merged[2] = {127, -128};
+                quint32 squares = 0;
+                for (size_t b = first; b < last; ++b) {
+                    merged[0] = qMin(merged[0], below[b].min);
+                    merged[1] = qMax(merged[1], below[b].max);
+                    squares += quint32(below[b].rms) * below[b].rms;
+                }
+                above[i] = {merged[0], merged[1], static_cast<quint8>(std::lround(std::sqrt(double(squares) / (last - first)))), 0};
+            }
+            levels.push_back(std::move(above));
+        }
+
+        Header header{};
+        std::memcpy(header.magic, Magic, sizeof(Magic));
+        header.version = Version;
+        header.levels = static_cast<quint32>(levels.size());
+        header.sourceSize = stamp.size;
+        header.sourceMtimeNs = stamp.mtimeNs;
+        header.frames = frames;
+        header.sampleRate = sampleRate;
+        header.bucketFrames = BucketFrames;
+        quint64 offset = sizeof(Header);
+        for (size_t i = 0; i < levels.size(); ++i) {
+            header.offsets[i] = offset;
+            header.counts[i] = levels[i].size();
+            offset += levels[i].size() * sizeof(Bucket);
+        }
+        QDir().mkpath(directory);
+        QSaveFile file(peakPath);
+        if (!file.open(QIODevice::WriteOnly)) return false;
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        for (const std::vector<Bucket> &level : levels) {
+            file.write(reinterpret_cast<const char *>(level.data()), static_cast<qint64>(level.size() * sizeof(Bucket)));
+        }
+        return file.commit();
+    }
+
+    // Worker: runs path through QAudioDecoder, passing each buffer to fold. False on an error
+    // or when another request abandons the pass.
+    template <typename Fold>
+    bool decode(const QString &path, quint64 pass, quint32 &sampleRate, Fold &fold) {
+        bool done = false;
+        bool ok = true;
+        QEventLoop loop;
+        QAudioDecoder decoder;
+        connect(&decoder, &QAudioDecoder::bufferReady, &loop, [&]() {
+            while (decoder.bufferAvailable()) {
+                const QAudioBuffer buffer = decoder.read();
+                const QAudioFormat format = buffer.format();
+                const int channels = format.channelCount();
+                const qsizetype count = buffer.frameCount();
+                if (channels <= 0) continue;
+                sampleRate = static_cast<quint32>(format.sampleRate());
+                switch (format.sampleFormat()) {
+                case QAudioFormat::Float: fold(buffer.constData<float>(), count, channels, 1.0f); break;
+                case QAudioFormat::Int16: fold(buffer.constData<qint16>(), count, channels, 1.0f / 32768.0f); break;
+                case QAudioFormat::Int32: fold(buffer.constData<qint32>(), count, channels, 1.0f / 2147483648.0f); break;
+                default: continue;
+                }
+            }
+            if (pass != generation) {
+                ok = false;
+                done = true;
+                loop.quit();
+            }
+        });
+        connect(&decoder, &QAudioDecoder::finished, &loop, [&]() {
+            done = true;
+            loop.quit();
+        });
+        connect(&decoder, qOverload<QAudioDecoder::Error>(&QAudioDecoder::error), &loop, [&]() {
+            ok = false;
+            done = true;
+            loop.quit();
+        });
+        decoder.setSource(QUrl::fromLocalFile(path));
+        decoder.start();
+        // Errors can be reported from start() itself, before the loop would run
+        if (!done) loop.exec();
+        decoder.stop();
+        return ok;
+    }
+
+    bool map(const QString &peakPath) {
+        unmap();
+        mapped.setFileName(peakPath);
+        if (!mapped.open(QIODevice::ReadOnly) || mapped.size() < static_cast<qint64>(sizeof(Header))) {
+            mapped.close();
+            return false;
+        }
+        uchar *data = mapped.map(0, mapped.size());
+        if (!data) {
+            mapped.close();
+            return false;
+        }
+        const Header *candidate = reinterpret_cast<const Header *>(data);
+        bool valid = std::memcmp(candidate->magic, Magic, sizeof(Magic)) == 0 && candidate->version == Version
+                     && candidate->levels > 0 && candidate->levels <= MaxLevels;
+        for (quint32 i = 0; valid && i < candidate->levels; ++i) {
+            valid = candidate->offsets[i] + candidate->counts[i] * sizeof(Bucket) <= static_cast<quint64>(mapped.size());
+        }
+        if (!valid) {
+            mapped.unmap(data);
+            mapped.close();
+            return false;
+        }
+        header = candidate;
+        return true;
+    }
+
+    void unmap() {
+        if (header) mapped.unmap(reinterpret_cast<uchar *>(const_cast<Header *>(header)));
+        header = nullptr;
+        mapped.close();
+    }
+
+    quint64 levelCount(int level) const { return header->counts[level]; }
+
+    const Bucket *levelData(int level) const {
+        return reinterpret_cast<const Bucket *>(reinterpret_cast<const uchar *>(header) + header->offsets[level]);
+    }
+
+    static constexpr size_t MinTopBuckets = 256;
+    static constexpr qint64 NativeChunkFrames = 16384;
+
+    QString directory;
+    QFile mapped;
+    const Header *header = nullptr;
+    std::atomic<quint64> generation{0};
+    QThreadPool pool;
+};